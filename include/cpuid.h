@@ -139,6 +139,12 @@ bool cpuid_timestamp_counter_avail(void);
 /// @return Number of PMCs are available.
 int cpuid_num_pmc(void);
 
+/// @brief Get bit width of general-purpose performance counters on the
+/// platform.
+///
+/// @return Bit width of general-purpose performance counters.
+int cpuid_width_pmc(void);
+
 /*****************************************/
 /* Performance Event Select (PerfEvtSel) */
 /* (0x186, 0x187, 0x188, 0x189)          */
@@ -234,6 +240,34 @@ bool cpuid_therm_interrupt_enable_PowerLimitNotify(void);
 /// enabled, else false.
 bool cpuid_pkg_therm_enable_status_and_interrupt(void);
 
+/***********************************/
+/* HWP and Energy Performance Bias */
+/***********************************/
+
+/// @brief Check availability of hardware-controlled performance states
+/// (HWP), indicating presence of IA32_PM_ENABLE, IA32_HWP_CAPABILITIES, and
+/// IA32_HWP_REQUEST.
+///
+/// @return True if HWP is available, else false.
+bool cpuid_hwp_avail(void);
+
+/// @brief Check availability of the energy/performance preference field of
+/// IA32_HWP_REQUEST.
+///
+/// @return True if HWP EPP is available, else false.
+bool cpuid_hwp_epp_avail(void);
+
+/// @brief Check availability of the package-level HWP request
+/// IA32_HWP_REQUEST_PKG.
+///
+/// @return True if IA32_HWP_REQUEST_PKG is available, else false.
+bool cpuid_hwp_pkg_request_avail(void);
+
+/// @brief Check availability of IA32_ENERGY_PERF_BIAS.
+///
+/// @return True if IA32_ENERGY_PERF_BIAS is available, else false.
+bool cpuid_energy_perf_bias_avail(void);
+
 /************************/
 /* General Machine Info */
 /************************/
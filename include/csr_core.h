@@ -46,25 +46,58 @@
 #define CSRSAFE_8086_BATCH _IOWR('a', 0x05, struct csr_batch_array)
 #define CSR_FILENAME_SIZE 128
 #define CSR_MODULE "/dev/cpu/csr_safe"
+#define CSR_PCI_SYSFS "/sys/bus/pci/devices"
+#define CSR_PCI_VENDOR_INTEL 0x8086
+/// @brief Bus passed to csr_safe for the per-socket uncore devices.
+#define CSR_UNCORE_BUS 1
 
 /// @brief Enum encompassing type of data being read to/written from uncore
 /// registers.
 enum csr_data_type_e {
-    /// @brief Integrated memory controller counter measurements.
+    /// @brief Integrated memory controller counter measurements (all counters,
+    /// including the fixed DRAM clock counter).
     CSR_IMC_CTRS,
     /// @brief Integrated memory controller performance event measurements.
     CSR_IMC_EVTS,
+    /// @brief Integrated memory controller counter 0 measurements.
+    CSR_IMC_CTR0,
+    /// @brief Integrated memory controller counter 1 measurements.
+    CSR_IMC_CTR1,
+    /// @brief Integrated memory controller counter 2 measurements.
+    CSR_IMC_CTR2,
+    /// @brief Integrated memory controller counter 3 measurements.
+    CSR_IMC_CTR3,
+    /// @brief Integrated memory controller fixed DRAM clock counter
+    /// measurements.
+    CSR_IMC_FIXED_CTR,
     /// @brief UBox PMON global control data for integrated memory controller.
     CSR_IMC_PMONUNITCTRL,
     /// @brief UBox PMON global status data for integrated memory controller.
     CSR_IMC_PMONUNITSTAT,
+    /// @brief Integrated memory controller CAS counters sampled for memory
+    /// bandwidth.
+    CSR_MEMBW_CTRS,
+    /// @brief QPI link layer counter measurements.
+    CSR_QPI_CTRS,
+    /// @brief QPI link layer performance event selection.
+    CSR_QPI_EVTS,
+    /// @brief Home Agent counter measurements.
+    CSR_HA_CTRS,
+    /// @brief Home Agent performance event selection.
+    CSR_HA_EVTS,
+    /// @brief R2PCIe counter measurements.
+    CSR_R2PCIE_CTRS,
+    /// @brief R2PCIe performance event selection.
+    CSR_R2PCIE_EVTS,
+    /// @brief iMC freeze, counter read, and unfreeze in one batch.
+    CSR_IMC_SNAPSHOT,
+    /// @brief iMC counter read without freezing the units.
+    CSR_IMC_SNAPSHOT_NOFREEZE,
     /* Currently unused */
     //CSR_IMC_MEMCTRA,
     //CSR_IMC_MEMCTRR,
     //CSR_IMC_MEMCTRW,
     //CSR_IMC_IMCCTR,
-    //CSR_QPI_CTRS,
-    //CSR_QPI_EVTS
 };
 
 /// @brief Structure holding information for a single read/write operation to
@@ -104,8 +137,51 @@ struct csr_batch_array {
     struct csr_batch_op *ops;
 };
 
+/// @brief Structure describing one Intel PCI function found in sysfs.
+struct csr_pci_dev {
+    /// @brief PCI device ID.
+    uint16_t did;
+    /// @brief PCI bus number.
+    uint8_t bus;
+    /// @brief PCI device number.
+    uint8_t device;
+    /// @brief PCI function number.
+    uint8_t function;
+};
+
+/// @brief Structure describing one instance of an uncore unit on a socket.
+struct csr_pci_unit {
+    /// @brief Socket of the unit.
+    uint8_t socket;
+    /// @brief Index of the unit within the socket (e.g., QPI port).
+    uint8_t index;
+    /// @brief PCI device of the unit PMON function.
+    uint8_t device;
+    /// @brief PCI function of the unit PMON function.
+    uint8_t function;
+};
+
+/// @brief csr_safe device node exists.
+#define CSR_CAP_MODULE 0x1
+/// @brief Caller has read and write permission on the csr_safe device node.
+#define CSR_CAP_RW 0x2
+/// @brief Batch ioctl executes and returns the Intel vendor ID of an uncore
+/// PCI function.
+#define CSR_CAP_BATCH 0x4
+
+/// @brief Probe what the csr_safe module supports on first call.
+///
+/// The probe stats and opens CSR_MODULE and, if that works, issues a one-op
+/// batch reading the vendor ID of the first Home Agent, found with
+/// csr_pci_units(). It is safe to call before init_csr().
+///
+/// @return Bitmask of CSR_CAP_* flags.
+int csr_capabilities(void);
+
 /// @brief Open the module file descriptors exposed in the /dev filesystem.
 ///
+/// Calling it again after a successful initialization does nothing.
+///
 /// @return 0 if initialization was a success, else -1 if could not stat file
 /// descriptors or open any csr module.
 int init_csr(void);
@@ -116,6 +192,60 @@ int init_csr(void);
 /// descriptors.
 int finalize_csr(void);
 
+/// @brief Scan CSR_PCI_SYSFS for Intel PCI functions on first call and store
+/// them on the heap, sorted by bus, device, and function.
+///
+/// This is the one discovery table shared by all CSR-based uncore modules.
+///
+/// @param [out] devs Table of Intel PCI functions.
+///
+/// @param [out] num Number of entries in the table.
+///
+/// @return 0 if successful, else -1 if sysfs could not be read.
+int csr_pci_storage(struct csr_pci_dev **devs,
+                    unsigned *num);
+
+/// @brief Find the instance of an uncore PCI function on a socket.
+///
+/// Every uncore unit exists once per socket on its socket's uncore bus, so
+/// the n-th instance of a device ID in ascending bus order belongs to socket
+/// n.
+///
+/// @param [in] did PCI device ID of the uncore function.
+///
+/// @param [in] socket Socket identifier.
+///
+/// @return Pointer to the table entry, else NULL if not present.
+struct csr_pci_dev *csr_pci_find(uint16_t did,
+                                 unsigned socket);
+
+/// @brief List every instance of a set of uncore units, ordered by socket and
+/// unit index.
+///
+/// Units are looked up in the shared PCI device table with csr_pci_find(). If
+/// none is found, every unit with a non-zero device ID is assumed on each of
+/// fallback_sockets sockets at its default device and function.
+///
+/// @param [in] dids PCI device ID of each unit (0 if absent on the platform).
+///
+/// @param [in] devs Default PCI device of each unit.
+///
+/// @param [in] funcs Default PCI function of each unit.
+///
+/// @param [in] n Number of units per socket.
+///
+/// @param [in] fallback_sockets Number of sockets assumed by the fallback.
+///
+/// @param [out] units Array of unit instances, allocated on the heap.
+///
+/// @return Number of unit instances.
+unsigned csr_pci_units(const unsigned *dids,
+                       const unsigned *devs,
+                       const unsigned *funcs,
+                       unsigned n,
+                       unsigned fallback_sockets,
+                       struct csr_pci_unit **units);
+
 /// @brief Allocate space for uncore batch arrays.
 ///
 /// @param [out] batchsel Storage for uncore batch operations.
@@ -184,10 +314,27 @@ int create_csr_batch_op(off_t csr,
 /// @brief Execute read/write batch operation on a specific set of batch
 /// uncore registers.
 ///
+/// Per-operation failures are recorded for csr_batch_errors() and are not
+/// printed, so callers can drop the affected values and keep the rest.
+///
 /// @param [in] batchnum csr_data_type_e data type of batch operation.
 ///
-/// @return 0 if successful, else -1 if csr_batch_storage() fails or if batch
-/// allocation is for 0 or less operations.
+/// @return 0 if every operation succeeded, number of failed operations if
+/// only some failed, else -1 if csr_batch_storage() fails, batch allocation
+/// is for 0 or less operations, or the batch ioctl fails as a whole.
 int do_csr_batch_op(const int batchnum);
 
+/// @brief Get the status of each operation of the last do_csr_batch_op() on
+/// a batch.
+///
+/// @param [in] batchnum csr_data_type_e data type of batch operation.
+///
+/// @param [out] errs Error code of each operation (0 if successful), in the
+///              order the operations were created.
+///
+/// @return Number of failed operations, else -1 if the batch has not been
+/// allocated.
+int csr_batch_errors(const int batchnum,
+                     const int **errs);
+
 #endif
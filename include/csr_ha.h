@@ -0,0 +1,142 @@
+/* csr_ha.h
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#ifndef CSR_HA_H_INCLUDE
+#define CSR_HA_H_INCLUDE
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "master.h"
+#include "csr_core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Number of counters in each Home Agent PMON box.
+#define HA_NUM_CTRS 4
+/// @brief Bit width of the Home Agent PMON counters.
+#define HA_CTR_WIDTH 48
+/// @brief Bytes transferred by one Home Agent request (one cache line).
+#define HA_BYTES_PER_REQUEST 64
+
+/// @brief Counters programmed by enable_ha().
+enum ha_ctr_e {
+    /// @brief REQUESTS.LOCAL: reads and writes from the local socket.
+    HA_CTR_LOCAL,
+    /// @brief REQUESTS.REMOTE: reads and writes from remote sockets.
+    HA_CTR_REMOTE,
+    /// @brief DIRECTORY_LOOKUP: snoop filter/directory lookups.
+    HA_CTR_DIRECTORY,
+    /// @brief SNOOP_RESP: snoop responses received.
+    HA_CTR_SNOOP,
+};
+
+/// @brief Structure containing Home Agent traffic of one socket over the
+/// last sampling interval, summed over the Home Agents of the socket.
+struct ha_socket_stats {
+    /// @brief Raw counter deltas of the last interval.
+    uint64_t delta[HA_NUM_CTRS];
+    /// @brief Bytes per second requested by the local socket.
+    double local_bytes_per_sec;
+    /// @brief Bytes per second requested by remote sockets.
+    double remote_bytes_per_sec;
+    /// @brief Percent of requests that came from remote sockets.
+    double remote_pct;
+    /// @brief Directory lookups per second.
+    double dir_lookups_per_sec;
+    /// @brief Snoop responses per second.
+    double snoop_resp_per_sec;
+};
+
+/// @brief Structure containing Home Agent map and per-socket statistics.
+struct ha_data {
+    /// @brief Number of Home Agents on the node.
+    unsigned num_units;
+    /// @brief Home Agent map, ordered by socket and Home Agent.
+    struct csr_pci_unit *units;
+    /// @brief Number of sockets with at least one Home Agent.
+    unsigned num_sockets;
+    /// @brief CLOCK_MONOTONIC time of the last sample (seconds).
+    double timestamp;
+    /// @brief Length of the last sampling interval (seconds).
+    double elapsed;
+    /// @brief Statistics of each socket.
+    struct ha_socket_stats *stats;
+    /// @brief Raw counter values of each Home Agent.
+    uint64_t **ctr[HA_NUM_CTRS];
+    /// @brief Counter configuration of each Home Agent.
+    uint64_t **cfg[HA_NUM_CTRS];
+    /// @brief Counter values of each Home Agent at the previous sample.
+    uint64_t *old[HA_NUM_CTRS];
+};
+
+/// @brief Discover the Home Agents on first call and store the Home Agent
+/// data on the heap.
+///
+/// Home Agents are looked up by device ID in the shared uncore PCI device
+/// table (see csr_pci_units()).
+///
+/// @param [out] data Home Agent data.
+///
+/// @return 0 if successful, else -1 if no Home Agent exists.
+int ha_storage(struct ha_data **data);
+
+/// @brief Program local requests, remote requests, directory lookups, and
+/// snoop responses on every Home Agent with one CSR batch, and take a
+/// baseline sample.
+///
+/// @return 0 if successful, else -1 if CSR batch operations fail.
+int enable_ha(void);
+
+/// @brief Read the counters of every Home Agent with one CSR batch and
+/// compute per-socket statistics since the previous sample.
+///
+/// @return 0 if successful, else -1 if CSR batch operations fail.
+int poll_ha_data(void);
+
+/// @brief Print the label for the Home Agent data print out.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_ha_data_label(FILE *writedest);
+
+/// @brief Print per-socket Home Agent statistics of the last sample.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_ha_data(FILE *writedest);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -42,25 +42,96 @@
 
 #define NUMCTRS 8
 
+/// @brief Number of iMC counters per channel: four general-purpose counters
+/// and the fixed DRAM clock (DCLK) counter, which is addressed as counter 4.
+#define IMC_NUM_CTRS 5
+
+/// @brief Counter index of the fixed DRAM clock (DCLK) counter.
+#define IMC_FIXED_CTR 4
+
+/// @brief Fixed counter control enable bit.
+#define IMC_FIXED_CTL_EN (1UL << 22)
+/// @brief Fixed counter control overflow enable bit.
+#define IMC_FIXED_CTL_OVF_EN (1UL << 20)
+
+/// @brief Bit width of the iMC PMON counters.
+#define IMC_CTR_WIDTH 48
+
+/// @brief PMON unit control freeze bit.
+#define IMC_UNIT_CTL_FRZ (1UL << 8)
+#if COMPILED_ARCH != 0x3F
+/// @brief PMON unit control freeze enable bit (reserved on Haswell).
+#define IMC_UNIT_CTL_FRZ_EN (1UL << 16)
+#else
+#define IMC_UNIT_CTL_FRZ_EN (0UL)
+#endif
+
+/// @brief Structure describing one populated iMC channel.
+struct imc_channel {
+    /// @brief PCI bus number the channel was discovered on.
+    uint8_t pci_bus;
+    /// @brief PCI device of the channel PMON function.
+    uint8_t device;
+    /// @brief PCI function of the channel PMON function.
+    uint8_t function;
+    /// @brief Socket the channel belongs to.
+    uint8_t socket;
+    /// @brief Memory controller within the socket.
+    uint8_t imc;
+    /// @brief Channel within the memory controller.
+    uint8_t channel;
+};
+
+/// @brief Structure containing the iMC channel map of the node.
+///
+/// Channels are ordered by socket, then memory controller, then channel. The
+/// per-channel arrays of the iMC counter storage use the same order.
+struct imc_topology {
+    /// @brief Number of sockets with at least one iMC channel.
+    unsigned num_sockets;
+    /// @brief Total number of iMC channels.
+    unsigned num_channels;
+    /// @brief Index of the first channel of each socket, with
+    /// socket_first[num_sockets] == num_channels.
+    unsigned *socket_first;
+    /// @brief Channel map.
+    struct imc_channel *channels;
+    /// @brief Non-zero if the map was discovered from sysfs, 0 if it was
+    /// built from the platform header defaults.
+    int discovered;
+};
+
+/// @brief Index of a counter of a channel in the flat iMC counter storage.
+///
+/// Channels follow the order of the iMC channel map (grouped by socket), so
+/// the storage is laid out as [socket][channel][counter].
+#define IMC_CTR_IDX(channel, counter) ((channel) * IMC_NUM_CTRS + (counter))
+
 /// @brief Structure containing data of per-component performance counters.
+///
+/// Values and configurations of every counter of every channel are stored
+/// densely, IMC_NUM_CTRS per channel (see IMC_CTR_IDX()). Counter 4 is the
+/// fixed DRAM clock counter.
 struct pmonctrs_data {
-    uint64_t **ctr0;
-    uint64_t **ctr1;
-    uint64_t **ctr2;
-    uint64_t **ctr3;
-    uint64_t **ctr4;
-    // config
-    uint64_t **ctrcfg0;
-    uint64_t **ctrcfg1;
-    uint64_t **ctrcfg2;
-    uint64_t **ctrcfg3;
-    uint64_t **ctrcfg4;
+    /// @brief Number of iMC channels.
+    unsigned num_channels;
+    /// @brief Counter values, refreshed after every iMC counter read.
+    uint64_t *value;
+    /// @brief Counter configurations, written to the iMC with every
+    /// configuration change.
+    uint64_t *config;
 };
 
-/// @todo Document fixed_perfmon_data struct.
+/// @brief Structure containing data of the per-channel fixed DRAM clock
+/// (DCLK) counter.
+///
+/// Entries point into the flat iMC counter storage at counter
+/// IMC_FIXED_CTR.
 struct fixed_perfmon_data {
+    /// @brief Raw value stored in the fixed counter.
     uint64_t **fctr;
     // config
+    /// @brief Raw value stored in the fixed counter control.
     uint64_t **fctrcfg;
 };
 
@@ -70,11 +141,109 @@ struct pmonctr_global {
     uint64_t **unitstatus;
 };
 
+/// @brief Discover the iMC channel map on first call and store it on the
+/// heap.
+///
+/// Channels are looked up by the iMC PMON device IDs of the platform in the
+/// shared uncore PCI device table (see csr_pci_find()). If no channel is found
+/// (e.g., sysfs is not mounted), the map falls back to the device and function
+/// defaults of the platform header for every socket.
+///
+/// @return Pointer to iMC channel map.
+struct imc_topology *imc_topology_storage(void);
+
+/// @brief iMC counter programmed with CAS_COUNT.RD by enable_imc_metrics().
+#define IMC_METRICS_CAS_RD_CTR 0
+/// @brief iMC counter programmed with CAS_COUNT.WR by enable_imc_metrics().
+#define IMC_METRICS_CAS_WR_CTR 1
+/// @brief iMC counter programmed with ACT_COUNT by enable_imc_metrics().
+#define IMC_METRICS_ACT_CTR 2
+/// @brief iMC counter programmed with PRE_COUNT.PAGE_MISS by
+/// enable_imc_metrics().
+#define IMC_METRICS_PRE_MISS_CTR 3
+
+/// @brief Structure containing DRAM page and read/write mix metrics over one
+/// sampling interval.
+struct imc_metrics {
+    /// @brief Fraction of CAS commands hitting an open page.
+    double page_hit;
+    /// @brief Fraction of CAS commands to a closed bank (activate without
+    /// precharge).
+    double page_empty;
+    /// @brief Fraction of CAS commands that required closing another page.
+    double page_miss;
+    /// @brief Fraction of CAS commands that were reads.
+    double read_ratio;
+    /// @brief CAS_COUNT.RD events in the interval.
+    uint64_t cas_rd;
+    /// @brief CAS_COUNT.WR events in the interval.
+    uint64_t cas_wr;
+    /// @brief ACT_COUNT events in the interval.
+    uint64_t act;
+    /// @brief PRE_COUNT.PAGE_MISS events in the interval.
+    uint64_t pre_miss;
+    /// @brief DRAM clock ticks in the interval.
+    uint64_t dclk;
+};
+
+/// @brief Structure containing iMC metrics of every channel and socket.
+///
+/// Channel entries follow the order of the iMC channel map (see
+/// imc_topology_storage()).
+struct imc_metrics_data {
+    /// @brief Number of iMC channels.
+    unsigned num_channels;
+    /// @brief Number of sockets.
+    unsigned num_sockets;
+    /// @brief Metrics of each channel.
+    struct imc_metrics *channel;
+    /// @brief Metrics of each socket.
+    struct imc_metrics *socket;
+    /// @brief Counter values at the previous sample, laid out like the flat
+    /// iMC counter storage (see IMC_CTR_IDX()).
+    uint64_t *old;
+};
+
 /// @brief Store the PMON counter data on the heap.
 ///
 /// @return Pointer to PMON counter data.
 struct pmonctrs_data *pmon_ctr_storage(void);
 
+/// @brief Retrieve a counter value from the flat iMC counter storage.
+///
+/// @param [in] socket Socket of the channel.
+///
+/// @param [in] channel Index of the channel within the socket.
+///
+/// @param [in] counter Unique counter identifier.
+///
+/// @return Pointer to the counter value, else NULL if the socket, channel, or
+/// counter does not exist.
+uint64_t *imc_ctr_value(const unsigned socket,
+                        const unsigned channel,
+                        const unsigned counter);
+
+/// @brief Retrieve a counter configuration from the flat iMC counter storage.
+///
+/// Changes are written to the iMC by the next pmon_config() call.
+///
+/// @param [in] socket Socket of the channel.
+///
+/// @param [in] channel Index of the channel within the socket.
+///
+/// @param [in] counter Unique counter identifier.
+///
+/// @return Pointer to the counter configuration, else NULL if the socket,
+/// channel, or counter does not exist.
+uint64_t *imc_ctr_config(const unsigned socket,
+                         const unsigned channel,
+                         const unsigned counter);
+
+/// @brief Store the fixed DRAM clock counter data on the heap.
+///
+/// @return Pointer to fixed DRAM clock counter data.
+struct fixed_perfmon_data *fixed_perfmon_storage(void);
+
 /// @brief the PMON global counter data on the heap.
 ///
 /// @return Pointer to PMON global counter data.
@@ -82,14 +251,18 @@ struct pmonctr_global *pmonctr_global_storage(void);
 
 /// @brief Initialize storage for PMON performance counter data.
 ///
-/// @return -1 if PMON counters have been initialized, else
-/// 10*NUMCTRS*num_sockets.
+/// Loads one fused batch with every counter (CSR_IMC_CTRS), one sub-batch per
+/// counter (CSR_IMC_CTR0-3, CSR_IMC_FIXED_CTR), and one batch with every
+/// counter configuration including the fixed counter control (CSR_IMC_EVTS).
+///
+/// @return -1 if PMON counters have been initialized, else 15 times the number
+/// of iMC channels.
 int init_pmon_ctrs(void);
 
 /// @brief Initialize storage for PMON global performance counter data.
 ///
-/// @return -1 if PMON global counters have been initialized, else
-/// 2*NUMCTRS*num_sockets.
+/// @return -1 if PMON global counters have been initialized, else 2 times the
+/// number of iMC channels.
 int init_pmonctr_global(void);
 
 /// @brief Configure iMC performance counters.
@@ -107,7 +280,8 @@ int init_pmonctr_global(void);
 ///
 /// @param [in] event Select event to be counted.
 ///
-/// @param [in] counter Unique counter identifier.
+/// @param [in] counter Unique counter identifier. Counter IMC_FIXED_CTR only
+///        uses ovf_en; the DRAM clock event is fixed.
 ///
 /// @return 0 if set_pmon_config() and do_csr_batch_op() are successful, else
 /// -1 if counter does not exist.
@@ -141,7 +315,8 @@ int set_pmon_unit_ctrl(uint32_t ovf_en,
 
 /// @brief iMC memory bandwidth performance counter.
 ///
-/// @param [in] counter Unique counter identifier.
+/// @param [in] counter Unique counter identifier. The fixed DCLK counter
+/// (IMC_FIXED_CTR) cannot count events.
 ///
 /// @param [in] type csr_data_type_e data type of event.
 ///
@@ -171,7 +346,10 @@ int mem_page_empty_on_ctr(const unsigned act_count,
 int mem_page_miss_on_ctr(const unsigned pre_count,
                          const unsigned cas_count);
 
-/// @brief Read iMC counters.
+/// @brief Read one iMC counter of every channel with a single CSR batch.
+///
+/// Only the sub-batch of the requested counter is read; its values are then
+/// copied into the flat iMC counter storage like those of the fused batch.
 ///
 /// @param [in] counter Unique counter identifier.
 ///
@@ -179,13 +357,109 @@ int mem_page_miss_on_ctr(const unsigned pre_count,
 /// exist.
 int read_imc_counter_batch(const unsigned counter);
 
+/// @brief Read a set of iMC counters of every channel with a single CSR batch.
+///
+/// A set with one counter uses that counter's sub-batch, any larger set uses
+/// the fused CSR_IMC_CTRS batch.
+///
+/// @param [in] mask Bit i set selects counter i (0 to IMC_FIXED_CTR).
+///
+/// @return 0 if do_csr_batch_op() was successful, else -1 if the mask selects
+/// no counter or a counter that does not exist.
+int read_imc_counters(const unsigned mask);
+
+/// @brief Modes of read_imc_snapshot().
+enum imc_snapshot_mode_e {
+    /// @brief Freeze every iMC unit, read all counters, and unfreeze, so that
+    /// every channel is read at the same point of its count.
+    IMC_SNAPSHOT_FREEZE,
+    /// @brief Read all counters while they run and estimate the skew.
+    IMC_SNAPSHOT_NOFREEZE,
+};
+
+/// @brief Structure containing one snapshot of every iMC counter.
+///
+/// Channel entries follow the order of the iMC channel map (see
+/// imc_topology_storage()).
+struct imc_snapshot {
+    /// @brief Number of iMC channels.
+    unsigned num_channels;
+    /// @brief Counter values, laid out like the flat iMC counter storage (see
+    /// IMC_CTR_IDX()).
+    uint64_t *value;
+    /// @brief CLOCK_MONOTONIC time at the middle of the snapshot (seconds).
+    double timestamp;
+    /// @brief Duration of the CSR batch of the snapshot (seconds). Without
+    /// freezing, this bounds the time between the first and last read.
+    double skew;
+    /// @brief DRAM clocks counted by the first channel between the first and
+    /// last read. Only measured without freezing, else 0.
+    uint64_t skew_dclk;
+    /// @brief Mode the snapshot was taken in.
+    int mode;
+};
+
+/// @brief Set up the snapshot batches on first call and store the snapshot
+/// data on the heap.
+///
+/// The freeze batch holds a unit control write per channel that sets
+/// IMC_UNIT_CTL_FRZ, the reads of every counter, and a unit control write per
+/// channel that clears it. The no-freeze batch holds the reads of every
+/// counter followed by a second read of the first channel's DRAM clock
+/// counter.
+///
+/// @param [out] data iMC snapshot data.
+///
+/// @return 0 if successful, else -1 if the iMC channel map is empty.
+int imc_snapshot_storage(struct imc_snapshot **data);
+
+/// @brief Read every iMC counter of every channel with a single CSR ioctl.
+///
+/// The counter values are also copied into the flat iMC counter storage.
+///
+/// @param [in] mode imc_snapshot_mode_e mode of the snapshot.
+///
+/// @return 0 if successful, else -1 if the mode is invalid or CSR batch
+/// operations fail.
+int read_imc_snapshot(const int mode);
+
+/// @brief Store the iMC metrics data on the heap.
+///
+/// @param [out] data iMC metrics data.
+///
+/// @return 0 if successful, else -1 if the iMC channel map is empty.
+int imc_metrics_storage(struct imc_metrics_data **data);
+
+/// @brief Derive the page hit, page empty, page miss and read ratios of an
+/// interval from its event counts.
+///
+/// Page empties are activates not caused by a page miss. All ratios are 0
+/// if no CAS was counted.
+///
+/// @param [in,out] m Event counts in, ratios out.
+void imc_metrics_ratios(struct imc_metrics *m);
+
+/// @brief Program CAS_COUNT.RD, CAS_COUNT.WR, ACT_COUNT, PRE_COUNT.PAGE_MISS
+/// and the fixed DRAM clock counter on every channel with one CSR_IMC_EVTS
+/// write, and take a baseline sample.
+///
+/// @return 0 if successful, else -1 if CSR batch operations fail.
+int enable_imc_metrics(void);
+
+/// @brief Read every iMC counter with one CSR batch and compute the page hit,
+/// page empty, page miss and read ratios of each channel and socket since the
+/// previous sample.
+///
+/// @return 0 if successful, else -1 if CSR batch operations fail.
+int poll_imc_metrics(void);
+
 /// @brief Print memory bandwidth.
 ///
 /// @param [in] counter Unique counter identifier.
 ///
 /// @param [in] writedest File stream where output will be written to.
 ///
-/// @return 0 if successful.
+/// @return 0 if successful, else -1 if the counter read fails.
 int print_mem_bw_from_ctr(const unsigned counter,
                           FILE *writedest);
 
@@ -199,7 +473,7 @@ int print_mem_bw_from_ctr(const unsigned counter,
 ///
 /// @param [in] writedest File stream where output will be written to.
 ///
-/// @return 0 if successful.
+/// @return 0 if successful, else -1 if the counter read fails.
 int print_mem_pct_rw_from_ctr(const unsigned rcounter,
                               const unsigned wcounter,
                               int type,
@@ -209,7 +483,7 @@ int print_mem_pct_rw_from_ctr(const unsigned rcounter,
 ///
 /// @todo Document print_mem_page_empty_from_ctr() parameters.
 ///
-/// @return 0 if successful.
+/// @return 0 if successful, else -1 if the counter read fails.
 int print_mem_page_empty_from_ctr(const unsigned act,
                                   const unsigned pre,
                                   const unsigned cas,
@@ -219,7 +493,7 @@ int print_mem_page_empty_from_ctr(const unsigned act,
 ///
 /// @todo Document print_mem_page_miss_from_ctr() parameters.
 ///
-/// @return 0 if successful.
+/// @return 0 if successful, else -1 if the counter read fails.
 int print_mem_page_miss_from_ctr(const unsigned pre,
                                  const unsigned cas,
                                  FILE *writedest);
@@ -0,0 +1,159 @@
+/* csr_membw.h
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#ifndef CSR_MEMBW_H_INCLUDE
+#define CSR_MEMBW_H_INCLUDE
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "master.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief iMC counter programmed with CAS_COUNT.RD by enable_membw().
+#define MEMBW_RD_CTR 0
+/// @brief iMC counter programmed with CAS_COUNT.WR by enable_membw().
+#define MEMBW_WR_CTR 1
+/// @brief Bit width of the iMC PMON counters.
+#define MEMBW_CTR_WIDTH 48
+/// @brief Bytes transferred per CAS command (one cache line).
+#define MEMBW_BYTES_PER_CAS 64
+
+/// @brief Structure containing memory bandwidth over the last sampling
+/// interval.
+///
+/// Channel arrays follow the order of the iMC channel map (see
+/// imc_topology_storage()).
+struct membw_data {
+    /// @brief Number of iMC channels.
+    unsigned num_channels;
+    /// @brief Number of sockets.
+    unsigned num_sockets;
+    /// @brief CLOCK_MONOTONIC time of the last sample (seconds).
+    double timestamp;
+    /// @brief Length of the last sampling interval (seconds).
+    double elapsed;
+    /// @brief Read bandwidth of each channel (GB/s).
+    double *channel_read;
+    /// @brief Write bandwidth of each channel (GB/s).
+    double *channel_write;
+    /// @brief Non-zero if the counters of the channel were read in the last
+    /// sample. Channels that failed report 0 GB/s and are left out of the
+    /// socket and node totals.
+    int *channel_valid;
+    /// @brief CLOCK_MONOTONIC time of the last successful read of each
+    /// channel (seconds), or 0 if the channel has no baseline yet.
+    double *channel_stamp;
+    /// @brief Read bandwidth of each socket (GB/s).
+    double *socket_read;
+    /// @brief Write bandwidth of each socket (GB/s).
+    double *socket_write;
+    /// @brief Read bandwidth of the node (GB/s).
+    double node_read;
+    /// @brief Write bandwidth of the node (GB/s).
+    double node_write;
+    /// @brief Raw CAS_COUNT.RD value of each channel.
+    uint64_t **rd;
+    /// @brief Raw CAS_COUNT.WR value of each channel.
+    uint64_t **wr;
+    /// @brief CAS_COUNT.RD value of each channel at the previous sample.
+    uint64_t *old_rd;
+    /// @brief CAS_COUNT.WR value of each channel at the previous sample.
+    uint64_t *old_wr;
+};
+
+/// @brief Function called with the bandwidth data after every sample.
+///
+/// @param [in] data Memory bandwidth over the last sampling interval.
+///
+/// @param [in] arg User argument given to set_membw_callback().
+typedef void (*membw_callback_t)(const struct membw_data *data, void *arg);
+
+/// @brief Store the memory bandwidth data on the heap.
+///
+/// @param [out] data Memory bandwidth data.
+///
+/// @return 0 if successful, else -1 if the iMC channel map is empty.
+int membw_storage(struct membw_data **data);
+
+/// @brief Program CAS_COUNT.RD and CAS_COUNT.WR on MEMBW_RD_CTR and
+/// MEMBW_WR_CTR of every iMC channel and take a baseline sample.
+///
+/// @return 0 if successful, else -1 if CSR batch operations fail.
+int enable_membw(void);
+
+/// @brief Sample the CAS counters of every channel in one CSR batch, stamp
+/// the sample with CLOCK_MONOTONIC, and compute bandwidth since the previous
+/// sample. Calls the registered callback, if any.
+///
+/// A channel whose counters fail to read is marked invalid for this sample
+/// only; its next good read covers the whole time since its last one.
+///
+/// @return 0 if successful, else -1 if the CSR batch fails as a whole.
+int poll_membw_data(void);
+
+/// @brief Register a function called after every poll_membw_data().
+///
+/// @param [in] cb Callback, or NULL to remove the current one.
+///
+/// @param [in] arg User argument passed to the callback.
+void set_membw_callback(membw_callback_t cb,
+                        void *arg);
+
+/// @brief Sample memory bandwidth at a fixed interval.
+///
+/// @param [in] interval_ms Sampling interval in milliseconds.
+///
+/// @param [in] count Number of samples to take.
+///
+/// @return 0 if successful, else -1 if a sample or the sleep fails.
+int monitor_membw(unsigned interval_ms,
+                  unsigned count);
+
+/// @brief Print the label for the memory bandwidth data print out.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_membw_data_label(FILE *writedest);
+
+/// @brief Print per-socket and node memory bandwidth of the last sample.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_membw_data(FILE *writedest);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,151 @@
+/* csr_qpi.h
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#ifndef CSR_QPI_H_INCLUDE
+#define CSR_QPI_H_INCLUDE
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "master.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Number of counters in each QPI port PMON box.
+#define QPI_NUM_CTRS 4
+/// @brief Bit width of the QPI PMON counters.
+#define QPI_CTR_WIDTH 48
+/// @brief Payload bytes carried by one data flit.
+#define QPI_BYTES_PER_FLIT 8
+
+/// @brief Counters programmed by enable_qpi().
+enum qpi_ctr_e {
+    /// @brief QPI clock cycles (one flit slot per cycle).
+    QPI_CTR_CLOCKTICKS,
+    /// @brief RxL_FLITS_G0.DATA: data flits received.
+    QPI_CTR_RX_DATA,
+    /// @brief TxL_FLITS_G0.DATA: data flits transmitted.
+    QPI_CTR_TX_DATA,
+    /// @brief RxL_FLITS_G0.IDLE: idle flits received.
+    QPI_CTR_RX_IDLE,
+};
+
+/// @brief Structure describing one QPI port.
+struct qpi_link {
+    /// @brief Socket of the port.
+    uint8_t socket;
+    /// @brief Port within the socket.
+    uint8_t port;
+    /// @brief PCI device of the port PMON function.
+    uint8_t device;
+    /// @brief PCI function of the port PMON function.
+    uint8_t function;
+};
+
+/// @brief Structure containing traffic of one QPI port over the last
+/// sampling interval.
+struct qpi_link_stats {
+    /// @brief Data bytes received per second.
+    double rx_bytes_per_sec;
+    /// @brief Data bytes transmitted per second.
+    double tx_bytes_per_sec;
+    /// @brief Percent of receive flit slots carrying data.
+    double rx_data_pct;
+    /// @brief Percent of transmit flit slots carrying data.
+    double tx_data_pct;
+    /// @brief Percent of receive flit slots that were not idle (data and
+    /// protocol traffic).
+    double rx_util_pct;
+};
+
+/// @brief Structure containing QPI port map and link statistics.
+struct qpi_data {
+    /// @brief Number of QPI ports on the node.
+    unsigned num_links;
+    /// @brief Port map, ordered by socket and port.
+    struct qpi_link *links;
+    /// @brief CLOCK_MONOTONIC time of the last sample (seconds).
+    double timestamp;
+    /// @brief Length of the last sampling interval (seconds).
+    double elapsed;
+    /// @brief Statistics of each port.
+    struct qpi_link_stats *stats;
+    /// @brief Raw counter values of each port.
+    uint64_t **ctr[QPI_NUM_CTRS];
+    /// @brief Counter configuration of each port.
+    uint64_t **cfg[QPI_NUM_CTRS];
+    /// @brief Counter values of each port at the previous sample.
+    uint64_t *old[QPI_NUM_CTRS];
+};
+
+/// @brief Discover the QPI ports on first call and store the QPI data on the
+/// heap.
+///
+/// Ports are looked up by device ID in the shared uncore PCI device table. If
+/// none is found, every port of the platform header is assumed on every
+/// socket.
+///
+/// @param [out] data QPI data.
+///
+/// @return 0 if successful, else -1 if no QPI port exists.
+int qpi_storage(struct qpi_data **data);
+
+/// @brief Program clock ticks, received and transmitted data flits, and
+/// received idle flits on every QPI port with one CSR batch, and take a
+/// baseline sample.
+///
+/// @return 0 if successful, else -1 if CSR batch operations fail.
+int enable_qpi(void);
+
+/// @brief Read the counters of every QPI port with one CSR batch and compute
+/// link statistics since the previous sample.
+///
+/// @return 0 if successful, else -1 if CSR batch operations fail.
+int poll_qpi_data(void);
+
+/// @brief Print the label for the QPI link data print out.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_qpi_data_label(FILE *writedest);
+
+/// @brief Print QPI link statistics of the last sample.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_qpi_data(FILE *writedest);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,139 @@
+/* csr_r2pcie.h
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#ifndef CSR_R2PCIE_H_INCLUDE
+#define CSR_R2PCIE_H_INCLUDE
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "master.h"
+#include "csr_core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Number of counters in each R2PCIe PMON box.
+#define R2PCIE_NUM_CTRS 4
+/// @brief Bit width of the R2PCIe PMON counters.
+#define R2PCIE_CTR_WIDTH 48
+/// @brief Number of ring direction/polarity slots counted by RING_*_USED.ALL.
+#define R2PCIE_RING_SLOTS 4
+
+/// @brief Counters programmed by enable_r2pcie().
+enum r2pcie_ctr_e {
+    /// @brief Uncore clock cycles.
+    R2PCIE_CTR_CLOCKTICKS,
+    /// @brief RING_AD_USED.ALL: cycles the address/request ring is used.
+    R2PCIE_CTR_AD_USED,
+    /// @brief RING_BL_USED.ALL: cycles the data block ring is used.
+    R2PCIE_CTR_BL_USED,
+    /// @brief RxR_CYCLES_NE.NCB/NCS: cycles the IO ingress queues are not
+    /// empty.
+    R2PCIE_CTR_RXR_NE,
+};
+
+/// @brief Structure containing R2PCIe traffic of one socket over the last
+/// sampling interval.
+struct r2pcie_socket_stats {
+    /// @brief Raw counter deltas of the last interval.
+    uint64_t delta[R2PCIE_NUM_CTRS];
+    /// @brief Percent of address ring slots used by IO, averaged over the
+    /// ring directions.
+    double ad_ring_pct;
+    /// @brief Percent of data ring slots used by IO, averaged over the ring
+    /// directions.
+    double bl_ring_pct;
+    /// @brief Percent of cycles with pending IO requests in the ingress
+    /// queues.
+    double ingress_busy_pct;
+};
+
+/// @brief Structure containing R2PCIe map and per-socket statistics.
+struct r2pcie_data {
+    /// @brief Number of R2PCIe boxes on the node (one per socket).
+    unsigned num_units;
+    /// @brief R2PCIe map, ordered by socket.
+    struct csr_pci_unit *units;
+    /// @brief CLOCK_MONOTONIC time of the last sample (seconds).
+    double timestamp;
+    /// @brief Length of the last sampling interval (seconds).
+    double elapsed;
+    /// @brief Statistics of each socket.
+    struct r2pcie_socket_stats *stats;
+    /// @brief Raw counter values of each R2PCIe box.
+    uint64_t **ctr[R2PCIE_NUM_CTRS];
+    /// @brief Counter configuration of each R2PCIe box.
+    uint64_t **cfg[R2PCIE_NUM_CTRS];
+    /// @brief Counter values of each R2PCIe box at the previous sample.
+    uint64_t *old[R2PCIE_NUM_CTRS];
+};
+
+/// @brief Discover the R2PCIe boxes on first call and store the R2PCIe data
+/// on the heap.
+///
+/// Boxes are looked up by device ID in the shared uncore PCI device table
+/// (see csr_pci_units()).
+///
+/// @param [out] data R2PCIe data.
+///
+/// @return 0 if successful, else -1 if no R2PCIe box exists.
+int r2pcie_storage(struct r2pcie_data **data);
+
+/// @brief Program clock ticks, AD and BL ring usage, and ingress occupancy on
+/// every R2PCIe box with one CSR batch, and take a baseline sample.
+///
+/// @return 0 if successful, else -1 if CSR batch operations fail.
+int enable_r2pcie(void);
+
+/// @brief Read the counters of every R2PCIe box with one CSR batch and
+/// compute per-socket statistics since the previous sample.
+///
+/// @return 0 if successful, else -1 if CSR batch operations fail.
+int poll_r2pcie_data(void);
+
+/// @brief Print the label for the R2PCIe data print out.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_r2pcie_data_label(FILE *writedest);
+
+/// @brief Print per-socket R2PCIe statistics of the last sample.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_r2pcie_data(FILE *writedest);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,234 @@
+/* msr_cbo.h
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#ifndef MSR_CBO_H_INCLUDE
+#define MSR_CBO_H_INCLUDE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+#include "master.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Caching Agent (CBo) uncore performance monitoring. There is one CBo per LLC
+ * slice, each with four counters. Counter 0 is the only counter able to count
+ * TOR occupancy events. */
+
+/// @brief Number of general-purpose counters in each CBo.
+#define CBO_NUM_CTRS 4
+
+/// @brief MSR_Cn_PMON_BOX_CTL reset control (event select) bit.
+#define CBO_BOX_RST_CTRL (1UL << 0)
+/// @brief MSR_Cn_PMON_BOX_CTL reset counters bit.
+#define CBO_BOX_RST_CTRS (1UL << 1)
+/// @brief MSR_Cn_PMON_BOX_CTL freeze bit.
+#define CBO_BOX_FRZ (1UL << 8)
+#if COMPILED_ARCH != 0x3F
+/// @brief MSR_Cn_PMON_BOX_CTL freeze enable bit (reserved on Haswell).
+#define CBO_BOX_FRZ_EN (1UL << 16)
+#else
+#define CBO_BOX_FRZ_EN (0UL)
+#endif
+
+/// @brief MSR_Cn_PMON_EVNTSEL local counter enable bit.
+#define CBO_EVTSEL_EN (1UL << 22)
+
+/// @brief Enum encompassing named CBo events.
+enum cbo_event_e {
+    /// @brief Uncore clock cycles.
+    CBO_CLOCKTICKS,
+    /// @brief LLC lookups of any type (subject to the state filter).
+    CBO_LLC_LOOKUP_ANY,
+    /// @brief LLC lookups for data reads (subject to the state filter).
+    CBO_LLC_LOOKUP_DATA_READ,
+    /// @brief LLC lookups for writes (subject to the state filter).
+    CBO_LLC_LOOKUP_WRITE,
+    /// @brief Lines victimized from the LLC.
+    CBO_LLC_VICTIMS,
+    /// @brief Requests inserted into the TOR.
+    CBO_TOR_INSERTS_ALL,
+    /// @brief Requests inserted into the TOR that missed the LLC.
+    CBO_TOR_INSERTS_MISS_ALL,
+    /// @brief Requests matching the opcode filter inserted into the TOR.
+    CBO_TOR_INSERTS_OPCODE,
+    /// @brief Occupancy of all requests in the TOR (counter 0 only).
+    CBO_TOR_OCCUPANCY_ALL,
+    /// @brief Occupancy of LLC-missing requests in the TOR (counter 0 only).
+    CBO_TOR_OCCUPANCY_MISS_ALL,
+    /// @brief Number of named CBo events.
+    CBO_NUM_EVENTS,
+};
+
+/// @brief Structure containing CBo control and counter data.
+///
+/// Per-slice arrays are indexed by (slice * sockets + socket).
+struct cbo_data {
+    /// @brief Number of CBo slices per socket.
+    int num_slices;
+    /// @brief Number of counters programmed by set_cbo_events().
+    int num_events;
+    /// @brief Event programmed on each counter.
+    enum cbo_event_e event[CBO_NUM_CTRS];
+    /// @brief Raw 64-bit value stored in MSR_Cn_PMON_BOX_CTL.
+    uint64_t **box_ctl;
+    /// @brief Raw 64-bit value stored in MSR_Cn_PMON_EVNTSEL[0-3].
+    uint64_t **evtsel[CBO_NUM_CTRS];
+    /// @brief Raw 64-bit value stored in MSR_Cn_BOX_FILTER.
+    uint64_t **filter;
+    /// @brief Raw 64-bit value stored in MSR_Cn_BOX_FILTER1 (if it exists).
+    uint64_t **filter1;
+    /// @brief Raw value stored in MSR_Cn_PMON_CTR[0-3].
+    uint64_t **ctr[CBO_NUM_CTRS];
+    /// @brief Previous raw value of each counter.
+    uint64_t *old_ctr[CBO_NUM_CTRS];
+    /// @brief Counter increments between the last two polls per slice.
+    uint64_t *delta[CBO_NUM_CTRS];
+    /// @brief Counter increments between the last two polls summed over all
+    /// slices of each socket.
+    uint64_t *socket_delta[CBO_NUM_CTRS];
+    /// @brief Time of the current poll.
+    struct timeval now;
+    /// @brief Time of the previous poll.
+    struct timeval old_now;
+    /// @brief Time elapsed between the last two polls (in seconds).
+    double elapsed;
+};
+
+/// @brief Structure containing LLC statistics of a socket derived from the
+/// last poll.
+struct cbo_llc_stats {
+    /// @brief LLC lookups (CBO_LLC_LOOKUP_ANY).
+    uint64_t lookups;
+    /// @brief LLC misses (CBO_TOR_INSERTS_MISS_ALL).
+    uint64_t misses;
+    /// @brief Misses divided by lookups.
+    double miss_ratio;
+    /// @brief Average number of outstanding LLC misses per uncore cycle.
+    double avg_miss_occupancy;
+    /// @brief Average miss latency (in uncore cycles).
+    double avg_miss_latency;
+};
+
+/// @brief Store the CBo control and counter data on the heap.
+///
+/// Controls for every slice on every socket are loaded into the CBO_CTRL
+/// batch and counters into the CBO_DATA batch.
+///
+/// @param [out] cd Pointer to CBo data.
+void cbo_storage(struct cbo_data **cd);
+
+/// @brief Get the name of a CBo event.
+///
+/// @param [in] event cbo_event_e identifier of the event.
+///
+/// @return Name of the event, else "UNKNOWN".
+const char *cbo_event_name(enum cbo_event_e event);
+
+/// @brief Program up to four named events on every slice of every socket.
+///
+/// All slices are programmed and their counters reset with one batch write.
+///
+/// @param [in] events Array of cbo_event_e identifiers, one per counter.
+///
+/// @param [in] nevents Number of events (1 to CBO_NUM_CTRS).
+///
+/// @return 0 if successful, else -1 if an event is invalid or a TOR
+/// occupancy event is not on counter 0.
+int set_cbo_events(const enum cbo_event_e *events,
+                   int nevents);
+
+/// @brief Set the CBo filter registers on every slice of every socket.
+///
+/// MSR_Cn_BOX_FILTER holds the LLC state filter (see CBO_FILTER_STATE_ALL)
+/// and, on Sandy Bridge, the opcode filter. MSR_Cn_BOX_FILTER1 holds the
+/// opcode filter where it exists and is ignored otherwise.
+///
+/// @param [in] filter Raw value for MSR_Cn_BOX_FILTER.
+///
+/// @param [in] filter1 Raw value for MSR_Cn_BOX_FILTER1.
+///
+/// @return 0 if successful, else -1 if the batch write fails.
+int set_cbo_filter(uint64_t filter,
+                   uint64_t filter1);
+
+/// @brief Program the events used by get_cbo_llc_stats() and open the LLC
+/// state filter.
+///
+/// @return 0 if successful, else -1.
+int set_cbo_llc_events(void);
+
+/// @brief Freeze, unfreeze, or reset all CBo counters with one batch write.
+///
+/// @param [in] freeze Non-zero to freeze the counters, 0 to let them count.
+///
+/// @param [in] reset Non-zero to reset the counters to 0.
+///
+/// @return 0 if successful, else -1 if the batch write fails.
+int cbo_box_ctrl(int freeze,
+                 int reset);
+
+/// @brief Read all slice counters with one batch read and compute per-slice
+/// and per-socket deltas since the previous poll.
+///
+/// @return 0 if successful, else -1 if read_batch() fails.
+int poll_cbo_data(void);
+
+/// @brief Derive LLC statistics of a socket from the last poll.
+///
+/// @param [in] socket Unique socket/package identifier.
+///
+/// @param [out] stats LLC statistics.
+///
+/// @return 0 if successful, else -1 if the events of set_cbo_llc_events() are
+/// not programmed.
+int get_cbo_llc_stats(const unsigned socket,
+                      struct cbo_llc_stats *stats);
+
+/// @brief Print the label for the CBo data print out.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_cbo_data_label(FILE *writedest);
+
+/// @brief Print per-socket CBo deltas from the last poll.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_cbo_data(FILE *writedest);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -35,6 +35,7 @@
 #define MSR_CLOCKS_H_INCLUDE
 
 #include <stdint.h>
+#include <stdio.h>
 
 #include "master.h"
 
@@ -86,6 +87,39 @@ struct perf_data {
     uint64_t **perf_ctl;
 };
 
+/// @brief Width of an effective frequency histogram bin (MHz).
+#define FREQ_HIST_BIN_MHZ 100
+/// @brief Number of effective frequency histogram bins. The last bin also
+/// counts every interval above its range.
+#define FREQ_HIST_NUM_BINS 64
+
+/// @brief Structure holding per-thread effective frequency histograms built
+/// from the CLOCKS_DATA batch.
+///
+/// Each sampling interval adds one count to the bin of the effective
+/// frequency TSC rate * dAPERF/dMPERF of every thread, i.e., the average
+/// frequency while the thread was not halted. Everything is allocated by
+/// freq_hist_storage(), so updates never allocate.
+struct freq_hist {
+    /// @brief Number of logical processors, in CLOCKS_DATA order.
+    uint64_t num_threads;
+    /// @brief TSC rate (MHz), the nominal frequency from MSR_PLATFORM_INFO.
+    uint64_t tsc_mhz;
+    /// @brief Counts per thread, indexed by
+    /// thread * FREQ_HIST_NUM_BINS + bin.
+    uint32_t *bins;
+    /// @brief Number of intervals per thread with no unhalted cycles.
+    uint32_t *idle;
+    /// @brief IA32_APERF per thread at the previous update.
+    uint64_t *last_aperf;
+    /// @brief IA32_MPERF per thread at the previous update.
+    uint64_t *last_mperf;
+    /// @brief Non-zero once a first snapshot has been taken.
+    int primed;
+    /// @brief Number of intervals binned since the last reset.
+    uint64_t intervals;
+};
+
 /// @brief Allocate array for storing raw register data from IA32_APERF,
 /// IA32_MPERF, and IA32_TIME_STAMP_COUNTER.
 ///
@@ -128,6 +162,57 @@ void set_p_state(unsigned socket,
 /// @param [in] writedest File stream where output will be written to.
 void dump_clocks_data_readable(FILE *writedest);
 
+/// @brief Allocate the effective frequency histograms and the CLOCKS_DATA
+/// batch they are built from.
+///
+/// @param [out] fh Pointer to effective frequency histograms.
+///
+/// @return 0 if successful, else -1 if MSR_PLATFORM_INFO could not be read.
+int freq_hist_storage(struct freq_hist **fh);
+
+/// @brief Bin the interval since the previous update from the values
+/// already in the CLOCKS_DATA batch.
+///
+/// Meant to run right after the sampler read CLOCKS_DATA, for example as
+/// part of a libmsr_sample_run() transaction. The first call only takes a
+/// snapshot.
+///
+/// @return 0 if successful, else -1 if the histograms are not available.
+int freq_hist_update(void);
+
+/// @brief Read the CLOCKS_DATA batch and bin the interval since the previous
+/// poll.
+///
+/// @return 0 if successful, else -1 if the read batch failed or the
+/// histograms are not available.
+int poll_freq_hist(void);
+
+/// @brief Clear all histogram counts and drop the previous snapshot.
+void freq_hist_reset(void);
+
+/// @brief Print the effective frequency histograms as CSV.
+///
+/// The threads of each core are merged into one row per core, and a last
+/// row merges every core. Columns are the lower bound of each bin (MHz),
+/// preceded by the number of idle intervals.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_freq_hist_csv(FILE *writedest);
+
+/// @brief Write the raw per-thread histograms in binary form.
+///
+/// The output is a header of six uint32 values (magic "FHST", version 1,
+/// number of threads, number of bins, bin width in MHz, and TSC rate in
+/// MHz), then the per-thread idle counts, then the per-thread bins, all
+/// native-endian uint32 values. Files from several nodes or runs can be
+/// merged by adding the arrays.
+///
+/// @param [in] writedest File stream where output will be written to.
+///
+/// @return 0 if successful, else -1 if the histograms are not available or
+/// a write failed.
+int dump_freq_hist_binary(FILE *writedest);
+
 /****************************************/
 /* Software Controlled Clock Modulation */
 /****************************************/
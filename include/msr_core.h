@@ -46,6 +46,16 @@ extern "C" {
 #define X86_IOC_MSR_BATCH _IOWR('c', 0xA2, struct msr_batch_array)
 #define MSR_BATCH_DIR "/dev/cpu/msr_batch"
 #define FILENAME_SIZE 1024
+
+/// @brief Number of 64-bit words in a CPU bitmask covering n logical
+/// processors.
+#define CPUMASK_WORDS(n) (((n) + 63) / 64)
+/// @brief Add logical processor cpu to bitmask mask.
+#define CPUMASK_SET(mask, cpu) ((mask)[(cpu) / 64] |= (uint64_t)1 << ((cpu) % 64))
+/// @brief Remove logical processor cpu from bitmask mask.
+#define CPUMASK_CLR(mask, cpu) ((mask)[(cpu) / 64] &= ~((uint64_t)1 << ((cpu) % 64)))
+/// @brief Check if logical processor cpu is in bitmask mask.
+#define CPUMASK_ISSET(mask, cpu) (((mask)[(cpu) / 64] >> ((cpu) % 64)) & 1)
 //#define USE_NO_BATCH 1
 
 /// @brief Enum encompassing type of data being read to/written from MSRs.
@@ -93,6 +103,57 @@ enum libmsr_data_type_e {
     UNCORE_EVTSEL,
     /// @brief Uncore general-performance counter measurements.
     UNCORE_COUNT,
+    /// @brief Uncore PCU counter measurements and package energy.
+    PCU_DATA,
+    /// @brief Uncore PCU box control and frequency band filter.
+    PCU_BOX_CTRL,
+    /// @brief Caching agent (CBo) box controls, event selects, and filters.
+    CBO_CTRL,
+    /// @brief Caching agent (CBo) counter measurements.
+    CBO_DATA,
+    /// @brief Unhalted core cycles and general-purpose counter measurements
+    /// for top-down analysis.
+    TOPDOWN_DATA,
+    /// @brief IA32_PERF_GLOBAL_STATUS read together with the fixed-function
+    /// and general-purpose performance counters.
+    COUNTERS_OVF_DATA,
+    /// @brief IA32_PERF_GLOBAL_OVF_CTRL writes clearing overflow status.
+    COUNTERS_OVF_CTRL,
+    /// @brief IA32_PERF_CTL on every logical processor, indexed by CPU.
+    PSTATE_CTL,
+    /// @brief IA32_PERF_CTL readback and IA32_PERF_STATUS on every logical
+    /// processor, indexed by CPU.
+    PSTATE_DATA,
+    /// @brief IA32_APERF, IA32_MPERF, TSC, and fixed counters 0 and 1 on
+    /// every logical processor, sampled by the frequency governor.
+    GOVERNOR_DATA,
+    /// @brief IA32_CLOCK_MODULATION on every logical processor, indexed by
+    /// CPU.
+    TSTATE_CTL,
+    /// @brief Package and core C-state residencies, IA32_MPERF per core,
+    /// and the TSC per socket, sampled together.
+    CRES_SAMPLE,
+    /// @brief IA32_MISC_ENABLE and IA32_PERF_CTL on every logical
+    /// processor, indexed by CPU.
+    TURBO_DATA,
+    /// @brief MSR_UNCORE_RATIO_LIMIT per socket.
+    UNCORE_FREQ_CTL,
+    /// @brief U-box UCLK fixed counter control per socket.
+    UNCORE_FREQ_EVT,
+    /// @brief U-box UCLK fixed counter per socket.
+    UNCORE_FREQ_DATA,
+    /// @brief Core, graphics, and ring perf limit reasons per socket.
+    PERF_LIMIT_DATA,
+    /// @brief IA32_PM_ENABLE per socket.
+    HWP_ENABLE,
+    /// @brief IA32_HWP_CAPABILITIES per thread.
+    HWP_CAP,
+    /// @brief IA32_HWP_REQUEST per thread.
+    HWP_REQ,
+    /// @brief IA32_HWP_REQUEST_PKG per socket.
+    HWP_PKG_REQ,
+    /// @brief IA32_ENERGY_PERF_BIAS per thread.
+    EPB_CTL,
     /// @brief User-defined batch MSR data.
     USR_BATCH0,
     /// @brief User-defined batch MSR data.
@@ -278,6 +339,24 @@ int cores_assert(const unsigned *core,
                  const int location,
                  const char *file);
 
+/// @brief Map an index of an array loaded with load_thread_batch() to its
+/// platform coordinates.
+///
+/// @param [in] idx Index into the array of batch destinations.
+///
+/// @param [out] socket Unique socket/package identifier.
+///
+/// @param [out] core Unique core identifier within the socket.
+///
+/// @param [out] thread Unique thread identifier within the core.
+///
+/// @return 0 if successful, else -1 if idx is larger than the number of
+/// logical processors.
+int thread_batch_coord(uint64_t idx,
+                       unsigned *socket,
+                       unsigned *core,
+                       unsigned *thread);
+
 /// @brief Check status of a file.
 ///
 /// @param [in] filename File to check status of.
@@ -389,6 +468,48 @@ int read_msr_by_coord_batch(unsigned socket,
 /// @param [in] batchnum libmsr_data_type_e data type of batch operation.
 int read_batch(const int batchnum);
 
+/// @brief Do batch read operation on a caller-owned batch.
+///
+/// Unlike read_batch(), no shared batch storage is touched, so several
+/// threads may read their own batches concurrently.
+///
+/// @param [in,out] batch Batch whose ops hold the cpu and msr to read; each
+/// op's msrdata receives the value.
+///
+/// @return 0 if successful, else -1 if the batch is empty or a read fails.
+int read_batch_array(struct msr_batch_array *batch);
+
+/// @brief Retrieve the logical processor used to address a socket in a batch.
+///
+/// @param [in] socket Unique socket/package identifier.
+///
+/// @return Index of the logical processor, as used by load_socket_batch().
+uint64_t socket_batch_idx(unsigned socket);
+
+/// @brief Read CLOCK_MONOTONIC in seconds.
+///
+/// @return Current monotonic time.
+double monotonic_time(void);
+
+/// @brief Elapsed count of a free-running counter that wraps at its width.
+///
+/// @param [in] cur Current counter value.
+///
+/// @param [in] last Previous counter value.
+///
+/// @param [in] width Counter width in bits (64 or out-of-range values use
+/// the full 64 bits).
+///
+/// @return Count elapsed from last to cur, across at most one wrap.
+uint64_t ctr_wrap_delta(uint64_t cur,
+                        uint64_t last,
+                        int width);
+
+/// @brief Read the time-stamp counter of the calling logical processor.
+///
+/// @return Current TSC value.
+uint64_t read_tsc(void);
+
 /// @brief Do batch write operation.
 ///
 /// @param [in] batchnum libmsr_data_type_e data type of batch operation.
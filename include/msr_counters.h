@@ -69,7 +69,12 @@ struct fixed_counter {
     uint64_t *pmi;
     /// @brief Raw 64-bit value stored in IA32_FIXED_CTR[0-3].
     uint64_t **value;
+    /// @brief Number of overflows flagged in IA32_PERF_GLOBAL_STATUS since
+    /// init_counter_overflow().
     uint64_t *overflow;
+    /// @brief Count accumulated across counter wraparound since
+    /// init_counter_overflow().
+    uint64_t *accumulated;
 };
 
 /// @brief Structure containing general information about the fixed-function
@@ -122,6 +127,17 @@ struct pmc {
     uint64_t **pmc7;
 };
 
+/// @brief Structure containing general-purpose performance counter values
+/// accumulated across counter wraparound.
+struct pmc_accumulated {
+    /// @brief Count accumulated for IA32_PMC[0-7] since
+    /// init_counter_overflow().
+    uint64_t *value[8];
+    /// @brief Number of overflows of IA32_PMC[0-7] flagged in
+    /// IA32_PERF_GLOBAL_STATUS since init_counter_overflow().
+    uint64_t *overflow[8];
+};
+
 /// @brief Structure containing data of uncore performance event select
 /// counters.
 struct unc_perfevtsel {
@@ -385,6 +401,16 @@ void get_fixed_counter_config(struct fixed_counter_config *data);
 /// IA32_FIXED_CTR_CTL.
 void enable_fixed_counters(void);
 
+/// @brief Enable only the fixed-function counters that are not already
+/// counting, without resetting any counter value.
+///
+/// Unlike enable_fixed_counters(), counters already enabled in
+/// IA32_PERF_GLOBAL_CTRL and IA32_FIXED_CTR_CTRL are left untouched, so
+/// deltas taken by other users across this call remain valid.
+///
+/// @return 0 if successful, else -1 if the batch read or write fails.
+int ensure_fixed_counters(void);
+
 /// @brief Disable fixed-function counters by clearing enable bit in
 /// IA32_FIXED_CTR_CTL.
 void disable_fixed_counters(void);
@@ -405,6 +431,39 @@ void dump_fixed_counter_data_terse_label(FILE *writedest);
 /// @param [in] writedest File stream where output will be written to.
 void dump_fixed_counter_data_readable(FILE *writedest);
 
+/********************/
+/* Counter Overflow */
+/********************/
+
+/// @brief Store the accumulated general-purpose performance counter data on
+/// the heap.
+///
+/// @param [out] a Accumulated data for general-purpose performance counters.
+void pmc_accumulated_storage(struct pmc_accumulated **a);
+
+/// @brief Take a baseline of the fixed-function and general-purpose
+/// performance counters, zero the accumulated values, and clear any pending
+/// overflow status on all logical processors.
+///
+/// @return 0 if successful, else -1 if batch operations fail.
+int init_counter_overflow(void);
+
+/// @brief Read IA32_PERF_GLOBAL_STATUS in the same batch as the counters,
+/// after them, and fold the elapsed counts into the 64-bit accumulated
+/// values.
+///
+/// An overflow flagged for a counter that has not visibly wrapped is credited
+/// as a full wrap at the next poll, if that poll still shows no wrap. After
+/// init_counter_overflow(), the dump_fixed_counter_data_*() and
+/// dump_pmc_data_readable() reads also go through this function. Overflow
+/// status is cleared with one batched write to IA32_PERF_GLOBAL_OVF_CTRL,
+/// issued only if an overflow occurred. Results are stored in the
+/// accumulated and overflow fields of the fixed_counter structs and in
+/// pmc_accumulated.
+///
+/// @return 0 if successful, else -1 if batch operations fail.
+int poll_counter_overflow(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,208 @@
+/* msr_governor.h
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#ifndef MSR_GOVERNOR_H_INCLUDE
+#define MSR_GOVERNOR_H_INCLUDE
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "master.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Peak retired instructions per unhalted core cycle, used to turn
+/// IPC into the default stall metric.
+#define GOVERNOR_PEAK_IPC 4.0
+
+/// @brief Structure holding the measurements of one logical processor over
+/// the last governor interval.
+struct governor_sample {
+    /// @brief Average frequency while unhalted (MHz), the TSC rate scaled by
+    /// delta IA32_APERF / delta IA32_MPERF.
+    double freq;
+    /// @brief Fraction of the interval spent unhalted, delta IA32_MPERF /
+    /// delta TSC.
+    double c0;
+    /// @brief Retired instructions per unhalted core cycle, from
+    /// IA32_FIXED_CTR0 and IA32_FIXED_CTR1.
+    double ipc;
+    /// @brief Fraction of unhalted cycles not retiring at peak IPC, used as
+    /// the frequency-insensitive share of the run time.
+    double stall;
+    /// @brief Ratio currently requested in IA32_PERF_CTL.
+    uint64_t ratio;
+};
+
+struct governor_config;
+
+/// @brief Policy choosing a ratio for one logical processor.
+///
+/// @param [in] cpu Logical processor.
+///
+/// @param [in] s Measurements of the logical processor over the last
+/// interval.
+///
+/// @param [in] cfg Governor configuration.
+///
+/// @return Ratio to request, or 0 to leave the logical processor unchanged.
+typedef uint64_t (*governor_policy_t)(uint64_t cpu,
+                                      const struct governor_sample *s,
+                                      const struct governor_config *cfg);
+
+/// @brief Structure holding the governor configuration.
+struct governor_config {
+    /// @brief Sampling and actuation interval (microseconds).
+    uint64_t interval_us;
+    /// @brief Largest slowdown the policy may trade for energy, relative to
+    /// running at max_ratio (e.g., 0.05 for 5%).
+    double max_perf_loss;
+    /// @brief Lowest ratio the policy may request.
+    uint64_t min_ratio;
+    /// @brief Highest ratio the policy may request.
+    uint64_t max_ratio;
+    /// @brief Logical processor the governor thread is pinned to, or -1 to
+    /// leave it unpinned.
+    int cpu;
+    /// @brief Policy called for every logical processor each interval.
+    governor_policy_t policy;
+    /// @brief Opaque pointer for use by the policy.
+    void *policy_arg;
+};
+
+/// @brief Structure holding governor state and counter data.
+///
+/// The GOVERNOR_DATA batch is loaded by device index, so entry i is Linux
+/// CPU i, matching the per-thread p-state batch.
+struct governor_data {
+    /// @brief Number of logical processors.
+    uint64_t num_threads;
+    /// @brief Raw value stored in IA32_APERF.
+    uint64_t **aperf;
+    /// @brief Raw value stored in IA32_MPERF.
+    uint64_t **mperf;
+    /// @brief Raw value stored in IA32_TIME_STAMP_COUNTER.
+    uint64_t **tsc;
+    /// @brief Raw value stored in IA32_FIXED_CTR0 (instructions retired).
+    uint64_t **inst;
+    /// @brief Raw value stored in IA32_FIXED_CTR1 (unhalted core cycles).
+    uint64_t **clk;
+    /// @brief Previous raw values, in the order aperf, mperf, tsc, inst,
+    /// clk per logical processor.
+    uint64_t *old;
+    /// @brief CLOCK_MONOTONIC time of the previous sample (seconds).
+    double old_time;
+    /// @brief Measurements of the last interval per logical processor.
+    struct governor_sample *sample;
+    /// @brief Ratio chosen in the last interval per logical processor, 0 if
+    /// left unchanged.
+    uint64_t *ratio;
+    /// @brief Number of intervals completed.
+    uint64_t intervals;
+};
+
+/// @brief Allocate the governor storage and the GOVERNOR_DATA batch.
+///
+/// @param [out] gd Pointer to governor data.
+void governor_storage(struct governor_data **gd);
+
+/// @brief Fill a configuration with the default policy, a 10 ms interval,
+/// a 5% performance-loss bound, and ratios from the max efficiency ratio
+/// to the max non-turbo ratio in MSR_PLATFORM_INFO.
+///
+/// @param [out] cfg Governor configuration.
+///
+/// @return 0 if successful, else -1 if MSR_PLATFORM_INFO cannot be read.
+int governor_default_config(struct governor_config *cfg);
+
+/// @brief Default policy: pick the lowest ratio whose predicted slowdown
+/// stays within the performance-loss bound.
+///
+/// Run time is modeled as a frequency-sensitive part, (1 - stall) of the
+/// unhalted time, scaling with 1/f, plus a stalled part that does not. With
+/// power rising with frequency, the slowest ratio within the bound uses the
+/// least energy. Mostly idle logical processors are left unchanged.
+///
+/// @param [in] cpu Logical processor.
+///
+/// @param [in] s Measurements of the logical processor over the last
+/// interval.
+///
+/// @param [in] cfg Governor configuration.
+///
+/// @return Ratio to request, or 0 to leave the logical processor unchanged.
+uint64_t governor_default_policy(uint64_t cpu,
+                                 const struct governor_sample *s,
+                                 const struct governor_config *cfg);
+
+/// @brief Sample all logical processors with one batch read, run the policy,
+/// and apply its choices with one batched IA32_PERF_CTL write.
+///
+/// The first call, including the one made by governor_start(), only takes
+/// a baseline.
+///
+/// @param [in] cfg Governor configuration.
+///
+/// @return 0 if successful, else -1 if a batch failed.
+int governor_step(const struct governor_config *cfg);
+
+/// @brief Enable the fixed-function counters, take a baseline, and start
+/// the governor on its own thread.
+///
+/// Counters are enabled with ensure_fixed_counters(), so counter values are
+/// not reset and open regions or other fixed-counter users are unaffected.
+/// Other p-state requests must not be made while the governor runs.
+///
+/// @param [in] cfg Governor configuration, copied by the governor.
+///
+/// @return 0 if successful, else -1 if the governor is already running, the
+/// configuration is invalid, or the thread cannot be started or pinned.
+int governor_start(const struct governor_config *cfg);
+
+/// @brief Stop the governor thread and wait for it to exit.
+///
+/// @return 0 if successful, else -1 if the governor is not running.
+int governor_stop(void);
+
+/// @brief Print the measurements and chosen ratio of every logical
+/// processor from the last interval.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_governor_data(FILE *writedest);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,310 @@
+/* msr_hwp.h
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#ifndef MSR_HWP_H_INCLUDE
+#define MSR_HWP_H_INCLUDE
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "master.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Shift of the minimum performance field of IA32_HWP_REQUEST.
+#define HWP_MIN_SHIFT 0
+/// @brief Shift of the maximum performance field of IA32_HWP_REQUEST.
+#define HWP_MAX_SHIFT 8
+/// @brief Shift of the desired performance field of IA32_HWP_REQUEST.
+#define HWP_DESIRED_SHIFT 16
+/// @brief Shift of the energy/performance preference field of
+/// IA32_HWP_REQUEST.
+#define HWP_EPP_SHIFT 24
+/// @brief Package control flag of IA32_HWP_REQUEST (bit 42). When set, the
+/// thread follows IA32_HWP_REQUEST_PKG instead of its own request.
+#define HWP_PKG_CONTROL ((uint64_t)1 << 42)
+/// @brief Extract an 8-bit field of an HWP request or capability register.
+#define HWP_FIELD(x, shift) (((x) >> (shift)) & 0xFF)
+/// @brief Shift of the highest performance field of IA32_HWP_CAPABILITIES.
+#define HWP_CAP_HIGHEST_SHIFT 0
+/// @brief Shift of the guaranteed performance field of
+/// IA32_HWP_CAPABILITIES.
+#define HWP_CAP_GUARANTEED_SHIFT 8
+/// @brief Shift of the most efficient performance field of
+/// IA32_HWP_CAPABILITIES.
+#define HWP_CAP_EFFICIENT_SHIFT 16
+/// @brief Shift of the lowest performance field of IA32_HWP_CAPABILITIES.
+#define HWP_CAP_LOWEST_SHIFT 24
+/// @brief Energy/performance bias field of IA32_ENERGY_PERF_BIAS (bits 3:0).
+#define EPB_MASK ((uint64_t)0xF)
+
+/// @brief Enum selecting which fields of an HWP request are written.
+enum hwp_field_e {
+    /// @brief Minimum performance.
+    HWP_FIELD_MIN = 1,
+    /// @brief Maximum performance.
+    HWP_FIELD_MAX = 2,
+    /// @brief Desired performance, 0 lets the hardware choose.
+    HWP_FIELD_DESIRED = 4,
+    /// @brief Energy/performance preference, 0 favors performance and 255
+    /// favors energy.
+    HWP_FIELD_EPP = 8,
+};
+
+/// @brief Structure holding one decoded HWP request.
+struct hwp_request {
+    /// @brief Minimum performance level.
+    uint8_t min;
+    /// @brief Maximum performance level.
+    uint8_t max;
+    /// @brief Desired performance level.
+    uint8_t desired;
+    /// @brief Energy/performance preference.
+    uint8_t epp;
+    /// @brief Non-zero if the thread follows the package-level request.
+    uint8_t pkg_control;
+};
+
+/// @brief Structure holding the decoded IA32_HWP_CAPABILITIES of a thread.
+struct hwp_caps {
+    /// @brief Highest performance level.
+    uint8_t highest;
+    /// @brief Guaranteed performance level, which may change at runtime.
+    uint8_t guaranteed;
+    /// @brief Most efficient performance level.
+    uint8_t efficient;
+    /// @brief Lowest performance level.
+    uint8_t lowest;
+};
+
+/// @brief Structure holding the HWP and energy/performance bias batches.
+///
+/// Per-thread arrays are indexed by logical processor (the Linux CPU
+/// number), per-socket arrays by socket. The HWP_REQ, HWP_PKG_REQ, and
+/// EPB_CTL batches double as shadows of their registers: a request edits
+/// the selected entries in place and writes the whole batch in one ioctl.
+struct hwp_data {
+    /// @brief Number of logical processors.
+    uint64_t num_threads;
+    /// @brief Number of sockets.
+    uint64_t num_sockets;
+    /// @brief Non-zero if HWP is available.
+    int hwp_avail;
+    /// @brief Non-zero if the EPP field of HWP requests is available.
+    int epp_avail;
+    /// @brief Non-zero if IA32_HWP_REQUEST_PKG is available.
+    int pkg_avail;
+    /// @brief Non-zero if IA32_ENERGY_PERF_BIAS is available.
+    int epb_avail;
+    /// @brief Non-zero once IA32_PM_ENABLE is set on every socket.
+    int hwp_enabled;
+    /// @brief IA32_PM_ENABLE per socket (HWP_ENABLE batch).
+    uint64_t **pm_enable;
+    /// @brief IA32_HWP_CAPABILITIES per thread (HWP_CAP batch).
+    uint64_t **cap;
+    /// @brief IA32_HWP_REQUEST per thread (HWP_REQ batch).
+    uint64_t **req;
+    /// @brief IA32_HWP_REQUEST_PKG per socket (HWP_PKG_REQ batch).
+    uint64_t **pkg_req;
+    /// @brief IA32_ENERGY_PERF_BIAS per thread (EPB_CTL batch).
+    uint64_t **epb;
+};
+
+/// @brief Detect HWP and energy/performance bias support with CPUID and
+/// allocate the batches of the available registers.
+///
+/// HWP registers other than IA32_PM_ENABLE may only be accessed once HWP is
+/// enabled, so the HWP shadows are synced here only if the firmware or the
+/// OS already enabled it.
+///
+/// @param [out] hd Pointer to HWP data.
+///
+/// @return 0 if successful, else -1 if neither HWP nor
+/// IA32_ENERGY_PERF_BIAS is available.
+int hwp_storage(struct hwp_data **hd);
+
+/// @brief Merge the selected fields of a request into a raw register value.
+///
+/// @param [in] raw Current register value.
+///
+/// @param [in] req Request to merge.
+///
+/// @param [in] fields Bitwise OR of hwp_field_e values to merge.
+///
+/// @return New register value.
+uint64_t hwp_encode(uint64_t raw,
+                    const struct hwp_request *req,
+                    int fields);
+
+/// @brief Decode a raw IA32_HWP_REQUEST or IA32_HWP_REQUEST_PKG value.
+///
+/// @param [in] raw Register value.
+///
+/// @param [out] req Decoded request.
+void hwp_decode(uint64_t raw,
+                struct hwp_request *req);
+
+/// @brief Enable HWP on every socket through IA32_PM_ENABLE and sync the
+/// HWP shadows.
+///
+/// HWP stays enabled until the next reset.
+///
+/// @return 0 if successful, else -1 if HWP is not available or a batch
+/// failed.
+int enable_hwp(void);
+
+/// @brief Refresh the IA32_HWP_REQUEST, IA32_HWP_REQUEST_PKG, and
+/// IA32_ENERGY_PERF_BIAS shadows from the hardware.
+///
+/// @return 0 if successful, else -1 if a read batch failed.
+int hwp_sync(void);
+
+/// @brief Read IA32_HWP_CAPABILITIES on every logical processor in one
+/// batch.
+///
+/// @param [out] caps Array of num_devs() decoded capabilities.
+///
+/// @return 0 if successful, else -1 if HWP is not enabled or the batch
+/// failed.
+int get_hwp_capabilities(struct hwp_caps *caps);
+
+/// @brief Read IA32_HWP_REQUEST on every logical processor in one batch.
+///
+/// @param [out] reqs Array of num_devs() decoded requests.
+///
+/// @return 0 if successful, else -1 if HWP is not enabled or the batch
+/// failed.
+int get_hwp_request(struct hwp_request *reqs);
+
+/// @brief Write the same HWP request on a set of logical processors with
+/// one batched write.
+///
+/// The selected threads stop following the package-level request.
+///
+/// @param [in] cpumask Bitmask of CPUMASK_WORDS(num_devs()) words selecting
+/// the logical processors to change.
+///
+/// @param [in] req Requested performance levels.
+///
+/// @param [in] fields Bitwise OR of hwp_field_e values to write, other
+/// fields are left unchanged.
+///
+/// @return 0 if successful, else -1 if HWP is not enabled, the request is
+/// invalid, or the write batch failed.
+int set_hwp_request_mask(const uint64_t *cpumask,
+                         const struct hwp_request *req,
+                         int fields);
+
+/// @brief Write an HWP request per logical processor with one batched
+/// write.
+///
+/// Every thread stops following the package-level request.
+///
+/// @param [in] reqs Array of num_devs() requests, indexed by logical
+/// processor.
+///
+/// @param [in] fields Bitwise OR of hwp_field_e values to write, other
+/// fields are left unchanged.
+///
+/// @return 0 if successful, else -1 if HWP is not enabled, a request is
+/// invalid, or the write batch failed.
+int set_hwp_request_array(const struct hwp_request *reqs,
+                          int fields);
+
+/// @brief Write the package-level HWP request on every socket with one
+/// batched write.
+///
+/// Only threads with the package control flag set follow this request, see
+/// set_hwp_pkg_control().
+///
+/// @param [in] req Requested performance levels.
+///
+/// @param [in] fields Bitwise OR of hwp_field_e values to write, other
+/// fields are left unchanged.
+///
+/// @return 0 if successful, else -1 if IA32_HWP_REQUEST_PKG is not
+/// available, HWP is not enabled, the request is invalid, or the write
+/// batch failed.
+int set_hwp_pkg_request(const struct hwp_request *req,
+                        int fields);
+
+/// @brief Set or clear the package control flag of IA32_HWP_REQUEST on a
+/// set of logical processors with one batched write.
+///
+/// @param [in] cpumask Bitmask of CPUMASK_WORDS(num_devs()) words selecting
+/// the logical processors to change.
+///
+/// @param [in] enable If non-zero, the selected threads follow
+/// IA32_HWP_REQUEST_PKG, else their own IA32_HWP_REQUEST.
+///
+/// @return 0 if successful, else -1 if IA32_HWP_REQUEST_PKG is not
+/// available, HWP is not enabled, or the write batch failed.
+int set_hwp_pkg_control(const uint64_t *cpumask,
+                        int enable);
+
+/// @brief Read IA32_ENERGY_PERF_BIAS on every logical processor in one
+/// batch.
+///
+/// @param [out] epb Array of num_devs() biases, 0 favors performance and
+/// 15 favors energy.
+///
+/// @return 0 if successful, else -1 if IA32_ENERGY_PERF_BIAS is not
+/// available or the batch failed.
+int get_epb(uint64_t *epb);
+
+/// @brief Write the same energy/performance bias on a set of logical
+/// processors with one batched write.
+///
+/// @param [in] cpumask Bitmask of CPUMASK_WORDS(num_devs()) words selecting
+/// the logical processors to change.
+///
+/// @param [in] epb Bias from 0 (performance) to 15 (energy).
+///
+/// @return 0 if successful, else -1 if IA32_ENERGY_PERF_BIAS is not
+/// available, the bias is out of range, or the write batch failed.
+int set_epb_mask(const uint64_t *cpumask,
+                 uint64_t epb);
+
+/// @brief Print the HWP capabilities and request and the
+/// energy/performance bias of every logical processor, and the
+/// package-level request of every socket.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_hwp(FILE *writedest);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
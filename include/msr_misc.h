@@ -202,6 +202,86 @@ struct core_cres {
     uint64_t **core_c7;
 };
 
+/// @brief Enum encompassing package C-states reported by the residency
+/// sampler.
+enum cres_pkg_e {
+    /// @brief Package C0 (time not spent in C2, C3, C6, or C7).
+    CRES_PKG_C0,
+    /// @brief Package C2.
+    CRES_PKG_C2,
+    /// @brief Package C3.
+    CRES_PKG_C3,
+    /// @brief Package C6.
+    CRES_PKG_C6,
+    /// @brief Package C7.
+    CRES_PKG_C7,
+    /// @brief Number of package C-states.
+    CRES_PKG_NUM,
+};
+
+/// @brief Enum encompassing core C-states reported by the residency
+/// sampler.
+enum cres_core_e {
+    /// @brief Core C0, derived from IA32_MPERF of the busiest sibling thread.
+    CRES_CORE_C0,
+    /// @brief Core C1 (time not spent in C0, C3, C6, or C7).
+    CRES_CORE_C1,
+    /// @brief Core C3.
+    CRES_CORE_C3,
+    /// @brief Core C6.
+    CRES_CORE_C6,
+    /// @brief Core C7.
+    CRES_CORE_C7,
+    /// @brief Number of core C-states.
+    CRES_CORE_NUM,
+};
+
+/// @brief Structure holding the C-state residency sampler.
+///
+/// The package residencies, the core residencies, IA32_MPERF of each logical
+/// processor, and the TSC of each socket are read in the single CRES_SAMPLE
+/// batch. A core is in C0 while any of its threads is, so core C0 is taken
+/// from the largest IA32_MPERF delta among the core's sibling threads (a
+/// lower bound of their union). Deltas are taken modulo 2^64 so counter
+/// wraparound is handled.
+struct cres_sample {
+    /// @brief Number of sockets.
+    uint64_t num_sockets;
+    /// @brief Number of physical cores across all sockets.
+    uint64_t num_cores;
+    /// @brief Number of logical processors across all sockets.
+    uint64_t num_threads;
+    /// @brief Raw value stored in IA32_TIME_STAMP_COUNTER per socket.
+    uint64_t **tsc;
+    /// @brief Raw package residency per socket, indexed by cres_pkg_e (the
+    /// CRES_PKG_C0 entry is unused).
+    uint64_t **pkg[CRES_PKG_NUM];
+    /// @brief Raw value stored in IA32_MPERF per logical processor.
+    uint64_t **mperf;
+    /// @brief Core index of each logical processor in mperf.
+    uint64_t *thread_core;
+    /// @brief Previous IA32_MPERF per logical processor.
+    uint64_t *old_mperf;
+    /// @brief Largest IA32_MPERF delta among the sibling threads of each
+    /// core over the last interval.
+    uint64_t *core_mperf;
+    /// @brief Raw core residency per core, indexed by cres_core_e (the
+    /// CRES_CORE_C0 and CRES_CORE_C1 entries are unused).
+    uint64_t **core[CRES_CORE_NUM];
+    /// @brief Previous raw values, CRES_PKG_NUM per socket followed by
+    /// CRES_CORE_NUM per core (the CRES_CORE_C0 and CRES_CORE_C1 entries are
+    /// unused).
+    uint64_t *old;
+    /// @brief Residency (percent) over the last interval, CRES_PKG_NUM
+    /// entries per socket.
+    double *pkg_pct;
+    /// @brief Residency (percent) over the last interval, CRES_CORE_NUM
+    /// entries per core.
+    double *core_pct;
+    /// @brief Number of intervals completed.
+    uint64_t intervals;
+};
+
 /*************************/
 /* Misc Enable Functions */
 /*************************/
@@ -264,6 +344,30 @@ void dump_core_cres_label(FILE *writedest);
 /// @param [in] writedest File stream where output will be written to.
 void dump_core_cres(FILE *writedest);
 
+/// @brief Initialize storage of the C-state residency sampler.
+///
+/// @param [out] cs Pointer to C-state residency sampler data.
+void cres_sample_storage(struct cres_sample **cs);
+
+/// @brief Read package and core C-state residencies, per-thread IA32_MPERF,
+/// and the TSC in one batch and update the residency percentages.
+///
+/// The first call only takes a baseline.
+///
+/// @return 0 if successful, else -1 if read_batch() fails.
+int poll_cres_sample(void);
+
+/// @brief Print labels for the C-state residency percentages.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_cres_sample_label(FILE *writedest);
+
+/// @brief Print the C-state residency percentages of the last interval,
+/// one line per socket followed by one line per core.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_cres_sample(FILE *writedest);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,209 @@
+/* msr_pcu.h
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#ifndef MSR_PCU_H_INCLUDE
+#define MSR_PCU_H_INCLUDE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+#include "master.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Number of general-purpose counters in the PCU PMON box.
+#define PCU_NUM_CTRS 4
+
+/// @brief Bit width of the PCU PMON counters.
+#define PCU_CTR_WIDTH 48
+
+/// @brief MSR_PCU_PMON_BOX_CTL reset control (event select) bit.
+#define PCU_BOX_RST_CTRL (1UL << 0)
+/// @brief MSR_PCU_PMON_BOX_CTL reset counters bit.
+#define PCU_BOX_RST_CTRS (1UL << 1)
+/// @brief MSR_PCU_PMON_BOX_CTL freeze bit.
+#define PCU_BOX_FRZ (1UL << 8)
+#if COMPILED_ARCH != 0x3F
+/// @brief MSR_PCU_PMON_BOX_CTL freeze enable bit (reserved on Haswell).
+#define PCU_BOX_FRZ_EN (1UL << 16)
+#else
+#define PCU_BOX_FRZ_EN (0UL)
+#endif
+
+/// @brief MSR_PCU_PMON_EVNTSEL local counter enable bit.
+#define PCU_EVTSEL_EN (1UL << 22)
+
+/// @brief Enum encompassing named PCU events.
+enum pcu_event_e {
+    /// @brief PCU clock cycles.
+    PCU_CLOCKTICKS,
+    /// @brief Cycles uncore frequency was at or above band 0 threshold.
+    PCU_FREQ_BAND0,
+    /// @brief Cycles uncore frequency was at or above band 1 threshold.
+    PCU_FREQ_BAND1,
+    /// @brief Cycles uncore frequency was at or above band 2 threshold.
+    PCU_FREQ_BAND2,
+    /// @brief Cycles uncore frequency was at or above band 3 threshold.
+    PCU_FREQ_BAND3,
+    /// @brief Cycles frequency was limited by thermal constraints.
+    PCU_FREQ_MAX_THERMAL,
+    /// @brief Cycles frequency was limited by power constraints.
+    PCU_FREQ_MAX_POWER,
+    /// @brief Cycles frequency was limited by the OS request.
+    PCU_FREQ_MAX_OS,
+    /// @brief Cycles the package asserted PROCHOT internally.
+    PCU_PROCHOT_INTERNAL,
+    /// @brief Cycles an external agent asserted PROCHOT.
+    PCU_PROCHOT_EXTERNAL,
+    /// @brief Number of cores in C0, accumulated each cycle.
+    PCU_C0_OCCUPANCY,
+    /// @brief Number of cores in C3, accumulated each cycle.
+    PCU_C3_OCCUPANCY,
+    /// @brief Number of cores in C6, accumulated each cycle.
+    PCU_C6_OCCUPANCY,
+    /// @brief Cycles core 0 spent transitioning between C-states.
+    PCU_CORE0_TRANSITIONS,
+    /// @brief Number of named PCU events.
+    PCU_NUM_EVENTS,
+};
+
+/// @brief Structure containing PCU counter and package energy data sampled
+/// together in one batch.
+struct pcu_data {
+    /// @brief Number of counters programmed by set_pcu_events().
+    int num_events;
+    /// @brief Event programmed on each counter.
+    enum pcu_event_e event[PCU_NUM_CTRS];
+    /// @brief Raw 48-bit value stored in MSR_PCU_PMON_CTR[0-3] per socket.
+    uint64_t **ctr[PCU_NUM_CTRS];
+    /// @brief Previous raw value of each counter per socket.
+    uint64_t *old_ctr[PCU_NUM_CTRS];
+    /// @brief Counter increments between the last two polls per socket.
+    uint64_t *delta[PCU_NUM_CTRS];
+    /// @brief Raw 64-bit value stored in MSR_PKG_ENERGY_STATUS per socket.
+    uint64_t **pkg_energy;
+    /// @brief Previous raw value of MSR_PKG_ENERGY_STATUS per socket.
+    uint64_t *old_pkg_energy;
+    /// @brief Package energy consumed between the last two polls (in Joules).
+    double *pkg_joules;
+    /// @brief Time of the current poll.
+    struct timeval now;
+    /// @brief Time of the previous poll.
+    struct timeval old_now;
+    /// @brief Time elapsed between the last two polls (in seconds).
+    double elapsed;
+};
+
+/// @brief Store the PCU counter data on the heap.
+///
+/// The PCU counters and MSR_PKG_ENERGY_STATUS are loaded into the PCU_DATA
+/// batch so that one read samples both.
+///
+/// @param [out] pd Pointer to PCU counter data.
+void pcu_storage(struct pcu_data **pd);
+
+/// @brief Store the PCU box control and filter data on the heap.
+///
+/// @param [out] box_ctl Pointer to raw MSR_PCU_PMON_BOX_CTL values per socket.
+///
+/// @param [out] box_filter Pointer to raw MSR_PCU_PMON_BOX_FILTER values per
+///        socket.
+void pcu_box_storage(uint64_t ***box_ctl,
+                     uint64_t ***box_filter);
+
+/// @brief Get the name of a PCU event.
+///
+/// @param [in] event pcu_event_e identifier of the event.
+///
+/// @return Name of the event, else "UNKNOWN".
+const char *pcu_event_name(enum pcu_event_e event);
+
+/// @brief Program up to four named events on every socket.
+///
+/// Event selects for all sockets are written with one batch, then the box
+/// counters are reset and the baseline is sampled.
+///
+/// @param [in] events Array of pcu_event_e identifiers, one per counter.
+///
+/// @param [in] nevents Number of events (1 to PCU_NUM_CTRS).
+///
+/// @return 0 if successful, else -1 if an event is invalid.
+int set_pcu_events(const enum pcu_event_e *events,
+                   int nevents);
+
+/// @brief Set the frequency band thresholds used by PCU_FREQ_BAND[0-3] on
+/// every socket.
+///
+/// @param [in] band_mhz Array of four thresholds (in MHz), stored in 100 MHz
+///        units in MSR_PCU_PMON_BOX_FILTER.
+///
+/// @return 0 if successful, else -1 if a threshold is out of range.
+int set_pcu_band_thresholds(const unsigned band_mhz[4]);
+
+/// @brief Freeze, unfreeze, or reset the PCU PMON box on every socket.
+///
+/// @param [in] freeze Non-zero to freeze the counters, 0 to let them count.
+///
+/// @param [in] reset Non-zero to reset the counters to 0.
+///
+/// @return 0 if successful, else -1 if the batch write fails.
+int pcu_box_ctrl(int freeze,
+                 int reset);
+
+/// @brief Sample the PCU counters and package energy in one batch read and
+/// compute deltas since the previous poll, handling counter wraparound.
+///
+/// @return 0 if successful, else -1 if read_batch() fails.
+int poll_pcu_data(void);
+
+/// @brief Print the label for the PCU data print out.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_pcu_data_label(FILE *writedest);
+
+/// @brief Print the PCU deltas from the last poll.
+///
+/// Each event is printed as a per-second rate. When PCU_CLOCKTICKS is also
+/// programmed, cycle events are additionally printed as a fraction of PCU
+/// cycles.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_pcu_data(FILE *writedest);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
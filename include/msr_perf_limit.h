@@ -0,0 +1,167 @@
+/* msr_perf_limit.h
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#ifndef MSR_PERF_LIMIT_H_INCLUDE
+#define MSR_PERF_LIMIT_H_INCLUDE
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "master.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Offset of the sticky log bit from its status bit.
+#define PERF_LIMIT_LOG_SHIFT 16
+/// @brief Mask of the sticky log bits (R/WC0) in a limit reasons register.
+#define PERF_LIMIT_LOG_MASK ((uint64_t)0xFFFF << PERF_LIMIT_LOG_SHIFT)
+
+/// @brief Enum encompassing the perf limit reasons registers.
+enum perf_limit_domain_e {
+    /// @brief MSR_CORE_PERF_LIMIT_REASONS.
+    PERF_LIMIT_CORE,
+    /// @brief MSR_GRAPHICS_PERF_LIMIT_REASONS.
+    PERF_LIMIT_GRAPHICS,
+    /// @brief MSR_RING_PERF_LIMIT_REASONS.
+    PERF_LIMIT_RING,
+    /// @brief Number of perf limit reasons registers.
+    PERF_LIMIT_NUM_DOMAINS,
+};
+
+/// @brief Enum encompassing perf limit reasons, valued as the bit of the
+/// status flag. The matching log flag is PERF_LIMIT_LOG_SHIFT bits higher.
+enum perf_limit_reason_e {
+    /// @brief PROCHOT# asserted.
+    PERF_LIMIT_PROCHOT = 0,
+    /// @brief Thermal event.
+    PERF_LIMIT_THERMAL = 1,
+    /// @brief Power budget management.
+    PERF_LIMIT_BUDGET = 2,
+    /// @brief Platform configuration services.
+    PERF_LIMIT_PLATFORM_CONFIG = 3,
+    /// @brief Residency state regulation.
+    PERF_LIMIT_RESIDENCY = 4,
+    /// @brief Autonomous utilization-based frequency control.
+    PERF_LIMIT_AUTONOMOUS = 5,
+    /// @brief Voltage regulator thermal alert.
+    PERF_LIMIT_VR_THERM = 6,
+    /// @brief Voltage regulator thermal design current limit.
+    PERF_LIMIT_VR_TDC = 7,
+    /// @brief Electrical design point (current or power).
+    PERF_LIMIT_EDP = 8,
+    /// @brief Core power limiting.
+    PERF_LIMIT_CORE_POWER = 9,
+    /// @brief Package RAPL PL1.
+    PERF_LIMIT_PL1 = 10,
+    /// @brief Package RAPL PL2.
+    PERF_LIMIT_PL2 = 11,
+    /// @brief Max turbo limit for the number of active cores.
+    PERF_LIMIT_MAX_TURBO = 12,
+    /// @brief Turbo transition attenuation.
+    PERF_LIMIT_TURBO_ATTEN = 13,
+    /// @brief Number of decoded reasons.
+    PERF_LIMIT_NUM_REASONS = 14,
+};
+
+/// @brief Structure holding perf limit reasons data per socket.
+///
+/// Every available register is read per socket in the PERF_LIMIT_DATA
+/// batch. Counts are indexed by
+/// (socket * PERF_LIMIT_NUM_DOMAINS + domain) * PERF_LIMIT_NUM_REASONS +
+/// reason.
+struct perf_limit_data {
+    /// @brief Number of sockets.
+    uint64_t num_sockets;
+    /// @brief Non-zero if the register of each domain exists.
+    int avail[PERF_LIMIT_NUM_DOMAINS];
+    /// @brief Raw register value per socket for each available domain.
+    uint64_t **raw[PERF_LIMIT_NUM_DOMAINS];
+    /// @brief Number of polls where the status flag was set.
+    uint64_t *status_count;
+    /// @brief Number of polls where the sticky log flag was set, i.e., the
+    /// reason was active at some point since the previous clear.
+    uint64_t *log_count;
+    /// @brief Number of polls since the last reset.
+    uint64_t intervals;
+};
+
+/// @brief Allocate the PERF_LIMIT_DATA batch for the registers available
+/// on this platform.
+///
+/// @param [out] pd Pointer to perf limit reasons data.
+///
+/// @return 0 if successful, else -1 if no perf limit reasons register is
+/// available.
+int perf_limit_storage(struct perf_limit_data **pd);
+
+/// @brief Read every perf limit reasons register in one batch and count the
+/// active status and log flags.
+///
+/// @param [in] clear_log If non-zero, clear the sticky log flags afterwards
+/// with one batched write, so the next poll counts only new events.
+///
+/// @return 0 if successful, else -1 if a batch failed or no register is
+/// available.
+int poll_perf_limit(int clear_log);
+
+/// @brief Clear the sticky log flags of every perf limit reasons register
+/// with one batched write.
+///
+/// @return 0 if successful, else -1 if the write batch failed or no
+/// register is available.
+int clear_perf_limit_log(void);
+
+/// @brief Reset the accumulated counts.
+void reset_perf_limit_counts(void);
+
+/// @brief Get a short name for a perf limit reason.
+///
+/// @param [in] reason perf_limit_reason_e value.
+///
+/// @return Name of the reason.
+const char *perf_limit_reason_name(int reason);
+
+/// @brief Print, per socket and domain, how many polls saw each reason in
+/// its status and log flags.
+///
+/// Reasons never seen are omitted.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_perf_limit(FILE *writedest);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
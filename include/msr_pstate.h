@@ -0,0 +1,156 @@
+/* msr_pstate.h
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#ifndef MSR_PSTATE_H_INCLUDE
+#define MSR_PSTATE_H_INCLUDE
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "master.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Target ratio field of IA32_PERF_CTL (bits 15:8), in units of
+/// 100 MHz.
+#define PSTATE_RATIO_MASK ((uint64_t)0xFF00)
+/// @brief Shift of the target ratio field in IA32_PERF_CTL.
+#define PSTATE_RATIO_SHIFT 8
+/// @brief Target ratio field of IA32_PERF_CTL (bits 15:8).
+#define PSTATE_CTL_RATIO(x) (((x) >> 8) & 0xFF)
+/// @brief Current ratio field of IA32_PERF_STATUS (bits 15:8).
+#define PSTATE_STATUS_RATIO(x) (((x) >> 8) & 0xFF)
+
+/// @brief Structure holding the per-thread IA32_PERF_CTL and
+/// IA32_PERF_STATUS batches.
+///
+/// All arrays are indexed by logical processor (the Linux CPU number), so
+/// bit i of a CPU mask and entry i of a per-CPU array refer to the same
+/// thread. The PSTATE_CTL batch doubles as a shadow of IA32_PERF_CTL: a
+/// request edits the ratio of the selected threads in place and writes the
+/// whole batch in one ioctl, so threads outside the request get back their
+/// last synced value.
+struct pstate_data {
+    /// @brief Number of logical processors.
+    uint64_t num_threads;
+    /// @brief IA32_PERF_CTL value written by the PSTATE_CTL batch.
+    uint64_t **ctl;
+    /// @brief IA32_PERF_CTL value read back by the PSTATE_DATA batch.
+    uint64_t **ctl_readback;
+    /// @brief IA32_PERF_STATUS value read by the PSTATE_DATA batch.
+    uint64_t **status;
+};
+
+/// @brief Take the lock serializing the IA32_PERF_CTL shadow.
+///
+/// Every edit of the shadow and the write_batch(PSTATE_CTL) that commits it
+/// must happen under this lock, since the governor thread and the
+/// application may both request p-states or turbo changes. The functions of
+/// this module and of msr_turbo take it themselves. It is not recursive.
+void pstate_lock(void);
+
+/// @brief Release the lock taken by pstate_lock().
+void pstate_unlock(void);
+
+/// @brief Allocate the per-thread IA32_PERF_CTL and IA32_PERF_STATUS
+/// batches and sync the IA32_PERF_CTL shadow with the hardware.
+///
+/// @param [out] pd Pointer to per-thread p-state data.
+void pstate_storage(struct pstate_data **pd);
+
+/// @brief Refresh the IA32_PERF_CTL shadow from the hardware.
+///
+/// Only needed if something other than this module may have written
+/// IA32_PERF_CTL since the last request, otherwise the next request would
+/// write back the stale value on threads outside its CPU set.
+///
+/// @return 0 if successful, else -1 if the read batch failed.
+int pstate_sync(void);
+
+/// @brief Request the same p-state on a set of logical processors with one
+/// batched write.
+///
+/// @param [in] cpumask Bitmask of CPUMASK_WORDS(num_devs()) words selecting
+/// the logical processors to change.
+///
+/// @param [in] ratio Desired ratio in units of 100 MHz.
+///
+/// @param [in] verify If non-zero, read IA32_PERF_CTL and IA32_PERF_STATUS
+/// back in one fused batch and compare the requested ratio.
+///
+/// @return 0 if successful, number of selected threads whose IA32_PERF_CTL
+/// did not take the requested ratio if verify is set, else -1 if the ratio
+/// is out of range or a batch failed.
+int set_pstate_mask(const uint64_t *cpumask,
+                    uint64_t ratio,
+                    int verify);
+
+/// @brief Request a p-state per logical processor with one batched write.
+///
+/// @param [in] ratios Array of num_devs() ratios in units of 100 MHz,
+/// indexed by logical processor. A ratio of 0 leaves that thread unchanged.
+///
+/// @param [in] verify If non-zero, read IA32_PERF_CTL and IA32_PERF_STATUS
+/// back in one fused batch and compare the requested ratios.
+///
+/// @return 0 if successful, number of threads whose IA32_PERF_CTL did not
+/// take the requested ratio if verify is set, else -1 if a ratio is out of
+/// range or a batch failed.
+int set_pstate_array(const uint64_t *ratios,
+                     int verify);
+
+/// @brief Read IA32_PERF_CTL and IA32_PERF_STATUS on every logical
+/// processor in one batch.
+///
+/// @param [out] current Array of num_devs() current ratios decoded from
+/// IA32_PERF_STATUS, or NULL.
+///
+/// @param [out] requested Array of num_devs() requested ratios decoded from
+/// IA32_PERF_CTL, or NULL.
+///
+/// @return 0 if successful, else -1 if the read batch failed.
+int get_pstate(uint64_t *current,
+               uint64_t *requested);
+
+/// @brief Print the requested and current p-state of every logical
+/// processor.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_pstate(FILE *writedest);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -111,6 +111,9 @@ extern "C" {
 #define PP1_ENERGY_STATUS      (0x4000L)
 #define PP1_POLICY             (0x8000L)
 #define TURBO_ACTIVATION_RATIO (0x10000L)
+#define CORE_PERF_LIMIT_REASONS     (0x40000L)
+#define GRAPHICS_PERF_LIMIT_REASONS (0x80000L)
+#define RING_PERF_LIMIT_REASONS     (0x100000L)
 #define TURBO_RATIO_LIMIT      (0x200000L)
 #define TURBO_RATIO_LIMIT1     (0x400000L)
 
@@ -0,0 +1,134 @@
+/* msr_region.h
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#ifndef MSR_REGION_H_INCLUDE
+#define MSR_REGION_H_INCLUDE
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Maximum length of a region path (nested names joined with '/').
+#define REGION_PATH_SIZE 256
+/// @brief Maximum nesting depth of regions on a single thread.
+#define REGION_MAX_DEPTH 32
+/// @brief Number of hash buckets in each per-thread region table.
+#define REGION_HASH_BUCKETS 128
+/// @brief Maximum number of threads that may record regions.
+#define REGION_MAX_SHARDS 512
+
+/// @brief Structure containing totals accumulated for a single region.
+///
+/// RAPL energy is summed across all packages between the begin and end
+/// markers. The fixed-function counters and IA32_APERF/IA32_MPERF are read on
+/// the logical processor the calling thread ran on at the begin marker, so
+/// they describe that thread's own activity inside the region.
+struct region_totals {
+    /// @brief Number of times the region was entered and exited.
+    uint64_t calls;
+    /// @brief Wall-clock time spent inside the region (in seconds).
+    double seconds;
+    /// @brief Package energy consumed inside the region (in Joules).
+    double pkg_joules;
+    /// @brief DRAM energy consumed inside the region (in Joules).
+    double dram_joules;
+    /// @brief Instructions retired (IA32_FIXED_CTR0).
+    uint64_t inst_retired;
+    /// @brief Unhalted core cycles (IA32_FIXED_CTR1).
+    uint64_t core_cycles;
+    /// @brief Unhalted reference cycles (IA32_FIXED_CTR2).
+    uint64_t ref_cycles;
+    /// @brief Actual performance clock cycles (IA32_APERF).
+    uint64_t aperf;
+    /// @brief Maximum performance clock cycles (IA32_MPERF).
+    uint64_t mperf;
+};
+
+/// @brief Set up the batch layout used by the region markers.
+///
+/// Enables the fixed-function counters and determines the layout of the
+/// private batch each recording thread reads: MSR_PKG_ENERGY_STATUS,
+/// MSR_DRAM_ENERGY_STATUS (if supported), IA32_FIXED_CTR[0-2], IA32_APERF,
+/// and IA32_MPERF. Called implicitly by the first libmsr_region_begin() on
+/// each thread.
+///
+/// @return 0 if successful, else -1 if rapl_storage() fails.
+int libmsr_region_init(void);
+
+/// @brief Mark the beginning of a named region on the calling thread.
+///
+/// Regions may be nested. A nested region is recorded under the path of its
+/// enclosing regions (e.g., "solve/precond"), so the same name used in
+/// different call chains is accounted separately.
+///
+/// @param [in] name Name of the region.
+///
+/// @return 0 if successful, else -1 if the nesting depth or path length is
+/// exceeded or if the batch read fails.
+int libmsr_region_begin(const char *name);
+
+/// @brief Mark the end of the innermost region on the calling thread.
+///
+/// @param [in] name Name of the region, must match the innermost open region.
+///
+/// @return 0 if successful, else -1 if no region is open, if the name does not
+/// match, or if the batch read fails.
+int libmsr_region_end(const char *name);
+
+/// @brief Retrieve totals for a region merged across all threads.
+///
+/// @param [in] path Full path of the region (e.g., "solve/precond").
+///
+/// @param [out] totals Accumulated totals for the region.
+///
+/// @return 0 if successful, else -1 if the region was never recorded.
+int libmsr_region_get(const char *path,
+                      struct region_totals *totals);
+
+/// @brief Print totals of all recorded regions merged across all threads.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_region_data(FILE *writedest);
+
+/// @brief Dump recorded regions to stdout and release region storage.
+///
+/// Called by finalize_msr(). Does nothing if no region was recorded.
+void libmsr_region_finalize(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
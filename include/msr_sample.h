@@ -0,0 +1,137 @@
+/* msr_sample.h
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#ifndef MSR_SAMPLE_H_INCLUDE
+#define MSR_SAMPLE_H_INCLUDE
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Maximum number of MSR batches and of CSR batches in one sampling
+/// transaction.
+#define SAMPLE_MAX_BATCHES 16
+
+/// @brief Structure holding a sampling transaction: a declared set of MSR
+/// read batches and CSR batches executed back-to-back and stamped as one
+/// sample.
+///
+/// The MSR batches run first, then the CSR batches, with nothing in between.
+/// The TSC and CLOCK_MONOTONIC are read at the start, between the two
+/// engines, and at the end, so the sample is stamped at its midpoint and the
+/// skew between the first and last register read is known. For example, a
+/// transaction holding RAPL_DATA and CSR_MEMBW_CTRS samples DRAM energy and
+/// CAS counts at the same instant for DRAM Joules per byte.
+struct sample_txn {
+    /// @brief Number of MSR batches in the transaction.
+    unsigned num_msr;
+    /// @brief libmsr_data_type_e of each MSR batch, read with read_batch().
+    int msr_batches[SAMPLE_MAX_BATCHES];
+    /// @brief Number of CSR batches in the transaction.
+    unsigned num_csr;
+    /// @brief csr_data_type_e of each CSR batch, run with do_csr_batch_op().
+    int csr_batches[SAMPLE_MAX_BATCHES];
+    /// @brief TSC at the middle of the last run.
+    uint64_t tsc;
+    /// @brief CLOCK_MONOTONIC time at the middle of the last run (seconds).
+    double timestamp;
+    /// @brief TSC ticks between the first and last batch of the last run.
+    uint64_t skew_tsc;
+    /// @brief Time between the first and last batch of the last run
+    /// (seconds).
+    double skew;
+    /// @brief Time spent in the MSR batches of the last run (seconds).
+    double msr_time;
+    /// @brief Time spent in the CSR batches of the last run (seconds).
+    double csr_time;
+    /// @brief TSC ticks spent in the MSR batches of the last run.
+    uint64_t msr_tsc;
+    /// @brief TSC ticks spent in the CSR batches of the last run.
+    uint64_t csr_tsc;
+    /// @brief Number of failed CSR operations in the last run.
+    int csr_failed;
+};
+
+/// @brief Reset a sampling transaction to an empty set of batches.
+///
+/// @param [out] txn Sampling transaction.
+void libmsr_sample_init(struct sample_txn *txn);
+
+/// @brief Add an MSR batch to a sampling transaction.
+///
+/// @param [in,out] txn Sampling transaction.
+///
+/// @param [in] batchnum libmsr_data_type_e of an allocated and loaded MSR
+///             batch.
+///
+/// @return 0 if successful, else -1 if the transaction is full.
+int libmsr_sample_add_msr(struct sample_txn *txn,
+                          const int batchnum);
+
+/// @brief Add a CSR batch to a sampling transaction.
+///
+/// @param [in,out] txn Sampling transaction.
+///
+/// @param [in] batchnum csr_data_type_e of an allocated and loaded CSR
+///             batch.
+///
+/// @return 0 if successful, else -1 if the transaction is full.
+int libmsr_sample_add_csr(struct sample_txn *txn,
+                          const int batchnum);
+
+/// @brief Execute every batch of a sampling transaction back-to-back and
+/// stamp the sample.
+///
+/// Failed CSR operations are counted in csr_failed and do not abort the
+/// transaction; use csr_batch_errors() to find them.
+///
+/// @param [in,out] txn Sampling transaction.
+///
+/// @return 0 if successful, else -1 if a batch fails as a whole.
+int libmsr_sample_run(struct sample_txn *txn);
+
+/// @brief Print the timing of the last run of a sampling transaction.
+///
+/// @param [in] writedest File stream where output will be written to.
+///
+/// @param [in] txn Sampling transaction.
+void dump_sample_txn(FILE *writedest,
+                     const struct sample_txn *txn);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,159 @@
+/* msr_topdown.h
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#ifndef MSR_TOPDOWN_H_INCLUDE
+#define MSR_TOPDOWN_H_INCLUDE
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "master.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Top-down microarchitecture analysis, level 1. Each core issue slot (four per
+ * unhalted core cycle, taken from IA32_FIXED_CTR1) is attributed to exactly
+ * one of four categories:
+ *
+ *   Frontend Bound  = IDQ_UOPS_NOT_DELIVERED.CORE / SLOTS
+ *   Bad Speculation = (UOPS_ISSUED.ANY - UOPS_RETIRED.RETIRE_SLOTS
+ *                      + 4 * INT_MISC.RECOVERY_CYCLES) / SLOTS
+ *   Retiring        = UOPS_RETIRED.RETIRE_SLOTS / SLOTS
+ *   Backend Bound   = 1 - (Frontend Bound + Bad Speculation + Retiring)
+ */
+
+/// @brief Number of issue slots per core cycle.
+#define TOPDOWN_SLOTS_PER_CYCLE 4
+
+/// @brief Enum encompassing the events needed for top-down level 1.
+enum topdown_event_e {
+    /// @brief IDQ_UOPS_NOT_DELIVERED.CORE
+    TOPDOWN_FETCH_BUBBLES,
+    /// @brief UOPS_ISSUED.ANY
+    TOPDOWN_UOPS_ISSUED,
+    /// @brief UOPS_RETIRED.RETIRE_SLOTS
+    TOPDOWN_UOPS_RETIRED,
+    /// @brief INT_MISC.RECOVERY_CYCLES
+    TOPDOWN_RECOVERY_CYCLES,
+    /// @brief Number of top-down events.
+    TOPDOWN_NUM_EVENTS,
+};
+
+/// @brief Structure containing the level 1 top-down breakdown.
+struct topdown_fractions {
+    /// @brief Fraction of slots lost to instruction fetch and decode.
+    double frontend_bound;
+    /// @brief Fraction of slots wasted on mispredicted paths and recovery.
+    double bad_speculation;
+    /// @brief Fraction of slots stalled on execution resources or memory.
+    double backend_bound;
+    /// @brief Fraction of slots retiring useful uops.
+    double retiring;
+};
+
+/// @brief Structure containing top-down counter data.
+///
+/// If fewer than TOPDOWN_NUM_EVENTS general-purpose counters are available,
+/// the events are split into groups that are rotated on every poll. Each
+/// event is normalized by the slots of the interval it was counted in.
+struct topdown_data {
+    /// @brief Number of event groups (1 if no multiplexing is needed).
+    int num_groups;
+    /// @brief Number of general-purpose counters used per group.
+    int group_size;
+    /// @brief Group currently programmed.
+    int active_group;
+    /// @brief Raw value stored in IA32_FIXED_CTR1 per thread.
+    uint64_t **clk;
+    /// @brief Raw value stored in IA32_PMC[0-3] per thread.
+    uint64_t **pmc[TOPDOWN_NUM_EVENTS];
+    /// @brief Previous raw value of IA32_FIXED_CTR1 per thread.
+    uint64_t *old_clk;
+    /// @brief Previous raw value of IA32_PMC[0-3] per thread.
+    uint64_t *old_pmc[TOPDOWN_NUM_EVENTS];
+    /// @brief Physical core (socket * cores + core) of each thread.
+    unsigned *core_of;
+    /// @brief Latest events per slot for each event per core.
+    double *core_rate[TOPDOWN_NUM_EVENTS];
+    /// @brief Latest events per slot for each event per socket.
+    double *socket_rate[TOPDOWN_NUM_EVENTS];
+    /// @brief Top-down breakdown per core.
+    struct topdown_fractions *core;
+    /// @brief Top-down breakdown per socket.
+    struct topdown_fractions *socket;
+};
+
+/// @brief Store the top-down counter data on the heap.
+///
+/// IA32_FIXED_CTR1 and the general-purpose counters are loaded into the
+/// TOPDOWN_DATA batch so one read samples every thread.
+///
+/// @param [out] td Pointer to top-down data.
+///
+/// @return 0 if successful, else -1 if no general-purpose counters are
+/// available.
+int topdown_storage(struct topdown_data **td);
+
+/// @brief Program the top-down events on every thread, enable the counters
+/// in IA32_PERF_GLOBAL_CTRL, and take a baseline sample.
+///
+/// This enables the fixed-function counters and overwrites
+/// IA32_PERFEVTSEL[0-3].
+///
+/// @return 0 if successful, else -1 if top-down storage cannot be set up.
+int enable_topdown(void);
+
+/// @brief Sample the counters with one batch read and update the top-down
+/// breakdown per core and per socket.
+///
+/// When multiplexing, the next event group is programmed afterwards.
+///
+/// @return 0 if successful, else -1 if read_batch() fails.
+int poll_topdown_data(void);
+
+/// @brief Print the label for the top-down data print out.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_topdown_data_label(FILE *writedest);
+
+/// @brief Print the top-down breakdown per socket and per core.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_topdown_data(FILE *writedest);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,158 @@
+/* msr_tstate.h
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#ifndef MSR_TSTATE_H_INCLUDE
+#define MSR_TSTATE_H_INCLUDE
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "master.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Duty cycle denominator. Duty cycles are given in sixteenths, the
+/// granularity of extended clock modulation.
+#define TSTATE_DUTY_STEPS 16
+/// @brief Duty cycle meaning clock modulation is disabled (full speed).
+#define TSTATE_DUTY_OFF TSTATE_DUTY_STEPS
+/// @brief On-demand clock modulation enable bit of IA32_CLOCK_MODULATION.
+#define TSTATE_ENABLE (1ULL << 4)
+/// @brief Duty cycle field of IA32_CLOCK_MODULATION (bits 3:0 with extended
+/// clock modulation, bits 3:1 without).
+#define TSTATE_DUTY_MASK 0xFULL
+
+/// @brief Structure holding the per-thread IA32_CLOCK_MODULATION batch.
+///
+/// The TSTATE_CTL batch is loaded by device index, so bit i of a CPU mask
+/// and entry i of a per-CPU array refer to Linux CPU i. Like the p-state
+/// batch, it doubles as a shadow of the register: a request edits the
+/// selected threads in place and writes the whole batch in one ioctl.
+struct tstate_data {
+    /// @brief Number of logical processors.
+    uint64_t num_threads;
+    /// @brief Raw value stored in IA32_CLOCK_MODULATION.
+    uint64_t **clock_mod;
+    /// @brief Non-zero if extended (6.25%) clock modulation is available.
+    int extended;
+};
+
+/// @brief Allocate the per-thread IA32_CLOCK_MODULATION batch, detect
+/// extended clock modulation, and sync the shadow with the hardware.
+///
+/// @param [out] td Pointer to per-thread T-state data.
+void tstate_storage(struct tstate_data **td);
+
+/// @brief Read IA32_CLOCK_MODULATION on every logical processor in one
+/// batch.
+///
+/// This also refreshes the shadow used by the next request.
+///
+/// @param [out] duty Array of num_devs() duty cycles in sixteenths,
+/// TSTATE_DUTY_OFF where clock modulation is disabled, or NULL.
+///
+/// @return 0 if successful, else -1 if the read batch failed.
+int get_tstate(unsigned *duty);
+
+/// @brief Apply the same duty cycle to a set of logical processors with one
+/// batched write.
+///
+/// Without extended clock modulation, odd duty cycles are rounded down to
+/// the 12.5% granularity, with 12.5% as the minimum.
+///
+/// @param [in] cpumask Bitmask of CPUMASK_WORDS(num_devs()) words selecting
+/// the logical processors to change.
+///
+/// @param [in] duty Duty cycle in sixteenths (1-15), or TSTATE_DUTY_OFF to
+/// disable clock modulation.
+///
+/// @param [in] verify If non-zero, read the registers back in one batch and
+/// compare.
+///
+/// @return 0 if successful, number of selected threads that did not take
+/// the request if verify is set, else -1 if the duty cycle is out of range
+/// or a batch failed.
+int set_tstate_mask(const uint64_t *cpumask,
+                    unsigned duty,
+                    int verify);
+
+/// @brief Apply a duty cycle per logical processor with one batched write.
+///
+/// @param [in] duty Array of num_devs() duty cycles in sixteenths (1-15 or
+/// TSTATE_DUTY_OFF), indexed by logical processor. A duty cycle of 0 leaves
+/// that thread unchanged.
+///
+/// @param [in] verify If non-zero, read the registers back in one batch and
+/// compare.
+///
+/// @return 0 if successful, number of threads that did not take the request
+/// if verify is set, else -1 if a duty cycle is out of range or a batch
+/// failed.
+int set_tstate_array(const unsigned *duty,
+                     int verify);
+
+/// @brief Encode a duty cycle into the low 5 bits of IA32_CLOCK_MODULATION.
+///
+/// Bits 3:1 hold eighths and bit 0 the extra sixteenth, so the duty cycle in
+/// sixteenths maps directly onto bits 3:0. Without extended clock modulation
+/// the duty cycle is rounded down to eighths (at least one eighth).
+///
+/// @param [in] td T-state data, only the extended flag is used.
+///
+/// @param [in] duty Duty cycle in sixteenths, or TSTATE_DUTY_OFF.
+///
+/// @return Encoded enable and duty cycle bits.
+uint64_t tstate_encode(const struct tstate_data *td,
+                       unsigned duty);
+
+/// @brief Decode the duty cycle from IA32_CLOCK_MODULATION.
+///
+/// @param [in] td T-state data, only the extended flag is used.
+///
+/// @param [in] raw Register value.
+///
+/// @return Duty cycle in sixteenths, or TSTATE_DUTY_OFF if disabled.
+unsigned tstate_decode(const struct tstate_data *td,
+                       uint64_t raw);
+
+/// @brief Print the clock modulation duty cycle of every logical processor.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_tstate(FILE *writedest);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -34,6 +34,7 @@
 #ifndef MSR_TURBO_H_INCLUDE
 #define MSR_TURBO_H_INCLUDE
 
+#include <stdint.h>
 #include <stdio.h>
 
 #include "master.h"
@@ -77,36 +78,126 @@ struct turbo_limit_data {
     double max_8c;
 };
 
-/// @brief Allocate array for storing raw register data from IA32_PERF_CTL.
+/// @brief Number of active-core counts covered by MSR_TURBO_RATIO_LIMIT and
+/// MSR_TURBO_RATIO_LIMIT1.
+#define TURBO_MODEL_MAX_CORES 16
+
+/// @brief Structure holding the cached turbo model.
+///
+/// The turbo ratio limits are parsed once per socket. Active residency is
+/// the fraction of the last interval a core spent outside C3/C6/C7, since
+/// cores in C0 and C1 both count as active for turbo.
+struct turbo_model {
+    /// @brief Number of sockets.
+    uint64_t num_sockets;
+    /// @brief Number of physical cores per socket.
+    uint64_t cores_per_socket;
+    /// @brief Max ratio (in units of 100 MHz) for n active cores, at index
+    /// socket * TURBO_MODEL_MAX_CORES + (n - 1).
+    uint8_t *max_ratio;
+    /// @brief Number of valid max_ratio entries per socket.
+    unsigned *num_limits;
+    /// @brief Previous sum of C3, C6, and C7 residency per core.
+    uint64_t *old_idle;
+    /// @brief TSC at the previous poll.
+    uint64_t old_tsc;
+    /// @brief Active (C0 + C1) residency per core over the last interval.
+    double *active;
+};
+
+/// @brief IA32_MISC_ENABLE bit 38, set when turbo is disabled by the
+/// platform.
+#define TURBO_MISC_DISABLE ((uint64_t)1 << 38)
+/// @brief IA32_PERF_CTL bit 32 (IDA/Turbo DISENGAGE), set when turbo is
+/// disengaged by software.
+#define TURBO_PERF_CTL_DISENGAGE ((uint64_t)1 << 32)
+
+/// @brief Structure holding the turbo state of one logical processor.
+struct turbo_state {
+    /// @brief 1 if turbo is available (IA32_MISC_ENABLE bit 38 clear).
+    uint8_t available;
+    /// @brief 1 if turbo is engaged (IA32_PERF_CTL bit 32 clear).
+    uint8_t engaged;
+};
+
+/// @brief Structure holding the per-thread turbo batch.
 ///
-/// There are plans to use a struct to make the indirection less crazy.
+/// The TURBO_DATA batch reads IA32_MISC_ENABLE and IA32_PERF_CTL on every
+/// logical processor, loaded by device index so entry i is Linux CPU i.
+/// Changes are written through the per-thread IA32_PERF_CTL batch of
+/// msr_pstate, so turbo and p-state requests share one shadow.
+struct turbo_data {
+    /// @brief Number of logical processors.
+    uint64_t num_threads;
+    /// @brief Raw value stored in IA32_MISC_ENABLE.
+    uint64_t **misc_enable;
+    /// @brief Raw value stored in IA32_PERF_CTL.
+    uint64_t **perf_ctl;
+    /// @brief Decoded turbo state per logical processor.
+    struct turbo_state *state;
+};
+
+/// @brief Retrieve the per-thread IA32_PERF_CTL values written by
+/// enable_turbo() and disable_turbo().
 ///
-/// @param [in] val Pointer to array of raw IA32_PERF_CTL data, length equal to
-///        the total number of logical processors.
+/// @param [out] val Pointer to array of raw IA32_PERF_CTL data, length equal
+/// to the total number of logical processors.
 void turbo_storage(uint64_t ***val);
 
+/// @brief Allocate the TURBO_DATA batch.
+///
+/// @param [out] td Pointer to per-thread turbo data.
+void turbo_data_storage(struct turbo_data **td);
+
+/// @brief Read IA32_MISC_ENABLE and IA32_PERF_CTL on every logical processor
+/// in one batch and decode the turbo state.
+///
+/// @param [out] state Set to the array of num_devs() turbo states, indexed
+/// by logical processor, or NULL.
+///
+/// @return 0 if successful, else -1 if the read batch failed.
+int get_turbo_state(struct turbo_state **state);
+
+/// @brief Engage or disengage turbo on a set of logical processors with one
+/// batched write of IA32_PERF_CTL.
+///
+/// Bit 32 of IA32_PERF_CTL is not shared across logical processors in a
+/// package, so it should be set to the same value across all logical
+/// processors in the same package.
+///
+/// @param [in] cpumask Bitmask of CPUMASK_WORDS(num_devs()) words selecting
+/// the logical processors to change, or NULL for all.
+///
+/// @param [in] enable Non-zero to engage turbo, 0 to disengage it.
+///
+/// @return 0 if successful, else -1 if a batch failed.
+int set_turbo_mask(const uint64_t *cpumask,
+                   int enable);
+
 /// @brief Enable turbo by modifying IA32_PERF_CTL on each logical processor.
 ///
 /// Enable Intel Dynamic Acceleration (IDA) and Intel Turbo Boost Technology by
-/// setting bit 32 of IA32_PERF_CTL to 0. This bit is not shared across logical
-/// processors in a package, so it must be modified to the same value across
-/// all logical processors in the same package.
-void enable_turbo(void);
+/// setting bit 32 of IA32_PERF_CTL to 0 on every logical processor with one
+/// read batch and one write batch.
+///
+/// @return 0 if successful, else -1 if a batch failed.
+int enable_turbo(void);
 
 /// @brief Disable turbo by modifying IA32_PERF_CTL on each logical processor.
 ///
 /// Disable Intel Dynamic Acceleration (IDA) and Intel Turbo Boost Technology by
-/// setting bit 32 of IA32_PERF_CTL to 1. This bit is not shared across logical
-/// processors in a package, so it must be modified to the same value across
-/// all logical processors in the same package.
-void disable_turbo(void);
+/// setting bit 32 of IA32_PERF_CTL to 1 on every logical processor with one
+/// read batch and one write batch.
+///
+/// @return 0 if successful, else -1 if a batch failed.
+int disable_turbo(void);
 
 /// @brief Print turbo data for each logical processor.
 ///
 /// For each logical processor, print the unique core identifier, the value of
-/// bit 32 for IA32_PERF_CTL (1 indicates IDA/Turbo Boost is enabled) and the
-/// value of bit 38 for IA32_MISC_ENABLE (1 indicates support for IDA/Turbo
-/// Boost by the platform).
+/// bit 32 for IA32_PERF_CTL (0 indicates IDA/Turbo Boost is engaged) and the
+/// value of bit 38 for IA32_MISC_ENABLE (0 indicates support for IDA/Turbo
+/// Boost by the platform), both read in one batch.
 ///
 /// @param [in] writedest File stream where output will be written to.
 void dump_turbo(FILE *writedest);
@@ -157,6 +248,79 @@ int get_turbo_ratio_limit(const unsigned socket,
                           struct turbo_limit_data *info,
                           struct turbo_limit_data *info2);
 
+/// @brief Parse the turbo ratio limits of every socket once and set up
+/// active residency tracking from core_cres_storage().
+///
+/// @param [out] tm Pointer to the turbo model.
+///
+/// @return 0 if successful, else -1 if the turbo ratio limits are not
+/// supported.
+int turbo_model_storage(struct turbo_model **tm);
+
+/// @brief Get the max turbo frequency for a number of active cores.
+///
+/// Counts beyond the parsed limits use the last parsed limit.
+///
+/// @param [in] socket Unique socket/package identifier.
+///
+/// @param [in] n Number of active cores (at least 1).
+///
+/// @return Max frequency in MHz, else -1 if the socket or count is invalid
+/// or the turbo model is unavailable.
+double max_freq_for_active_cores(unsigned socket,
+                                 unsigned n);
+
+/// @brief Sample core C-state residencies with one batch read and update
+/// the active residency of every core.
+///
+/// The first call only takes a baseline.
+///
+/// @return 0 if successful, else -1 if the turbo model is unavailable or
+/// read_batch() fails.
+int poll_turbo_model(void);
+
+/// @brief Predict the frequency active cores reach from their active
+/// residencies and ratio limits.
+///
+/// Each core is treated as independently active with probability equal to
+/// its active residency. The max frequency for each active-core count is
+/// weighted by the probability of that count times the count. With no
+/// activity, the 1-core limit is returned.
+///
+/// @param [in] active Active residency (0 to 1) of each core.
+///
+/// @param [in] ncores Number of cores in active.
+///
+/// @param [in] max_ratio Ratio limit for 1, 2, ... active cores.
+///
+/// @param [in] num_limits Number of entries in max_ratio; counts beyond it
+/// use the last limit.
+///
+/// @return Predicted frequency in MHz, else -1 if num_limits is 0.
+double turbo_model_predict(const double *active,
+                           unsigned ncores,
+                           const uint8_t *max_ratio,
+                           unsigned num_limits);
+
+/// @brief Predict the frequency active cores can reach on a socket.
+///
+/// Each core is treated as independently active with probability equal to
+/// its active residency. The max frequency for each active-core count is
+/// weighted by the probability of that count times the count, i.e., by the
+/// core time spent at that frequency.
+///
+/// @param [in] socket Unique socket/package identifier.
+///
+/// @return Predicted frequency in MHz, else -1 if the turbo model is
+/// unavailable or the socket is invalid.
+double predict_turbo_freq(unsigned socket);
+
+/// @brief Print the turbo ratio limits and the predicted frequency of every
+/// socket.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_turbo_model(FILE *writedest);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,124 @@
+/* msr_uncore_freq.h
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#ifndef MSR_UNCORE_FREQ_H_INCLUDE
+#define MSR_UNCORE_FREQ_H_INCLUDE
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "master.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief U_MSR_PMON_UCLK_FIXED_CTL counter enable bit.
+#define UNCORE_UCLK_EN (1UL << 22)
+
+/// @brief Structure holding uncore frequency data per socket.
+///
+/// The ratio limits are in units of 100 MHz. MSR_UNCORE_RATIO_LIMIT holds
+/// the max ratio in bits 6:0 and the min ratio in bits 14:8; it is only
+/// available when the platform header sets UNCORE_HAS_RATIO_LIMIT. The
+/// actual uncore clock is measured with the U-box UCLK fixed counter.
+struct uncore_freq_data {
+    /// @brief Number of sockets.
+    uint64_t num_sockets;
+    /// @brief Raw value stored in MSR_UNCORE_RATIO_LIMIT.
+    uint64_t **ratio_limit;
+    /// @brief Raw value stored in U_MSR_PMON_UCLK_FIXED_CTL.
+    uint64_t **uclk_ctl;
+    /// @brief Raw value stored in U_MSR_PMON_UCLK_FIXED_CTR.
+    uint64_t **uclk;
+    /// @brief Previous raw value of U_MSR_PMON_UCLK_FIXED_CTR.
+    uint64_t *old_uclk;
+    /// @brief CLOCK_MONOTONIC time of the previous poll (seconds).
+    double old_time;
+    /// @brief Measured uncore frequency over the last interval (MHz).
+    double *freq;
+};
+
+/// @brief Allocate the uncore frequency batches.
+///
+/// @param [out] ud Pointer to uncore frequency data.
+void uncore_freq_storage(struct uncore_freq_data **ud);
+
+/// @brief Read MSR_UNCORE_RATIO_LIMIT on every socket in one batch.
+///
+/// @param [out] min_ratio Array of num_sockets() min ratios, or NULL.
+///
+/// @param [out] max_ratio Array of num_sockets() max ratios, or NULL.
+///
+/// @return 0 if successful, else -1 if MSR_UNCORE_RATIO_LIMIT is not
+/// supported or the read batch failed.
+int get_uncore_ratio_limit(uint64_t *min_ratio,
+                           uint64_t *max_ratio);
+
+/// @brief Set MSR_UNCORE_RATIO_LIMIT on every socket with one batched
+/// write.
+///
+/// @param [in] min_ratio Array of num_sockets() min ratios, or NULL. A
+/// ratio of 0 leaves that socket's min ratio unchanged.
+///
+/// @param [in] max_ratio Array of num_sockets() max ratios, or NULL. A
+/// ratio of 0 leaves that socket's max ratio unchanged.
+///
+/// @return 0 if successful, else -1 if MSR_UNCORE_RATIO_LIMIT is not
+/// supported, a ratio is out of range or above the max ratio, or a batch
+/// failed.
+int set_uncore_ratio_limit(const uint64_t *min_ratio,
+                           const uint64_t *max_ratio);
+
+/// @brief Enable the U-box UCLK fixed counter on every socket and take a
+/// baseline.
+///
+/// @return 0 if successful, else -1 if a batch failed.
+int enable_uncore_freq_counter(void);
+
+/// @brief Read the UCLK fixed counter on every socket in one batch and
+/// update the measured uncore frequency.
+///
+/// @return 0 if successful, else -1 if the read batch failed.
+int poll_uncore_freq(void);
+
+/// @brief Print the ratio limits and measured uncore frequency of every
+/// socket.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_uncore_freq(FILE *writedest);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -44,6 +44,7 @@
 #define IA32_CLOCK_MODULATION	0x19A
 #define IA32_PERF_STATUS		0x198
 #define IA32_PERF_CTL			0x199
+#define MSR_PLATFORM_INFO		0xCE
 
 /************/
 /* COUNTERS */
@@ -75,10 +76,13 @@
 #define IA32_PERFEVTSEL6 0x18C
 #define IA32_PERFEVTSEL7 0x18D
 
+#define MSR_PCU_PMON_BOX_CTL    0xC24
 #define MSR_PCU_PMON_EVNTSEL0   0xC30
 #define MSR_PCU_PMON_EVNTSEL1   0xC31
 #define MSR_PCU_PMON_EVNTSEL2   0xC32
 #define MSR_PCU_PMON_EVNTSEL3   0xC33
+#define MSR_PCU_PMON_BOX_FILTER 0xC34
+#define MSR_PCU_PMON_BOX_STATUS 0xC35
 #define MSR_PCU_PMON_CTR0   0xC36
 #define MSR_PCU_PMON_CTR1   0xC37
 #define MSR_PCU_PMON_CTR2   0xC38
@@ -222,6 +226,23 @@
 #define IA32_MISC_ENABLE 0x1A0
 #define IA32_PERF_CTL	 0x199
 
+/**********************/
+/* PERF LIMIT REASONS */
+/**********************/
+#define MSR_CORE_PERF_LIMIT_REASONS     0x690
+#define MSR_GRAPHICS_PERF_LIMIT_REASONS 0x6B0
+#define MSR_RING_PERF_LIMIT_REASONS     0x6B1
+
+/***************/
+/* HWP AND EPB */
+/***************/
+// Architectural; presence is checked at runtime with CPUID leaf 6.
+#define IA32_ENERGY_PERF_BIAS 0x1B0
+#define IA32_PM_ENABLE        0x770
+#define IA32_HWP_CAPABILITIES 0x771
+#define IA32_HWP_REQUEST_PKG  0x772
+#define IA32_HWP_REQUEST      0x774
+
 /***********/
 /* CSR iMC */
 /***********/
@@ -242,9 +263,19 @@
 #define CSR_PMONCTR2     0xB0
 #define CSR_PMONCTR3     0xB8
 
+#define CSR_PMONFIXEDCTL 0xF0
+#define CSR_PMONFIXEDCTR 0xD0
+
 #define CSR_PMONUNITCTRL 0xF4
 #define CSR_PMONUNITSTAT 0xF8
 
+/* PCI device IDs of the iMC channel PMON functions, indexed [iMC][channel].
+ * Entries of 0 mark channels that do not exist on this platform. */
+#define IMC_NUM_CONTROLLERS 1
+#define IMC_CHANNEL_DIDS {{0x3CB0, 0x3CB1, 0x3CB4, 0x3CB5}, {0, 0, 0, 0}}
+#define IMC_CHANNEL_DEVS {{IMC0_DEV, IMC0_DEV, IMC0_DEV, IMC0_DEV}, {0, 0, 0, 0}}
+#define IMC_CHANNEL_FUNCS {IMC_CH0_FUNC, IMC_CH1_FUNC, IMC_CH2_FUNC, IMC_CH3_FUNC}
+
 /******************/
 /* CSR iMC EVENTS */
 /******************/
@@ -300,3 +331,166 @@
 #define UMASK_PRE_RD  0x4
 #define UMASK_PRE_WR  0x8
 #define UMASK_PRE_BYP 0x16
+
+/**************/
+/* PCU EVENTS */
+/**************/
+#define PCU_EVT_CLOCKTICKS                 0x00
+#define PCU_EVT_FREQ_MAX_LIMIT_THERMAL     0x04
+#define PCU_EVT_FREQ_MAX_POWER             0x05
+#define PCU_EVT_FREQ_MAX_OS                0x06
+#define PCU_EVT_PROCHOT_INTERNAL           0x09
+#define PCU_EVT_PROCHOT_EXTERNAL           0x0A
+#define PCU_EVT_FREQ_BAND0_CYCLES          0x0B
+#define PCU_EVT_FREQ_BAND1_CYCLES          0x0C
+#define PCU_EVT_FREQ_BAND2_CYCLES          0x0D
+#define PCU_EVT_FREQ_BAND3_CYCLES          0x0E
+#define PCU_EVT_CORE0_TRANSITION_CYCLES    0x03
+#define PCU_EVT_POWER_STATE_OCCUPANCY      0x80
+
+#define PCU_OCC_C0                         0x1
+#define PCU_OCC_C3                         0x2
+#define PCU_OCC_C6                         0x3
+
+/**************/
+/* CBO EVENTS */
+/**************/
+#define CBO_NUM_SLICES                     8
+#define CBO_CTR_WIDTH                      44
+#define CBO_HAS_FILTER1                    0
+#define CBO_FILTER_STATE_ALL               (0x1FUL << 18)
+
+#define CBO_EVT_CLOCKTICKS                 0x00
+#define CBO_EVT_LLC_LOOKUP                 0x34
+#define CBO_EVT_TOR_INSERTS                0x35
+#define CBO_EVT_TOR_OCCUPANCY              0x36
+#define CBO_EVT_LLC_VICTIMS                0x37
+
+#define CBO_UMASK_LLC_LOOKUP_DATA_READ     0x03
+#define CBO_UMASK_LLC_LOOKUP_WRITE         0x05
+#define CBO_UMASK_LLC_LOOKUP_ANY           0x11
+#define CBO_UMASK_LLC_VICTIMS_ALL          0x07
+#define CBO_UMASK_TOR_OPCODE               0x01
+#define CBO_UMASK_TOR_MISS_OPCODE          0x03
+#define CBO_UMASK_TOR_ALL                  0x08
+#define CBO_UMASK_TOR_MISS_ALL             0x0A
+
+/*******************/
+/* TOP-DOWN EVENTS */
+/*******************/
+#define EVT_IDQ_UOPS_NOT_DELIVERED         0x9C
+#define EVT_UOPS_ISSUED                    0x0E
+#define EVT_UOPS_RETIRED                   0xC2
+#define EVT_INT_MISC                       0x0D
+
+#define UMASK_IDQ_UOPS_NOT_DELIVERED_CORE  0x01
+#define UMASK_UOPS_ISSUED_ANY              0x01
+#define UMASK_UOPS_RETIRED_RETIRE_SLOTS    0x02
+#define UMASK_INT_MISC_RECOVERY_CYCLES     0x03
+#define CMASK_INT_MISC_RECOVERY_CYCLES     0x01
+
+/***********/
+/* CSR QPI */
+/***********/
+/* PCI device IDs and devices of the QPI port PMON functions, indexed by port.
+ * Entries of 0 mark ports that do not exist on this platform. */
+#define QPI_NUM_PORTS                      2
+#define QPI_PORT_DIDS                      {0x3C41, 0x3C42, 0}
+#define QPI_PORT_DEVS                      {8, 9, 0}
+#define QPI_PORT_FUNC                      2
+
+#define CSR_QPI_PMONCTRCFG0                0xD8
+#define CSR_QPI_PMONCTRCFG1                0xDC
+#define CSR_QPI_PMONCTRCFG2                0xE0
+#define CSR_QPI_PMONCTRCFG3                0xE4
+
+#define CSR_QPI_PMONCTR0                   0xA0
+#define CSR_QPI_PMONCTR1                   0xA8
+#define CSR_QPI_PMONCTR2                   0xB0
+#define CSR_QPI_PMONCTR3                   0xB8
+
+#define CSR_QPI_PMONBOXCTL                 0xF4
+#define CSR_QPI_PMONBOXSTATUS              0xF8
+
+/******************/
+/* CSR QPI EVENTS */
+/******************/
+#define QPI_EVT_TXL_FLITS_G0               0x00
+#define QPI_EVT_RXL_FLITS_G0               0x01
+#define QPI_EVT_CLOCKTICKS                 0x14
+
+#define QPI_UMASK_FLITS_G0_IDLE            0x01
+#define QPI_UMASK_FLITS_G0_DATA            0x02
+#define QPI_UMASK_FLITS_G0_NON_DATA        0x04
+
+/**********/
+/* CSR HA */
+/**********/
+/* PCI device IDs, devices and functions of the Home Agent PMON functions,
+ * indexed by Home Agent. Entries of 0 mark units that do not exist on this
+ * platform. */
+#define HA_NUM_UNITS                       1
+#define HA_UNIT_DIDS                       {0x3C46}
+#define HA_UNIT_DEVS                       {14}
+#define HA_UNIT_FUNCS                      {1}
+
+#define CSR_HA_PMONCTRCFG0                 0xD8
+#define CSR_HA_PMONCTRCFG1                 0xDC
+#define CSR_HA_PMONCTRCFG2                 0xE0
+#define CSR_HA_PMONCTRCFG3                 0xE4
+
+#define CSR_HA_PMONCTR0                    0xA0
+#define CSR_HA_PMONCTR1                    0xA8
+#define CSR_HA_PMONCTR2                    0xB0
+#define CSR_HA_PMONCTR3                    0xB8
+
+/*****************/
+/* CSR HA EVENTS */
+/*****************/
+#define HA_EVT_REQUESTS                    0x01
+#define HA_EVT_DIRECTORY_LOOKUP            0x0C
+#define HA_EVT_SNOOP_RESP                  0x21
+
+#define HA_UMASK_REQUESTS_READS_LOCAL      0x01
+#define HA_UMASK_REQUESTS_READS_REMOTE     0x02
+#define HA_UMASK_REQUESTS_WRITES_LOCAL     0x04
+#define HA_UMASK_REQUESTS_WRITES_REMOTE    0x08
+#define HA_UMASK_DIRECTORY_LOOKUP_ALL      0x03
+#define HA_UMASK_SNOOP_RESP_ALL            0x7F
+
+/**************/
+/* CSR R2PCIE */
+/**************/
+#define R2PCIE_DID                         0x3C43
+#define R2PCIE_DEV                         19
+#define R2PCIE_FUNC                        1
+
+#define CSR_R2PCIE_PMONCTRCFG0             0xD8
+#define CSR_R2PCIE_PMONCTRCFG1             0xDC
+#define CSR_R2PCIE_PMONCTRCFG2             0xE0
+#define CSR_R2PCIE_PMONCTRCFG3             0xE4
+
+#define CSR_R2PCIE_PMONCTR0                0xA0
+#define CSR_R2PCIE_PMONCTR1                0xA8
+#define CSR_R2PCIE_PMONCTR2                0xB0
+#define CSR_R2PCIE_PMONCTR3                0xB8
+
+/*********************/
+/* CSR R2PCIE EVENTS */
+/*********************/
+#define R2PCIE_EVT_CLOCKTICKS              0x01
+#define R2PCIE_EVT_RING_AD_USED            0x07
+#define R2PCIE_EVT_RING_BL_USED            0x09
+#define R2PCIE_EVT_RXR_CYCLES_NE           0x10
+
+#define R2PCIE_UMASK_RING_USED_ALL         0x0F
+#define R2PCIE_UMASK_RXR_NCB_NCS           0x30
+
+/********************/
+/* UNCORE FREQUENCY */
+/********************/
+#define U_MSR_PMON_UCLK_FIXED_CTL          0xC08
+#define U_MSR_PMON_UCLK_FIXED_CTR          0xC09
+
+#define UNCORE_HAS_RATIO_LIMIT             0
+#define UNCORE_UCLK_CTR_WIDTH              44
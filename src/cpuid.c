@@ -214,6 +214,16 @@ int cpuid_num_pmc(void)
     return MASK_VAL(rax, 15, 8);
 }
 
+int cpuid_width_pmc(void)
+{
+    /* See Manual Vol 3B, Section 18.2.1.1 for details. */
+    uint64_t rax, rbx, rcx, rdx;
+    int leaf = 10; // 0A
+
+    cpuid(leaf, &rax, &rbx, &rcx, &rdx);
+    return MASK_VAL(rax, 23, 16);
+}
+
 int cpuid_num_perfevtsel(void)
 {
     /* See Manual Vol 3B, Section 18.2.1.1 for details. */
@@ -414,6 +424,74 @@ bool cpuid_pkg_therm_enable_status_and_interrupt(void)
     }
 }
 
+bool cpuid_hwp_avail(void)
+{
+    /* See Manual Vol 3B, Section 14.4.1 for details. */
+    uint64_t rax, rbx, rcx, rdx;
+    int leaf = 6;
+
+    cpuid(leaf, &rax, &rbx, &rcx, &rdx);
+    if (MASK_VAL(rax, 7, 7) == 1)
+    {
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+bool cpuid_hwp_epp_avail(void)
+{
+    /* See Manual Vol 3B, Section 14.4.1 for details. */
+    uint64_t rax, rbx, rcx, rdx;
+    int leaf = 6;
+
+    cpuid(leaf, &rax, &rbx, &rcx, &rdx);
+    if (MASK_VAL(rax, 10, 10) == 1)
+    {
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+bool cpuid_hwp_pkg_request_avail(void)
+{
+    /* See Manual Vol 3B, Section 14.4.1 for details. */
+    uint64_t rax, rbx, rcx, rdx;
+    int leaf = 6;
+
+    cpuid(leaf, &rax, &rbx, &rcx, &rdx);
+    if (MASK_VAL(rax, 11, 11) == 1)
+    {
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+bool cpuid_energy_perf_bias_avail(void)
+{
+    /* See Manual Vol 3B, Section 14.3.4 for details. */
+    uint64_t rax, rbx, rcx, rdx;
+    int leaf = 6;
+
+    cpuid(leaf, &rax, &rbx, &rcx, &rdx);
+    if (MASK_VAL(rcx, 3, 3) == 1)
+    {
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
 uint64_t cpuid_MaxLeaf(void)
 {
     uint64_t rax, rbx, rcx, rdx;
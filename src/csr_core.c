@@ -31,6 +31,7 @@
  *
  */
 
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <stdlib.h>
@@ -41,6 +42,7 @@
 #include <unistd.h>
 
 #include "csr_core.h"
+#include "master.h"
 #include "memhdlr.h"
 #include "cpuid.h"
 #include "libmsr_debug.h"
@@ -55,54 +57,293 @@ static int *csr_fd(void)
     return &csrsafe;
 }
 
-int init_csr(void)
+int csr_capabilities(void)
 {
-    int *fileDescriptor = csr_fd();
-    char filename[CSR_FILENAME_SIZE];
+    static int caps = -1;
+    static const unsigned dids[HA_NUM_UNITS] = HA_UNIT_DIDS;
+    static const unsigned devs[HA_NUM_UNITS] = HA_UNIT_DEVS;
+    static const unsigned funcs[HA_NUM_UNITS] = HA_UNIT_FUNCS;
+    struct csr_pci_unit *units = NULL;
+    struct csr_batch_array probe;
+    struct csr_batch_op op;
     struct stat statbuf;
-    static int init = 0;
+    int fd;
 
-    snprintf(filename, CSR_FILENAME_SIZE, CSR_MODULE);
-    if (!init)
+    if (caps >= 0)
     {
-        init = 1;
-        if (stat(filename, &statbuf))
-        {
-            fprintf(stderr, "Warning: <libmsr> Could not stat %s: init_csr(): %s: %s:%s::%d\n", CSR_MODULE, strerror(errno), getenv("HOSTNAME"), __FILE__, __LINE__);
-        }
-        if (!(statbuf.st_mode & S_IRUSR) || !(statbuf.st_mode & S_IWUSR))
+        return caps;
+    }
+    caps = 0;
+    if (stat(CSR_MODULE, &statbuf) == 0)
+    {
+        caps |= CSR_CAP_MODULE;
+    }
+    if ((caps & CSR_CAP_MODULE) && access(CSR_MODULE, R_OK | W_OK) == 0)
+    {
+        caps |= CSR_CAP_RW;
+    }
+    if (!(caps & CSR_CAP_RW))
+    {
+        return caps;
+    }
+    fd = (*csr_fd() > 0 ? *csr_fd() : open(CSR_MODULE, O_RDWR));
+    /* Any uncore function will do; the Home Agent exists on every platform. */
+    if (fd >= 0 && csr_pci_units(dids, devs, funcs, HA_NUM_UNITS, 1, &units))
+    {
+        /* Offset 0 of PCI config space holds the vendor ID. */
+        memset(&op, 0, sizeof(op));
+        op.bus = CSR_UNCORE_BUS;
+        op.device = units[0].device;
+        op.function = units[0].function;
+        op.socket = units[0].socket;
+        op.isread = 1;
+        op.size = 4;
+        probe.numops = 1;
+        probe.ops = &op;
+        if (ioctl(fd, CSRSAFE_8086_BATCH, &probe) >= 0 && op.err == 0 && (op.csrdata & 0xFFFF) == CSR_PCI_VENDOR_INTEL)
         {
-            fprintf(stderr, "Warning: <libmsr> Incorrect permissions on csr_safe: init_csr(): %s:%s::%d\n", getenv("HOSTNAME"), __FILE__, __LINE__);
+            caps |= CSR_CAP_BATCH;
         }
-        *fileDescriptor = open(filename, O_RDWR);
     }
-    else
+    if (units != NULL)
+    {
+        libmsr_free(units);
+    }
+    if (fd >= 0 && fd != *csr_fd())
+    {
+        close(fd);
+    }
+    return caps;
+}
+
+int init_csr(void)
+{
+    int *fileDescriptor = csr_fd();
+    int caps;
+
+    if (*fileDescriptor > 0)
+    {
+        return 0;
+    }
+    caps = csr_capabilities();
+    if (!(caps & CSR_CAP_MODULE))
     {
         libmsr_error_handler("init_csr(): Unable to find csr_safe module", LIBMSR_ERROR_MSR_MODULE, getenv("HOSTNAME"), __FILE__, __LINE__);
         return -1;
     }
+    if (!(caps & CSR_CAP_RW))
+    {
+        libmsr_error_handler("init_csr(): Incorrect permissions on csr_safe", LIBMSR_ERROR_CSR_INIT, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    *fileDescriptor = open(CSR_MODULE, O_RDWR);
+    if (*fileDescriptor < 0)
+    {
+        libmsr_error_handler("init_csr(): Unable to open csr_safe", LIBMSR_ERROR_MSR_OPEN, getenv("HOSTNAME"), __FILE__, __LINE__);
+        *fileDescriptor = 0;
+        return -1;
+    }
     return 0;
 }
 
 int finalize_csr(void)
 {
     int *fileDescriptor = csr_fd();
-    int err = 0;
 
-    if (fileDescriptor)
+    if (*fileDescriptor <= 0)
     {
-        err = close(*fileDescriptor);
+        return 0;
     }
-    if (err)
+    if (close(*fileDescriptor))
     {
         libmsr_error_handler("finalize_csr(): Could not close csr_fd", LIBMSR_ERROR_MSR_CLOSE, getenv("HOSTNAME"), __FILE__, __LINE__);
         return -1;
     }
-    else
+    *fileDescriptor = 0;
+    return 0;
+}
+
+/// @brief Compare two PCI functions by bus, device, and function.
+static int csr_pci_cmp(const void *a, const void *b)
+{
+    const struct csr_pci_dev *x = (const struct csr_pci_dev *) a;
+    const struct csr_pci_dev *y = (const struct csr_pci_dev *) b;
+
+    if (x->bus != y->bus)
     {
-        *fileDescriptor = 0;
+        return (x->bus < y->bus ? -1 : 1);
     }
-    return 0;
+    if (x->device != y->device)
+    {
+        return (x->device < y->device ? -1 : 1);
+    }
+    return (x->function < y->function ? -1 : (x->function > y->function));
+}
+
+/// @brief Read a hexadecimal sysfs attribute of a PCI function.
+///
+/// @param [in] dev Name of the PCI function (e.g., 0000:7f:14.0).
+///
+/// @param [in] attr Name of the attribute (e.g., vendor, device).
+///
+/// @param [out] val Value of the attribute.
+///
+/// @return 0 if successful, else -1 if the attribute could not be read.
+static int read_pci_attr(const char *dev, const char *attr, unsigned *val)
+{
+    char path[CSR_FILENAME_SIZE * 2];
+    FILE *fp;
+    int ret;
+
+    snprintf(path, sizeof(path), "%s/%s/%s", CSR_PCI_SYSFS, dev, attr);
+    fp = fopen(path, "r");
+    if (fp == NULL)
+    {
+        return -1;
+    }
+    ret = fscanf(fp, "%x", val);
+    fclose(fp);
+    return (ret == 1 ? 0 : -1);
+}
+
+int csr_pci_storage(struct csr_pci_dev **devs, unsigned *num)
+{
+    static struct csr_pci_dev *table = NULL;
+    static unsigned count = 0;
+    static int init = 0;
+    static int err = 0;
+    unsigned cap = 0;
+    unsigned vendor, did, domain, bus, dev, func;
+    struct dirent *ent;
+    DIR *dir;
+
+    if (!init)
+    {
+        init = 1;
+        dir = opendir(CSR_PCI_SYSFS);
+        if (dir == NULL)
+        {
+            libmsr_error_handler("csr_pci_storage(): Unable to open " CSR_PCI_SYSFS, LIBMSR_ERROR_CSR_INIT, getenv("HOSTNAME"), __FILE__, __LINE__);
+            err = -1;
+        }
+        while (dir != NULL && (ent = readdir(dir)) != NULL)
+        {
+            if (sscanf(ent->d_name, "%x:%x:%x.%x", &domain, &bus, &dev, &func) != 4)
+            {
+                continue;
+            }
+            if (read_pci_attr(ent->d_name, "vendor", &vendor) || vendor != CSR_PCI_VENDOR_INTEL)
+            {
+                continue;
+            }
+            if (read_pci_attr(ent->d_name, "device", &did))
+            {
+                continue;
+            }
+            if (count == cap)
+            {
+                cap = (cap ? 2 * cap : 64);
+                table = (struct csr_pci_dev *) libmsr_realloc(table, cap * sizeof(struct csr_pci_dev));
+            }
+            table[count].did = did;
+            table[count].bus = bus;
+            table[count].device = dev;
+            table[count].function = func;
+            count++;
+        }
+        if (dir != NULL)
+        {
+            closedir(dir);
+        }
+        if (count)
+        {
+            qsort(table, count, sizeof(struct csr_pci_dev), csr_pci_cmp);
+        }
+    }
+    if (devs != NULL)
+    {
+        *devs = table;
+    }
+    if (num != NULL)
+    {
+        *num = count;
+    }
+    return err;
+}
+
+struct csr_pci_dev *csr_pci_find(uint16_t did, unsigned socket)
+{
+    struct csr_pci_dev *table = NULL;
+    unsigned count = 0;
+    unsigned i;
+
+    csr_pci_storage(&table, &count);
+    for (i = 0; i < count; i++)
+    {
+        if (table[i].did == did)
+        {
+            if (socket == 0)
+            {
+                return &table[i];
+            }
+            socket--;
+        }
+    }
+    return NULL;
+}
+
+unsigned csr_pci_units(const unsigned *dids, const unsigned *devs, const unsigned *funcs, unsigned n, unsigned fallback_sockets, struct csr_pci_unit **units)
+{
+    struct csr_pci_unit *u = NULL;
+    struct csr_pci_dev *dev;
+    unsigned found = 0;
+    unsigned cap = 0;
+    unsigned s, i;
+    int any;
+
+    for (s = 0, any = 1; any; s++)
+    {
+        any = 0;
+        for (i = 0; i < n; i++)
+        {
+            if (dids[i] == 0 || (dev = csr_pci_find(dids[i], s)) == NULL)
+            {
+                continue;
+            }
+            if (found == cap)
+            {
+                cap = (cap ? 2 * cap : 2 * n);
+                u = (struct csr_pci_unit *) libmsr_realloc(u, cap * sizeof(struct csr_pci_unit));
+            }
+            u[found].socket = s;
+            u[found].index = i;
+            u[found].device = dev->device;
+            u[found].function = dev->function;
+            found++;
+            any = 1;
+        }
+    }
+    if (!found && fallback_sockets)
+    {
+        u = (struct csr_pci_unit *) libmsr_calloc(fallback_sockets * n, sizeof(struct csr_pci_unit));
+        for (s = 0; s < fallback_sockets; s++)
+        {
+            for (i = 0; i < n; i++)
+            {
+                if (dids[i] == 0)
+                {
+                    continue;
+                }
+                u[found].socket = s;
+                u[found].index = i;
+                u[found].device = devs[i];
+                u[found].function = funcs[i];
+                found++;
+            }
+        }
+    }
+    *units = u;
+    return found;
 }
 
 // CSRs have their own batch functions so that they can be used independently
@@ -157,11 +398,40 @@ int csr_batch_storage(struct csr_batch_array **batchsel, const int batchnum, uns
     return 0;
 }
 
+/// @brief Structure holding the status of the last execution of a batch.
+struct csr_batch_status {
+    /// @brief Error code of each operation.
+    int *err;
+    /// @brief Number of failed operations.
+    int failed;
+    /// @brief Whether a whole-batch failure has already been reported.
+    int reported;
+};
+
+/// @brief Store the status of each uncore batch on the heap.
+///
+/// @param [in] batchnum csr_data_type_e data type of batch operation.
+///
+/// @return Status of the batch.
+static struct csr_batch_status *csr_status_storage(const int batchnum)
+{
+    static struct csr_batch_status *status = NULL;
+    static unsigned arrsize = 0;
+
+    if (batchnum + 1 > arrsize)
+    {
+        status = (struct csr_batch_status *) libmsr_realloc(status, (batchnum + 1) * sizeof(struct csr_batch_status));
+        memset(&status[arrsize], 0, (batchnum + 1 - arrsize) * sizeof(struct csr_batch_status));
+        arrsize = batchnum + 1;
+    }
+    return &status[batchnum];
+}
+
 int allocate_csr_batch(const int batchnum, size_t bsize)
 {
     unsigned *size = NULL;
     struct csr_batch_array *batch = NULL;
-    struct csr_batch_op *op;
+    struct csr_batch_status *status;
 #ifdef CSRDEBUG
     fprintf(stderr, "CSRBATCH: allocating batch %d\n", batchnum);
 #endif
@@ -169,34 +439,37 @@ int allocate_csr_batch(const int batchnum, size_t bsize)
     {
         return -1;
     }
-    *size = bsize;
     if (batch->ops != NULL)
     {
         libmsr_error_handler("allocate_csr_batch(): Conflicting batch pointers", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
     }
+    *size = bsize;
+    batch->numops = 0;
     batch->ops = (struct csr_batch_op *) libmsr_calloc(*size, sizeof(struct csr_batch_op));
-    for (op = batch->ops; op < op + batch->numops; op++)
-    {
-        op->err = 0;
-    }
+    status = csr_status_storage(batchnum);
+    status->err = (int *) libmsr_calloc(*size, sizeof(int));
+    status->failed = 0;
+    status->reported = 0;
     return 0;
 }
 
 int free_csr_batch(const int batchnum)
 {
     struct csr_batch_array *batch = NULL;
-    static unsigned *size = NULL;
+    struct csr_batch_status *status;
+    unsigned *size = NULL;
 
-    if (batch == NULL)
+    if (csr_batch_storage(&batch, batchnum, &size))
     {
-        if (csr_batch_storage(&batch, batchnum, &size))
-        {
-            return -1;
-        }
+        return -1;
     }
-    size[batchnum] = 0;
-    libmsr_free(batch[batchnum].ops);
-    batch[batchnum].ops = NULL;
+    *size = 0;
+    batch->numops = 0;
+    batch->ops = libmsr_free(batch->ops);
+    status = csr_status_storage(batchnum);
+    status->err = libmsr_free(status->err);
+    status->failed = 0;
     return 0;
 }
 
@@ -240,14 +513,11 @@ int create_csr_batch_op(off_t csr, uint8_t bus, uint8_t device, uint8_t function
 
 int do_csr_batch_op(const int batchnum)
 {
-    static int batchfd = 0;
     struct csr_batch_array *batch = NULL;
-    int res;
+    struct csr_batch_status *status;
+    unsigned i;
+    int res, saved;
 
-    if (!batchfd)
-    {
-        batchfd = *csr_fd();
-    }
     if (csr_batch_storage(&batch, batchnum, NULL))
     {
         return -1;
@@ -260,27 +530,56 @@ int do_csr_batch_op(const int batchnum)
         libmsr_error_handler("do_csr_batch_op(): Using empty batch", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
         return -1;
     }
+    status = csr_status_storage(batchnum);
 
-    res = ioctl(batchfd, CSRSAFE_8086_BATCH, batch);
-    if (res < 0)
+    for (i = 0; i < batch->numops; i++)
     {
-        libmsr_error_handler("do_csr_batch_op(): IOctl failed, does /dev/cpu/csr_batch exist?", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
-        fprintf(stderr, "ioctl returned %d\n", res);
-        struct csr_batch_op *op;
-        int i = 0;
-        for (op = batch->ops; op < op + batch->numops; op++)
+        batch->ops[i].err = 0;
+    }
+    res = ioctl(*csr_fd(), CSRSAFE_8086_BATCH, batch);
+    saved = errno;
+    status->failed = 0;
+    for (i = 0; i < batch->numops; i++)
+    {
+        status->err[i] = batch->ops[i].err;
+        if (batch->ops[i].err)
         {
-            i++;
-            if (i >= batch->numops)
-            {
-                break;
-            }
-            if (op->err)
-            {
-                fprintf(stderr, "CSR %x, b%dd%df%ds%d, ERR %d\n", op->offset, op->bus, op->device, op->function, op->socket, op->err);
-            }
+            status->failed++;
+#ifdef CSRDEBUG
+            fprintf(stderr, "CSR %x, b%dd%df%ds%d, ERR %d\n", batch->ops[i].offset, batch->ops[i].bus, batch->ops[i].device, batch->ops[i].function, batch->ops[i].socket, batch->ops[i].err);
+#endif
         }
     }
-    /// @todo Debug stuff here.
-    return 0;
+    if (res < 0 && status->failed == 0)
+    {
+        /* The batch did not run at all, so every operation failed. */
+        for (i = 0; i < batch->numops; i++)
+        {
+            status->err[i] = -saved;
+        }
+        status->failed = batch->numops;
+        if (!status->reported)
+        {
+            libmsr_error_handler("do_csr_batch_op(): IOctl failed, does /dev/cpu/csr_safe exist?", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+            status->reported = 1;
+        }
+        return -1;
+    }
+    status->reported = 0;
+    return status->failed;
+}
+
+int csr_batch_errors(const int batchnum, const int **errs)
+{
+    struct csr_batch_status *status = csr_status_storage(batchnum);
+
+    if (status->err == NULL)
+    {
+        return -1;
+    }
+    if (errs != NULL)
+    {
+        *errs = status->err;
+    }
+    return status->failed;
 }
@@ -0,0 +1,211 @@
+/* csr_ha.c
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "csr_core.h"
+#include "csr_ha.h"
+#include "msr_core.h"
+#include "memhdlr.h"
+#include "cpuid.h"
+#include "libmsr_error.h"
+#include "libmsr_debug.h"
+
+/* HA_PCI_PMON_CTL enable and reset bits. */
+#define HA_CTL_EN (1UL << 22)
+#define HA_CTL_RST (1UL << 17)
+
+int ha_storage(struct ha_data **data)
+{
+    static const unsigned dids[HA_NUM_UNITS] = HA_UNIT_DIDS;
+    static const unsigned devs[HA_NUM_UNITS] = HA_UNIT_DEVS;
+    static const unsigned funcs[HA_NUM_UNITS] = HA_UNIT_FUNCS;
+    static const off_t ctrs[HA_NUM_CTRS] = {CSR_HA_PMONCTR0, CSR_HA_PMONCTR1, CSR_HA_PMONCTR2, CSR_HA_PMONCTR3};
+    static const off_t cfgs[HA_NUM_CTRS] = {CSR_HA_PMONCTRCFG0, CSR_HA_PMONCTRCFG1, CSR_HA_PMONCTRCFG2, CSR_HA_PMONCTRCFG3};
+    static struct ha_data d;
+    static int init = 0;
+    struct csr_pci_unit *u;
+    unsigned i, j;
+
+    if (!init)
+    {
+        d.num_units = csr_pci_units(dids, devs, funcs, HA_NUM_UNITS, num_sockets(), &d.units);
+        if (d.num_units == 0)
+        {
+            libmsr_error_handler("ha_storage(): No Home Agents found", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+            return -1;
+        }
+        d.num_sockets = d.units[d.num_units - 1].socket + 1;
+        d.stats = (struct ha_socket_stats *) libmsr_calloc(d.num_sockets, sizeof(struct ha_socket_stats));
+        allocate_csr_batch(CSR_HA_CTRS, HA_NUM_CTRS * d.num_units);
+        allocate_csr_batch(CSR_HA_EVTS, HA_NUM_CTRS * d.num_units);
+        for (j = 0; j < HA_NUM_CTRS; j++)
+        {
+            d.ctr[j] = (uint64_t **) libmsr_calloc(d.num_units, sizeof(uint64_t *));
+            d.cfg[j] = (uint64_t **) libmsr_calloc(d.num_units, sizeof(uint64_t *));
+            d.old[j] = (uint64_t *) libmsr_calloc(d.num_units, sizeof(uint64_t));
+            for (i = 0; i < d.num_units; i++)
+            {
+                u = &d.units[i];
+                create_csr_batch_op(ctrs[j], CSR_UNCORE_BUS, u->device, u->function, u->socket, 1, 8, &d.ctr[j][i], CSR_HA_CTRS);
+                create_csr_batch_op(cfgs[j], CSR_UNCORE_BUS, u->device, u->function, u->socket, 0, 4, &d.cfg[j][i], CSR_HA_EVTS);
+            }
+        }
+        init = 1;
+    }
+    if (data != NULL)
+    {
+        *data = &d;
+    }
+    return 0;
+}
+
+int enable_ha(void)
+{
+    static const uint64_t setting[HA_NUM_CTRS] = {
+        [HA_CTR_LOCAL] = HA_EVT_REQUESTS | ((HA_UMASK_REQUESTS_READS_LOCAL | HA_UMASK_REQUESTS_WRITES_LOCAL) << 8),
+        [HA_CTR_REMOTE] = HA_EVT_REQUESTS | ((HA_UMASK_REQUESTS_READS_REMOTE | HA_UMASK_REQUESTS_WRITES_REMOTE) << 8),
+        [HA_CTR_DIRECTORY] = HA_EVT_DIRECTORY_LOOKUP | (HA_UMASK_DIRECTORY_LOOKUP_ALL << 8),
+        [HA_CTR_SNOOP] = HA_EVT_SNOOP_RESP | (HA_UMASK_SNOOP_RESP_ALL << 8),
+    };
+    struct ha_data *d = NULL;
+    unsigned i, j;
+
+    if (ha_storage(&d))
+    {
+        return -1;
+    }
+    for (j = 0; j < HA_NUM_CTRS; j++)
+    {
+        for (i = 0; i < d->num_units; i++)
+        {
+            *d->cfg[j][i] = HA_CTL_EN | HA_CTL_RST | setting[j];
+        }
+    }
+    if (do_csr_batch_op(CSR_HA_EVTS) || do_csr_batch_op(CSR_HA_CTRS))
+    {
+        return -1;
+    }
+    d->timestamp = monotonic_time();
+    d->elapsed = 0.0;
+    for (j = 0; j < HA_NUM_CTRS; j++)
+    {
+        for (i = 0; i < d->num_units; i++)
+        {
+            d->old[j][i] = *d->ctr[j][i];
+        }
+    }
+    return 0;
+}
+
+int poll_ha_data(void)
+{
+    struct ha_data *d = NULL;
+    struct ha_socket_stats *st;
+    uint64_t requests;
+    double before, ts;
+    unsigned i, j, s;
+
+    if (ha_storage(&d))
+    {
+        return -1;
+    }
+    before = monotonic_time();
+    if (do_csr_batch_op(CSR_HA_CTRS))
+    {
+        return -1;
+    }
+    ts = (before + monotonic_time()) / 2.0;
+    d->elapsed = ts - d->timestamp;
+    d->timestamp = ts;
+
+    for (s = 0; s < d->num_sockets; s++)
+    {
+        for (j = 0; j < HA_NUM_CTRS; j++)
+        {
+            d->stats[s].delta[j] = 0;
+        }
+    }
+    for (i = 0; i < d->num_units; i++)
+    {
+        st = &d->stats[d->units[i].socket];
+        for (j = 0; j < HA_NUM_CTRS; j++)
+        {
+            st->delta[j] += ctr_wrap_delta(*d->ctr[j][i], d->old[j][i], HA_CTR_WIDTH);
+            d->old[j][i] = *d->ctr[j][i];
+        }
+    }
+    for (s = 0; s < d->num_sockets; s++)
+    {
+        st = &d->stats[s];
+        requests = st->delta[HA_CTR_LOCAL] + st->delta[HA_CTR_REMOTE];
+        st->remote_pct = (requests ? 100.0 * st->delta[HA_CTR_REMOTE] / requests : 0.0);
+        if (d->elapsed > 0.0)
+        {
+            st->local_bytes_per_sec = (double)st->delta[HA_CTR_LOCAL] * HA_BYTES_PER_REQUEST / d->elapsed;
+            st->remote_bytes_per_sec = (double)st->delta[HA_CTR_REMOTE] * HA_BYTES_PER_REQUEST / d->elapsed;
+            st->dir_lookups_per_sec = st->delta[HA_CTR_DIRECTORY] / d->elapsed;
+            st->snoop_resp_per_sec = st->delta[HA_CTR_SNOOP] / d->elapsed;
+        }
+        else
+        {
+            st->local_bytes_per_sec = st->remote_bytes_per_sec = 0.0;
+            st->dir_lookups_per_sec = st->snoop_resp_per_sec = 0.0;
+        }
+    }
+    return 0;
+}
+
+void dump_ha_data_label(FILE *writedest)
+{
+    fprintf(writedest, "socket local_Bps remote_Bps remote_pct dir_lookups_ps snoop_resp_ps\n");
+}
+
+void dump_ha_data(FILE *writedest)
+{
+    struct ha_data *d = NULL;
+    struct ha_socket_stats *st;
+    unsigned s;
+
+    if (ha_storage(&d))
+    {
+        return;
+    }
+    for (s = 0; s < d->num_sockets; s++)
+    {
+        st = &d->stats[s];
+        fprintf(writedest, "%u %.0lf %.0lf %.2lf %.0lf %.0lf\n", s, st->local_bytes_per_sec, st->remote_bytes_per_sec, st->remote_pct, st->dir_lookups_per_sec, st->snoop_resp_per_sec);
+    }
+}
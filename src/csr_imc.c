@@ -48,7 +48,126 @@
 #include "libmsr_debug.h"
 #include "libmsr_error.h"
 
-/// @brief Load batch operations for the integrated memory controller (iMC).
+/// @brief Build the iMC channel map from the shared uncore PCI device table.
+///
+/// @param [out] topo iMC channel map.
+///
+/// @return Number of channels found.
+static unsigned scan_imc_channels(struct imc_topology *topo)
+{
+    static const unsigned dids[2][4] = IMC_CHANNEL_DIDS;
+    struct csr_pci_dev *dev;
+    struct imc_channel *ch = NULL;
+    unsigned found = 0;
+    unsigned cap = 0;
+    unsigned sockets = 0;
+    unsigned s, m, c;
+    int any;
+
+    for (s = 0, any = 1; any; s++)
+    {
+        any = 0;
+        for (m = 0; m < IMC_NUM_CONTROLLERS; m++)
+        {
+            for (c = 0; c < 4; c++)
+            {
+                if (dids[m][c] == 0 || (dev = csr_pci_find(dids[m][c], s)) == NULL)
+                {
+                    continue;
+                }
+                if (found == cap)
+                {
+                    cap = (cap ? 2 * cap : NUMCTRS);
+                    ch = (struct imc_channel *) libmsr_realloc(ch, cap * sizeof(struct imc_channel));
+                }
+                ch[found].pci_bus = dev->bus;
+                ch[found].device = dev->device;
+                ch[found].function = dev->function;
+                ch[found].socket = s;
+                ch[found].imc = m;
+                ch[found].channel = c;
+                found++;
+                any = 1;
+            }
+        }
+        if (any)
+        {
+            sockets++;
+        }
+    }
+    topo->num_sockets = sockets;
+    topo->num_channels = found;
+    topo->channels = ch;
+    return found;
+}
+
+/// @brief Build the iMC channel map from the platform header defaults.
+///
+/// @param [out] topo iMC channel map covering every socket.
+static void default_imc_channels(struct imc_topology *topo)
+{
+    static const unsigned devs[2][4] = IMC_CHANNEL_DEVS;
+    static const unsigned funcs[4] = IMC_CHANNEL_FUNCS;
+    unsigned sockets = num_sockets();
+    unsigned s, m, c;
+    unsigned idx = 0;
+
+    topo->num_sockets = sockets;
+    topo->num_channels = sockets * IMC_NUM_CONTROLLERS * 4;
+    topo->channels = (struct imc_channel *) libmsr_calloc(topo->num_channels, sizeof(struct imc_channel));
+    for (s = 0; s < sockets; s++)
+    {
+        for (m = 0; m < IMC_NUM_CONTROLLERS; m++)
+        {
+            for (c = 0; c < 4; c++)
+            {
+                topo->channels[idx].pci_bus = CSR_UNCORE_BUS;
+                topo->channels[idx].device = devs[m][c];
+                topo->channels[idx].function = funcs[c];
+                topo->channels[idx].socket = s;
+                topo->channels[idx].imc = m;
+                topo->channels[idx].channel = c;
+                idx++;
+            }
+        }
+    }
+}
+
+struct imc_topology *imc_topology_storage(void)
+{
+    static struct imc_topology topo;
+    static int init = 0;
+    unsigned i, s;
+
+    if (!init)
+    {
+        topo.discovered = (scan_imc_channels(&topo) > 0);
+        if (!topo.discovered)
+        {
+            default_imc_channels(&topo);
+        }
+        topo.socket_first = (unsigned *) libmsr_calloc(topo.num_sockets + 1, sizeof(unsigned));
+        for (i = 0, s = 0; s <= topo.num_sockets; s++)
+        {
+            while (i < topo.num_channels && topo.channels[i].socket < s)
+            {
+                i++;
+            }
+            topo.socket_first[s] = i;
+        }
+#ifdef CSRDEBUG
+        for (i = 0; i < topo.num_channels; i++)
+        {
+            fprintf(stderr, "CSRDEBUG: iMC channel %u: bus %x dev %u func %u sock %u imc %u ch %u\n", i, topo.channels[i].pci_bus, topo.channels[i].device, topo.channels[i].function, topo.channels[i].socket, topo.channels[i].imc, topo.channels[i].channel);
+        }
+#endif
+        init = 1;
+    }
+    return &topo;
+}
+
+/// @brief Load batch operations for the integrated memory controller (iMC),
+/// one for each channel in the iMC channel map.
 ///
 /// @param [in] offt Address of uncore register to load.
 ///
@@ -63,38 +182,55 @@
 /// @return Number of csr batch operations created.
 static int load_imc_batch_for_each(const size_t offt, uint64_t **loc, const int isread, const size_t size, const unsigned batchno)
 {
-    int idx = 0;
+    struct imc_topology *topo = imc_topology_storage();
+    unsigned idx;
 
-    if (loc)
+    if (!loc)
     {
-        create_csr_batch_op(offt, 1, IMC0_DEV, IMC_CH0_FUNC, 0, isread, size, &loc[idx], batchno);
-        create_csr_batch_op(offt, 1, IMC0_DEV, IMC_CH1_FUNC, 0, isread, size, &loc[++idx], batchno);
-        create_csr_batch_op(offt, 1, IMC0_DEV, IMC_CH2_FUNC, 0, isread, size, &loc[++idx], batchno);
-        create_csr_batch_op(offt, 1, IMC0_DEV, IMC_CH3_FUNC, 0, isread, size, &loc[++idx], batchno);
+        libmsr_error_handler("load_imc_batch_for_each(): Unable to create iMC batch -- Loc was null", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return 0;
+    }
+    for (idx = 0; idx < topo->num_channels; idx++)
+    {
+        create_csr_batch_op(offt, CSR_UNCORE_BUS, topo->channels[idx].device, topo->channels[idx].function, topo->channels[idx].socket, isread, size, &loc[idx], batchno);
+    }
+    return idx;
+}
 
-        create_csr_batch_op(offt, 1, IMC1_DEV, IMC_CH0_FUNC, 0, isread, size, &loc[++idx], batchno);
-        create_csr_batch_op(offt, 1, IMC1_DEV, IMC_CH1_FUNC, 0, isread, size, &loc[++idx], batchno);
-        create_csr_batch_op(offt, 1, IMC1_DEV, IMC_CH2_FUNC, 0, isread, size, &loc[++idx], batchno);
-        create_csr_batch_op(offt, 1, IMC1_DEV, IMC_CH3_FUNC, 0, isread, size, &loc[++idx], batchno);
+/// @brief Structure holding the batch operations behind the flat iMC counter
+/// storage, indexed like struct pmonctrs_data (see IMC_CTR_IDX()).
+struct imc_ctr_ops {
+    /// @brief Counter reads of the fused CSR_IMC_CTRS batch.
+    uint64_t **ctr;
+    /// @brief Counter configuration writes of the CSR_IMC_EVTS batch.
+    uint64_t **cfg;
+    /// @brief Counter reads of the per-counter sub-batches, indexed by
+    /// counter, then channel.
+    uint64_t **sub[IMC_NUM_CTRS];
+};
+
+/// @brief Retrieve the batch operations behind the flat iMC counter storage.
+///
+/// @return Pointer to the iMC counter operations.
+static struct imc_ctr_ops *imc_ctr_ops_storage(void)
+{
+    static struct imc_ctr_ops ops;
+    static int init = 0;
+    unsigned n;
+    int i;
 
-        if (num_sockets() > 1)
+    if (!init)
+    {
+        n = imc_topology_storage()->num_channels;
+        ops.ctr = (uint64_t **) libmsr_calloc(n * IMC_NUM_CTRS, sizeof(uint64_t *));
+        ops.cfg = (uint64_t **) libmsr_calloc(n * IMC_NUM_CTRS, sizeof(uint64_t *));
+        for (i = 0; i < IMC_NUM_CTRS; i++)
         {
-            create_csr_batch_op(offt, 1, IMC0_DEV, IMC_CH0_FUNC, 1, isread, size, &loc[++idx], batchno);
-            create_csr_batch_op(offt, 1, IMC0_DEV, IMC_CH1_FUNC, 1, isread, size, &loc[++idx], batchno);
-            create_csr_batch_op(offt, 1, IMC0_DEV, IMC_CH2_FUNC, 1, isread, size, &loc[++idx], batchno);
-            create_csr_batch_op(offt, 1, IMC0_DEV, IMC_CH3_FUNC, 1, isread, size, &loc[++idx], batchno);
-
-            create_csr_batch_op(offt, 1, IMC1_DEV, IMC_CH0_FUNC, 1, isread, size, &loc[++idx], batchno);
-            create_csr_batch_op(offt, 1, IMC1_DEV, IMC_CH1_FUNC, 1, isread, size, &loc[++idx], batchno);
-            create_csr_batch_op(offt, 1, IMC1_DEV, IMC_CH2_FUNC, 1, isread, size, &loc[++idx], batchno);
-            create_csr_batch_op(offt, 1, IMC1_DEV, IMC_CH3_FUNC, 1, isread, size, &loc[++idx], batchno);
+            ops.sub[i] = (uint64_t **) libmsr_calloc(n, sizeof(uint64_t *));
         }
+        init = 1;
     }
-    else
-    {
-        libmsr_error_handler("load_imc_batch_for_each(): Unable to create iMC batch -- Loc was null", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
-    }
-    return idx;
+    return &ops;
 }
 
 struct pmonctrs_data *pmon_ctr_storage(void)
@@ -104,23 +240,42 @@ struct pmonctrs_data *pmon_ctr_storage(void)
 
     if (!init)
     {
-        int allocated = NUMCTRS * num_sockets();
-        pcd.ctr0 = (uint64_t **) libmsr_calloc(allocated, sizeof(uint64_t *));
-        pcd.ctr1 = (uint64_t **) libmsr_calloc(allocated, sizeof(uint64_t *));
-        pcd.ctr2 = (uint64_t **) libmsr_calloc(allocated, sizeof(uint64_t *));
-        pcd.ctr3 = (uint64_t **) libmsr_calloc(allocated, sizeof(uint64_t *));
-        pcd.ctr4 = (uint64_t **) libmsr_calloc(allocated, sizeof(uint64_t *));
-        // config
-        pcd.ctrcfg0 = (uint64_t **) libmsr_calloc(allocated, sizeof(uint64_t *));
-        pcd.ctrcfg1 = (uint64_t **) libmsr_calloc(allocated, sizeof(uint64_t *));
-        pcd.ctrcfg2 = (uint64_t **) libmsr_calloc(allocated, sizeof(uint64_t *));
-        pcd.ctrcfg3 = (uint64_t **) libmsr_calloc(allocated, sizeof(uint64_t *));
-        pcd.ctrcfg4 = (uint64_t **) libmsr_calloc(allocated, sizeof(uint64_t *));
+        pcd.num_channels = imc_topology_storage()->num_channels;
+        pcd.value = (uint64_t *) libmsr_calloc(pcd.num_channels * IMC_NUM_CTRS, sizeof(uint64_t));
+        pcd.config = (uint64_t *) libmsr_calloc(pcd.num_channels * IMC_NUM_CTRS, sizeof(uint64_t));
         init = 1;
     }
     return &pcd;
 }
 
+/// @brief Locate a counter in the flat iMC counter storage.
+///
+/// @return Flat index of the counter, else -1 if it does not exist.
+static long imc_ctr_locate(const unsigned socket, const unsigned channel, const unsigned counter)
+{
+    struct imc_topology *topo = imc_topology_storage();
+
+    if (socket >= topo->num_sockets || counter >= IMC_NUM_CTRS || channel >= topo->socket_first[socket + 1] - topo->socket_first[socket])
+    {
+        return -1;
+    }
+    return IMC_CTR_IDX(topo->socket_first[socket] + channel, counter);
+}
+
+uint64_t *imc_ctr_value(const unsigned socket, const unsigned channel, const unsigned counter)
+{
+    long idx = imc_ctr_locate(socket, channel, counter);
+
+    return (idx < 0 ? NULL : &pmon_ctr_storage()->value[idx]);
+}
+
+uint64_t *imc_ctr_config(const unsigned socket, const unsigned channel, const unsigned counter)
+{
+    long idx = imc_ctr_locate(socket, channel, counter);
+
+    return (idx < 0 ? NULL : &pmon_ctr_storage()->config[idx]);
+}
+
 struct pmonctr_global *pmonctr_global_storage(void)
 {
     static struct pmonctr_global pgd;
@@ -128,7 +283,7 @@ struct pmonctr_global *pmonctr_global_storage(void)
 
     if (!init)
     {
-        int allocated = NUMCTRS * num_sockets();
+        int allocated = imc_topology_storage()->num_channels;
         pgd.unitctrl = (uint64_t **) libmsr_calloc(allocated, sizeof(uint64_t *));
         pgd.unitstatus = (uint64_t **) libmsr_calloc(allocated, sizeof(uint64_t *));
         init = 1;
@@ -136,33 +291,91 @@ struct pmonctr_global *pmonctr_global_storage(void)
     return &pgd;
 };
 
-/// @todo Combine into 1 counter batch and 1 event batch.
-int init_pmon_ctrs(void)
+struct fixed_perfmon_data *fixed_perfmon_storage(void)
 {
+    static struct fixed_perfmon_data fpd;
     static int init = 0;
-    static int allocated = 0;
-    static struct pmonctrs_data *pmonctrs;
+    struct pmonctrs_data *pcd;
+    unsigned i;
 
     if (!init)
     {
+        pcd = pmon_ctr_storage();
+        fpd.fctr = (uint64_t **) libmsr_calloc(pcd->num_channels, sizeof(uint64_t *));
+        fpd.fctrcfg = (uint64_t **) libmsr_calloc(pcd->num_channels, sizeof(uint64_t *));
+        for (i = 0; i < pcd->num_channels; i++)
+        {
+            fpd.fctr[i] = &pcd->value[IMC_CTR_IDX(i, IMC_FIXED_CTR)];
+            fpd.fctrcfg[i] = &pcd->config[IMC_CTR_IDX(i, IMC_FIXED_CTR)];
+        }
         init = 1;
-        allocated = NUMCTRS * num_sockets();
-        pmonctrs = pmon_ctr_storage();
+    }
+    return &fpd;
+}
+
+/// @brief Copy the fused counter batch into the flat counter storage.
+static void imc_scatter_ctrs(void)
+{
+    struct pmonctrs_data *pcd = pmon_ctr_storage();
+    uint64_t **ctr = imc_ctr_ops_storage()->ctr;
+    unsigned k;
+
+    for (k = 0; k < pcd->num_channels * IMC_NUM_CTRS; k++)
+    {
+        pcd->value[k] = *ctr[k];
+    }
+}
 
-        allocate_csr_batch(CSR_IMC_CTRS, allocated * 4);
-        allocate_csr_batch(CSR_IMC_EVTS, allocated * 4);
+/// @brief Read every iMC counter of every channel with the fused batch.
+///
+/// @return Result of do_csr_batch_op().
+static int read_imc_ctrs(void)
+{
+    int res = do_csr_batch_op(CSR_IMC_CTRS);
 
-        load_imc_batch_for_each(CSR_PMONCTR0, pmonctrs->ctr0, 1, 8, CSR_IMC_CTRS);
-        load_imc_batch_for_each(CSR_PMONCTR1, pmonctrs->ctr1, 1, 8, CSR_IMC_CTRS);
-        load_imc_batch_for_each(CSR_PMONCTR2, pmonctrs->ctr2, 1, 8, CSR_IMC_CTRS);
-        load_imc_batch_for_each(CSR_PMONCTR3, pmonctrs->ctr3, 1, 8, CSR_IMC_CTRS);
+    if (res >= 0)
+    {
+        imc_scatter_ctrs();
+    }
+    return res;
+}
 
-        load_imc_batch_for_each(CSR_PMONCTRCFG0, pmonctrs->ctrcfg0, 0, 4, CSR_IMC_EVTS);
-        load_imc_batch_for_each(CSR_PMONCTRCFG1, pmonctrs->ctrcfg1, 0, 4, CSR_IMC_EVTS);
-        load_imc_batch_for_each(CSR_PMONCTRCFG2, pmonctrs->ctrcfg2, 0, 4, CSR_IMC_EVTS);
-        load_imc_batch_for_each(CSR_PMONCTRCFG3, pmonctrs->ctrcfg3, 0, 4, CSR_IMC_EVTS);
+int init_pmon_ctrs(void)
+{
+    static const off_t ctrs[IMC_NUM_CTRS] = {CSR_PMONCTR0, CSR_PMONCTR1, CSR_PMONCTR2, CSR_PMONCTR3, CSR_PMONFIXEDCTR};
+    static const off_t cfgs[IMC_NUM_CTRS] = {CSR_PMONCTRCFG0, CSR_PMONCTRCFG1, CSR_PMONCTRCFG2, CSR_PMONCTRCFG3, CSR_PMONFIXEDCTL};
+    static const int subbatch[IMC_NUM_CTRS] = {CSR_IMC_CTR0, CSR_IMC_CTR1, CSR_IMC_CTR2, CSR_IMC_CTR3, CSR_IMC_FIXED_CTR};
+    static int init = 0;
+    struct imc_topology *topo;
+    struct imc_ctr_ops *ops;
+    struct imc_channel *ch;
+    unsigned i, j;
 
-        return 10 * allocated;
+    if (!init)
+    {
+        init = 1;
+        topo = imc_topology_storage();
+        ops = imc_ctr_ops_storage();
+        pmon_ctr_storage();
+
+        allocate_csr_batch(CSR_IMC_CTRS, topo->num_channels * IMC_NUM_CTRS);
+        allocate_csr_batch(CSR_IMC_EVTS, topo->num_channels * IMC_NUM_CTRS);
+        /* Channel-major order, so the fused batch matches the flat storage. */
+        for (i = 0; i < topo->num_channels; i++)
+        {
+            ch = &topo->channels[i];
+            for (j = 0; j < IMC_NUM_CTRS; j++)
+            {
+                create_csr_batch_op(ctrs[j], CSR_UNCORE_BUS, ch->device, ch->function, ch->socket, 1, 8, &ops->ctr[IMC_CTR_IDX(i, j)], CSR_IMC_CTRS);
+                create_csr_batch_op(cfgs[j], CSR_UNCORE_BUS, ch->device, ch->function, ch->socket, 0, 4, &ops->cfg[IMC_CTR_IDX(i, j)], CSR_IMC_EVTS);
+            }
+        }
+        for (j = 0; j < IMC_NUM_CTRS; j++)
+        {
+            allocate_csr_batch(subbatch[j], topo->num_channels);
+            load_imc_batch_for_each(ctrs[j], ops->sub[j], 1, 8, subbatch[j]);
+        }
+        return 3 * IMC_NUM_CTRS * topo->num_channels;
     }
     return -1;
 }
@@ -176,7 +389,7 @@ int init_pmonctr_global(void)
     if (!init)
     {
         init = 1;
-        allocated = NUMCTRS * num_sockets();
+        allocated = imc_topology_storage()->num_channels;
         pgd = pmonctr_global_storage();
         allocate_csr_batch(CSR_IMC_PMONUNITCTRL, allocated);
         allocate_csr_batch(CSR_IMC_PMONUNITSTAT, allocated);
@@ -189,68 +402,74 @@ int init_pmonctr_global(void)
     return -1;
 }
 
-/// @brief Set iMC performance monitoring configuration.
+/// @brief Set one iMC counter configuration on every channel.
 ///
-/// @param [in] setting Raw bits to set for configuration.
+/// @param [in] counter Unique counter identifier.
 ///
-/// @param [out] cfg Pointer to raw configuration value.
+/// @param [in] setting Raw bits to set for configuration.
+static void set_pmon_config(const unsigned counter, const uint32_t setting)
+{
+    struct pmonctrs_data *pcd = pmon_ctr_storage();
+    unsigned i;
+
+    for (i = 0; i < pcd->num_channels; i++)
+    {
+        pcd->config[IMC_CTR_IDX(i, counter)] = setting;
+    }
+}
+
+/// @brief Write the flat counter configurations of every channel with one
+/// CSR_IMC_EVTS batch.
 ///
-/// @return 0 if successful, else -1 if iMC PMON config is uninitialized.
-static int set_pmon_config(const uint32_t setting, uint64_t **cfg)
+/// @return 0 if successful, else -1 if iMC PMON config is uninitialized or
+/// do_csr_batch_op() fails.
+static int write_pmon_config(void)
 {
-    int i;
+    struct pmonctrs_data *pcd = pmon_ctr_storage();
+    uint64_t **cfg = imc_ctr_ops_storage()->cfg;
+    unsigned k;
 
-    if (!*cfg)
+    if (pcd->num_channels == 0 || cfg[0] == NULL)
     {
-        libmsr_error_handler("set_pmon_config(): iMC PMON config is not initialized", LIBMSR_ERROR_CSR_INIT, getenv("HOSTNAME"), __FILE__, __LINE__);
+        libmsr_error_handler("write_pmon_config(): iMC PMON config is not initialized", LIBMSR_ERROR_CSR_INIT, getenv("HOSTNAME"), __FILE__, __LINE__);
         return -1;
     }
-    for (i = 0; i < NUMCTRS * num_sockets(); i++)
+    for (k = 0; k < pcd->num_channels * IMC_NUM_CTRS; k++)
     {
-        *cfg[i] = setting;
+        *cfg[k] = pcd->config[k];
     }
-    return 0;
+    return (do_csr_batch_op(CSR_IMC_EVTS) ? -1 : 0);
 }
 
-int pmon_config(uint32_t threshold, uint32_t ovf_en, uint32_t edge_det, uint32_t umask, uint8_t event, const unsigned counter)
+/// @brief Encode an iMC counter configuration.
+///
+/// @return Raw bits of the counter configuration register.
+static uint32_t pmon_setting(uint32_t threshold, uint32_t ovf_en, uint32_t edge_det, uint32_t umask, uint8_t event)
 {
-    struct pmonctrs_data *pcd = pmon_ctr_storage();
-    int ret0 = 0;
-    int ret1 = 0;
-
     ovf_en &= 0x1;
     edge_det &= 0x1;
-    uint32_t setting = 0x0 | (threshold << 24) | (0x1 << 22) | (ovf_en << 20) | (edge_det << 18) | (0x1 << 17) | (0x1 << 16) | (umask << 8) | event;
+    return 0x0 | (threshold << 24) | (0x1 << 22) | (ovf_en << 20) | (edge_det << 18) | (0x1 << 17) | (0x1 << 16) | (umask << 8) | event;
+}
+
+int pmon_config(uint32_t threshold, uint32_t ovf_en, uint32_t edge_det, uint32_t umask, uint8_t event, const unsigned counter)
+{
+    uint32_t setting = pmon_setting(threshold, ovf_en, edge_det, umask, event);
+
+    if (counter >= IMC_NUM_CTRS)
+    {
+        libmsr_error_handler("pmon_config(): iMC perfmon counter does not exist", LIBMSR_ERROR_CSR_COUNTERS, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    if (counter == IMC_FIXED_CTR)
+    {
+        /* The fixed counter always counts DRAM clocks. */
+        setting = IMC_FIXED_CTL_EN | (ovf_en ? IMC_FIXED_CTL_OVF_EN : 0);
+    }
 #ifdef CSRDEBUG
     fprintf(stderr, "CSRDEBUG: counter %u setting %x\n", counter, setting);
 #endif
-    switch (counter)
-    {
-        case 0:
-            ret0 = set_pmon_config(setting, pcd->ctrcfg0);
-            ret1 = do_csr_batch_op(CSR_IMC_EVTS);
-            break;
-        case 1:
-            ret0 = set_pmon_config(setting, pcd->ctrcfg1);
-            ret1 = do_csr_batch_op(CSR_IMC_EVTS);
-            break;
-        case 2:
-            ret0 = set_pmon_config(setting, pcd->ctrcfg2);
-            ret1 = do_csr_batch_op(CSR_IMC_EVTS);
-            break;
-        case 3:
-            ret0 = set_pmon_config(setting, pcd->ctrcfg3);
-            ret1 = do_csr_batch_op(CSR_IMC_EVTS);
-            break;
-        case 4:
-            ret0 = set_pmon_config(setting, pcd->ctrcfg4);
-            ret1 = do_csr_batch_op(CSR_IMC_EVTS);
-            break;
-        default:
-            libmsr_error_handler("pmon_config(): iMC perfmon counter does not exist", LIBMSR_ERROR_CSR_COUNTERS, getenv("HOSTNAME"), __FILE__, __LINE__);
-            return -1;
-    }
-    return ret0 | ret1;
+    set_pmon_config(counter, setting);
+    return write_pmon_config();
 }
 
 int set_pmon_unit_ctrl(uint32_t ovf_en, uint16_t freeze_en, uint16_t freeze, uint16_t reset, uint8_t reset_cfg)
@@ -259,7 +478,7 @@ int set_pmon_unit_ctrl(uint32_t ovf_en, uint16_t freeze_en, uint16_t freeze, uin
     uint32_t setting = 0x0 | (ovf_en << 17) | (freeze_en << 16) | (freeze << 8) | (reset << 1) | reset_cfg;
     int i;
 
-    for (i = 0; i < NUMCTRS * num_sockets(); i++)
+    for (i = 0; i < imc_topology_storage()->num_channels; i++)
     {
         *pgd->unitctrl[i] = setting;
     }
@@ -270,7 +489,7 @@ int mem_bw_on_ctr(const unsigned counter, const int type)
 {
     int res = 0;
 
-    if (counter > 4)
+    if (counter >= IMC_FIXED_CTR)
     {
         libmsr_error_handler("mem_bw_on_ctr(): iMC pmon counter does not exist", LIBMSR_ERROR_CSR_COUNTERS, getenv("HOSTNAME"), __FILE__, __LINE__);
         return -1;
@@ -297,7 +516,7 @@ int mem_pct_rw_on_ctr(const unsigned rcounter, const unsigned wcounter)
 {
     int res = 0;
 
-    if (rcounter > 4 || wcounter > 4)
+    if (rcounter >= IMC_FIXED_CTR || wcounter >= IMC_FIXED_CTR)
     {
         libmsr_error_handler("mem_pct_rw_on_ctr(): iMC pmon counter does not exist", LIBMSR_ERROR_CSR_COUNTERS, getenv("HOSTNAME"), __FILE__, __LINE__);
         return -1;
@@ -315,7 +534,7 @@ int mem_page_empty_on_ctr(const unsigned act_count, const unsigned pre_count, co
 {
     int res = 0;
 
-    if (act_count > 4 || pre_count > 4 || cas_count > 4)
+    if (act_count >= IMC_FIXED_CTR || pre_count >= IMC_FIXED_CTR || cas_count >= IMC_FIXED_CTR)
     {
         libmsr_error_handler("mem_page_empty_on_ctr(): there are only 4 iMC performance counters", LIBMSR_ERROR_CSR_COUNTERS, getenv("HOSTNAME"), __FILE__, __LINE__);
         return -1;
@@ -334,7 +553,7 @@ int mem_page_miss_on_ctr(const unsigned pre_count, const unsigned cas_count)
 {
     int res = 0;
 
-    if (pre_count > 4 || pre_count > 4)
+    if (pre_count >= IMC_FIXED_CTR || cas_count >= IMC_FIXED_CTR)
     {
         libmsr_error_handler("mem_page_miss_on_ctr(): iMC PMON counter does not exist", LIBMSR_ERROR_CSR_COUNTERS, getenv("HOSTNAME"), __FILE__, __LINE__);
         return -1;
@@ -350,320 +569,396 @@ int mem_page_miss_on_ctr(const unsigned pre_count, const unsigned cas_count)
 
 int read_imc_counter_batch(const unsigned counter)
 {
-    int res = 0;
+    static const int subbatch[IMC_NUM_CTRS] = {CSR_IMC_CTR0, CSR_IMC_CTR1, CSR_IMC_CTR2, CSR_IMC_CTR3, CSR_IMC_FIXED_CTR};
+    struct pmonctrs_data *pcd = pmon_ctr_storage();
+    uint64_t **sub;
+    unsigned i;
+    int res;
 
-    switch (counter)
+    if (counter >= IMC_NUM_CTRS)
     {
-        case 0:
-            res = do_csr_batch_op(CSR_IMC_CTRS);
-            break;
-        case 1:
-            res = do_csr_batch_op(CSR_IMC_CTRS);
-            break;
-        case 2:
-            res = do_csr_batch_op(CSR_IMC_CTRS);
-            break;
-        case 3:
-            res = do_csr_batch_op(CSR_IMC_CTRS);
-            break;
-        case 4:
-            res = do_csr_batch_op(CSR_IMC_CTRS);
-            break;
-        default:
-            libmsr_error_handler("read_imc_counter_batch(): iMC PMON counter does not exist", LIBMSR_ERROR_CSR_COUNTERS, getenv("HOSTNAME"), __FILE__, __LINE__);
-            return -1;
-            break;
+        libmsr_error_handler("read_imc_counter_batch(): iMC PMON counter does not exist", LIBMSR_ERROR_CSR_COUNTERS, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    res = do_csr_batch_op(subbatch[counter]);
+    sub = imc_ctr_ops_storage()->sub[counter];
+    for (i = 0; i < pcd->num_channels; i++)
+    {
+        pcd->value[IMC_CTR_IDX(i, counter)] = *sub[i];
     }
     return res;
 }
 
-int print_mem_bw_from_ctr(const unsigned counter, FILE *writedest)
+int read_imc_counters(const unsigned mask)
 {
-    struct pmonctrs_data *pcd = pmon_ctr_storage();
-    uint64_t **ctr = NULL;
-    uint8_t devctr = 0;
-    uint8_t func = 0;
-    uint8_t sockctr = 0;
-    int i;
-    const uint8_t funcnums[4] = {IMC_CH0_FUNC, IMC_CH1_FUNC, IMC_CH2_FUNC, IMC_CH3_FUNC};
-    const uint8_t devnums[2] = {IMC0_DEV, IMC1_DEV};
+    unsigned counter = 0;
 
-    read_imc_counter_batch(counter);
-    switch (counter)
+    if (mask == 0 || mask >= (1U << IMC_NUM_CTRS))
     {
-        case 0:
-            ctr = pcd->ctr0;
-            break;
-        case 1:
-            ctr = pcd->ctr1;
-            break;
-        case 2:
-            ctr = pcd->ctr2;
-            break;
-        case 3:
-            ctr = pcd->ctr3;
-            break;
-        case 4:
-            ctr = pcd->ctr4;
-            break;
+        libmsr_error_handler("read_imc_counters(): iMC PMON counter does not exist", LIBMSR_ERROR_CSR_COUNTERS, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
     }
+    if ((mask & (mask - 1)) == 0)
+    {
+        while (!(mask & (1U << counter)))
+        {
+            counter++;
+        }
+        return read_imc_counter_batch(counter);
+    }
+    return read_imc_ctrs();
+}
 
-    fprintf(writedest, "Memory Bandwidth\n");
-    for (i = 0; i < NUMCTRS * num_sockets(); i++)
+/// @brief Structure holding the operations of the iMC snapshot batches.
+struct imc_snapshot_ops {
+    /// @brief Unit control writes that freeze each channel.
+    uint64_t **freeze;
+    /// @brief Unit control writes that unfreeze each channel.
+    uint64_t **unfreeze;
+    /// @brief Counter reads of the freeze batch (see IMC_CTR_IDX()).
+    uint64_t **frozen;
+    /// @brief Counter reads of the no-freeze batch (see IMC_CTR_IDX()).
+    uint64_t **running;
+    /// @brief Second read of the first channel's DRAM clock counter.
+    uint64_t *dclk_end;
+};
+
+/// @brief Retrieve the operations of the iMC snapshot batches.
+///
+/// @return Pointer to the snapshot operations.
+static struct imc_snapshot_ops *imc_snapshot_ops_storage(void)
+{
+    static struct imc_snapshot_ops ops;
+
+    return &ops;
+}
+
+int imc_snapshot_storage(struct imc_snapshot **data)
+{
+    /* Read the fixed DRAM clock counter first, so that the no-freeze batch
+     * starts and ends with the same register. */
+    static const unsigned order[IMC_NUM_CTRS] = {IMC_FIXED_CTR, 0, 1, 2, 3};
+    static const off_t ctrs[IMC_NUM_CTRS] = {CSR_PMONCTR0, CSR_PMONCTR1, CSR_PMONCTR2, CSR_PMONCTR3, CSR_PMONFIXEDCTR};
+    static struct imc_snapshot d;
+    static int init = 0;
+    struct imc_snapshot_ops *ops = imc_snapshot_ops_storage();
+    struct imc_topology *topo;
+    struct imc_channel *ch;
+    unsigned i, j, k;
+
+    if (!init)
     {
-        if (i > 0 && i%4 == 0)
+        topo = imc_topology_storage();
+        if (topo->num_channels == 0)
+        {
+            libmsr_error_handler("imc_snapshot_storage(): No iMC channels found", LIBMSR_ERROR_CSR_INIT, getenv("HOSTNAME"), __FILE__, __LINE__);
+            return -1;
+        }
+        d.num_channels = topo->num_channels;
+        ops->freeze = (uint64_t **) libmsr_calloc(d.num_channels, sizeof(uint64_t *));
+        ops->unfreeze = (uint64_t **) libmsr_calloc(d.num_channels, sizeof(uint64_t *));
+        d.value = (uint64_t *) libmsr_calloc(d.num_channels * IMC_NUM_CTRS, sizeof(uint64_t));
+        ops->frozen = (uint64_t **) libmsr_calloc(d.num_channels * IMC_NUM_CTRS, sizeof(uint64_t *));
+        ops->running = (uint64_t **) libmsr_calloc(d.num_channels * IMC_NUM_CTRS, sizeof(uint64_t *));
+        allocate_csr_batch(CSR_IMC_SNAPSHOT, (IMC_NUM_CTRS + 2) * d.num_channels);
+        allocate_csr_batch(CSR_IMC_SNAPSHOT_NOFREEZE, IMC_NUM_CTRS * d.num_channels + 1);
+
+        load_imc_batch_for_each(CSR_PMONUNITCTRL, ops->freeze, 0, 4, CSR_IMC_SNAPSHOT);
+        for (i = 0; i < d.num_channels; i++)
         {
-            devctr++;
+            ch = &topo->channels[i];
+            for (k = 0; k < IMC_NUM_CTRS; k++)
+            {
+                j = order[k];
+                create_csr_batch_op(ctrs[j], CSR_UNCORE_BUS, ch->device, ch->function, ch->socket, 1, 8, &ops->frozen[IMC_CTR_IDX(i, j)], CSR_IMC_SNAPSHOT);
+                create_csr_batch_op(ctrs[j], CSR_UNCORE_BUS, ch->device, ch->function, ch->socket, 1, 8, &ops->running[IMC_CTR_IDX(i, j)], CSR_IMC_SNAPSHOT_NOFREEZE);
+            }
         }
-        devctr %= 2;
-        func %= 4;
-        if (i > 0 && i%8 == 0)
+        load_imc_batch_for_each(CSR_PMONUNITCTRL, ops->unfreeze, 0, 4, CSR_IMC_SNAPSHOT);
+        ch = &topo->channels[0];
+        create_csr_batch_op(CSR_PMONFIXEDCTR, CSR_UNCORE_BUS, ch->device, ch->function, ch->socket, 1, 8, &ops->dclk_end, CSR_IMC_SNAPSHOT_NOFREEZE);
+
+        for (i = 0; i < d.num_channels; i++)
         {
-            sockctr++;
+            *ops->freeze[i] = IMC_UNIT_CTL_FRZ_EN | IMC_UNIT_CTL_FRZ;
+            *ops->unfreeze[i] = IMC_UNIT_CTL_FRZ_EN;
         }
-        fprintf(writedest, "dev %d func %d sock %d: ", devnums[devctr], funcnums[func], sockctr);
-        fprintf(writedest, "%lu bytes\n", *ctr[i] * 64LU);
-        func++;
+        init = 1;
+    }
+    if (data != NULL)
+    {
+        *data = &d;
     }
     return 0;
 }
 
-int print_mem_pct_rw_from_ctr(const unsigned rcounter, const unsigned wcounter, int type, FILE *writedest)
+int read_imc_snapshot(const int mode)
 {
+    struct imc_snapshot_ops *ops = imc_snapshot_ops_storage();
     struct pmonctrs_data *pcd = pmon_ctr_storage();
-    uint64_t **rctr = NULL;
-    uint64_t **wctr = NULL;
-    const uint8_t funcnums[4] = {IMC_CH0_FUNC, IMC_CH1_FUNC, IMC_CH2_FUNC, IMC_CH3_FUNC};
-    const uint8_t devnums[2] = {IMC0_DEV, IMC1_DEV};
-    uint8_t devctr = 0;
-    uint8_t func = 0;
-    uint8_t sockctr = 0;
-    int i;
+    struct imc_snapshot *d = NULL;
+    uint64_t **src;
+    double before, after;
+    unsigned k;
 
-    read_imc_counter_batch(rcounter);
-    read_imc_counter_batch(wcounter);
-    switch (rcounter)
+    if (mode != IMC_SNAPSHOT_FREEZE && mode != IMC_SNAPSHOT_NOFREEZE)
     {
-        case 0:
-            rctr = pcd->ctr0;
-            break;
-        case 1:
-            rctr = pcd->ctr1;
-            break;
-        case 2:
-            rctr = pcd->ctr2;
-            break;
-        case 3:
-            rctr = pcd->ctr3;
-            break;
-        case 4:
-            rctr = pcd->ctr4;
-            break;
+        libmsr_error_handler("read_imc_snapshot(): Invalid snapshot mode", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
     }
-    switch (wcounter)
+    if (imc_snapshot_storage(&d))
     {
-        case 0:
-            wctr = pcd->ctr0;
-            break;
-        case 1:
-            wctr = pcd->ctr1;
-            break;
-        case 2:
-            wctr = pcd->ctr2;
-            break;
-        case 3:
-            wctr = pcd->ctr3;
-            break;
-        case 4:
-            wctr = pcd->ctr4;
-            break;
+        return -1;
     }
+    before = monotonic_time();
+    if (do_csr_batch_op(mode == IMC_SNAPSHOT_FREEZE ? CSR_IMC_SNAPSHOT : CSR_IMC_SNAPSHOT_NOFREEZE))
+    {
+        return -1;
+    }
+    after = monotonic_time();
+    d->timestamp = (before + after) / 2.0;
+    d->skew = after - before;
+    d->mode = mode;
 
-    fprintf(writedest, "Percent %s Requests\n", (type ? "read\0" : "write\0"));
-    for (i = 0; i < NUMCTRS * num_sockets(); i++)
+    src = (mode == IMC_SNAPSHOT_FREEZE ? ops->frozen : ops->running);
+    for (k = 0; k < d->num_channels * IMC_NUM_CTRS; k++)
     {
-        if (i > 0 && i%4 == 0)
-        {
-            devctr++;
-        }
-        devctr %= 2;
-        func %= 4;
-        if (i > 0 && i%8 == 0)
-        {
-            sockctr++;
-        }
-        fprintf(writedest, "dev %d func %d sock %d: ", devnums[devctr], funcnums[func], sockctr);
-        if (type)
-        {
-            fprintf(writedest, "%lf\n", (double)*rctr[i] / ((*rctr[i] + *wctr[i]) ? (*rctr[i] + *wctr[i]) : 1));
-        }
-        else
+        d->value[k] = *src[k];
+        pcd->value[k] = *src[k];
+    }
+    d->skew_dclk = (mode == IMC_SNAPSHOT_NOFREEZE ? ctr_wrap_delta(*ops->dclk_end, d->value[IMC_CTR_IDX(0, IMC_FIXED_CTR)], IMC_CTR_WIDTH) : 0);
+    return 0;
+}
+
+int imc_metrics_storage(struct imc_metrics_data **data)
+{
+    static struct imc_metrics_data d;
+    static int init = 0;
+    struct imc_topology *topo;
+
+    if (!init)
+    {
+        topo = imc_topology_storage();
+        if (topo->num_channels == 0)
         {
-            fprintf(writedest, "%lf\n", (double)*wctr[i] / ((*rctr[i] + *wctr[i]) ? (*rctr[i] + *wctr[i]) : 1));
+            libmsr_error_handler("imc_metrics_storage(): No iMC channels found", LIBMSR_ERROR_CSR_INIT, getenv("HOSTNAME"), __FILE__, __LINE__);
+            return -1;
         }
-        func++;
+        init_pmon_ctrs();
+        d.num_channels = topo->num_channels;
+        d.num_sockets = topo->num_sockets;
+        d.channel = (struct imc_metrics *) libmsr_calloc(d.num_channels, sizeof(struct imc_metrics));
+        d.socket = (struct imc_metrics *) libmsr_calloc(d.num_sockets, sizeof(struct imc_metrics));
+        d.old = (uint64_t *) libmsr_calloc(d.num_channels * IMC_NUM_CTRS, sizeof(uint64_t));
+        init = 1;
+    }
+    if (data != NULL)
+    {
+        *data = &d;
     }
     return 0;
 }
 
-int print_mem_page_empty_from_ctr(const unsigned act, const unsigned pre, const unsigned cas, FILE *writedest)
+void imc_metrics_ratios(struct imc_metrics *m)
+{
+    uint64_t cas = m->cas_rd + m->cas_wr;
+    uint64_t empty = (m->act > m->pre_miss ? m->act - m->pre_miss : 0);
+
+    if (cas == 0)
+    {
+        m->page_hit = m->page_empty = m->page_miss = m->read_ratio = 0.0;
+        return;
+    }
+    m->page_miss = (double)m->pre_miss / cas;
+    m->page_empty = (double)empty / cas;
+    m->page_hit = 1.0 - m->page_miss - m->page_empty;
+    if (m->page_hit < 0.0)
+    {
+        m->page_hit = 0.0;
+    }
+    m->read_ratio = (double)m->cas_rd / cas;
+}
+
+/// @brief Copy the current counter values into the baseline.
+///
+/// @param [in] d iMC metrics data.
+static void imc_metrics_baseline(struct imc_metrics_data *d)
 {
     struct pmonctrs_data *pcd = pmon_ctr_storage();
-    uint64_t **actr = NULL;
-    uint64_t **pctr = NULL;
-    uint64_t **cctr = NULL;
-    const uint8_t funcnums[4] = {IMC_CH0_FUNC, IMC_CH1_FUNC, IMC_CH2_FUNC, IMC_CH3_FUNC};
-    const uint8_t devnums[2] = {IMC0_DEV, IMC1_DEV};
-    uint8_t devctr = 0;
-    uint8_t func = 0;
-    uint8_t sockctr = 0;
-    int i;
 
-    read_imc_counter_batch(act);
-    read_imc_counter_batch(pre);
-    read_imc_counter_batch(cas);
-    switch (act)
+    memcpy(d->old, pcd->value, d->num_channels * IMC_NUM_CTRS * sizeof(uint64_t));
+}
+
+int enable_imc_metrics(void)
+{
+    static const uint32_t umask[IMC_NUM_CTRS] = {
+        [IMC_METRICS_CAS_RD_CTR] = UMASK_CAS_RD,
+        [IMC_METRICS_CAS_WR_CTR] = UMASK_CAS_WR,
+        [IMC_METRICS_ACT_CTR] = 0xFF,
+        [IMC_METRICS_PRE_MISS_CTR] = UMASK_PRE_PAGE_MISS,
+    };
+    static const uint8_t event[IMC_NUM_CTRS] = {
+        [IMC_METRICS_CAS_RD_CTR] = EVT_CAS_COUNT,
+        [IMC_METRICS_CAS_WR_CTR] = EVT_CAS_COUNT,
+        [IMC_METRICS_ACT_CTR] = EVT_ACT_COUNT,
+        [IMC_METRICS_PRE_MISS_CTR] = EVT_PRE_COUNT,
+    };
+    struct imc_metrics_data *d = NULL;
+    unsigned j;
+
+    if (imc_metrics_storage(&d))
     {
-        case 0:
-            actr = pcd->ctr0;
-            break;
-        case 1:
-            actr = pcd->ctr1;
-            break;
-        case 2:
-            actr = pcd->ctr2;
-            break;
-        case 3:
-            actr = pcd->ctr3;
-            break;
-        case 4:
-            actr = pcd->ctr4;
-            break;
+        return -1;
     }
-    switch (pre)
+    for (j = 0; j < IMC_NUM_CTRS; j++)
     {
-        case 0:
-            pctr = pcd->ctr0;
-            break;
-        case 1:
-            pctr = pcd->ctr1;
-            break;
-        case 2:
-            pctr = pcd->ctr2;
-            break;
-        case 3:
-            pctr = pcd->ctr3;
-            break;
-        case 4:
-            pctr = pcd->ctr4;
-            break;
+        set_pmon_config(j, (j == IMC_FIXED_CTR ? IMC_FIXED_CTL_EN : pmon_setting(0x0, 0x0, 0x0, umask[j], event[j])));
     }
-    switch (cas)
+    if (write_pmon_config() || read_imc_ctrs())
     {
-        case 0:
-            cctr = pcd->ctr0;
-            break;
-        case 1:
-            cctr = pcd->ctr1;
-            break;
-        case 2:
-            cctr = pcd->ctr2;
-            break;
-        case 3:
-            cctr = pcd->ctr3;
-            break;
-        case 4:
-            cctr = pcd->ctr4;
-            break;
+        return -1;
     }
+    imc_metrics_baseline(d);
+    return 0;
+}
 
-    fprintf(writedest, "Percent Requests Caused Page Empty\n");
-    for (i = 0; i < NUMCTRS * num_sockets(); i++)
+int poll_imc_metrics(void)
+{
+    static struct imc_topology *topo = NULL;
+    static uint64_t *delta = NULL;
+    struct pmonctrs_data *pcd = pmon_ctr_storage();
+    struct imc_metrics_data *d = NULL;
+    const uint64_t *dc;
+    struct imc_metrics *m;
+    unsigned i, k, s;
+
+    if (imc_metrics_storage(&d))
     {
-        if (i > 0 && i%4 == 0)
-        {
-            devctr++;
-        }
-        devctr %= 2;
-        func %= 4;
-        if (i > 0 && i%8 == 0)
-        {
-            sockctr++;
-        }
-        fprintf(writedest, "dev %d func %d sock %d: ", devnums[devctr], funcnums[func], sockctr);
-        fprintf(writedest, "%lf\n", (double)(*actr[i] - *pctr[i]) / (*cctr[i] ? *cctr[i] : 1));
-        func++;
+        return -1;
+    }
+    if (topo == NULL)
+    {
+        topo = imc_topology_storage();
+        delta = (uint64_t *) libmsr_calloc(d->num_channels * IMC_NUM_CTRS, sizeof(uint64_t));
+    }
+    if (read_imc_ctrs())
+    {
+        return -1;
+    }
+    /* One pass over the flat storage for every counter of every channel. */
+    for (k = 0; k < d->num_channels * IMC_NUM_CTRS; k++)
+    {
+        delta[k] = ctr_wrap_delta(pcd->value[k], d->old[k], IMC_CTR_WIDTH);
+        d->old[k] = pcd->value[k];
+    }
+    memset(d->socket, 0, d->num_sockets * sizeof(struct imc_metrics));
+    for (i = 0; i < d->num_channels; i++)
+    {
+        dc = &delta[IMC_CTR_IDX(i, 0)];
+        m = &d->channel[i];
+        m->cas_rd = dc[IMC_METRICS_CAS_RD_CTR];
+        m->cas_wr = dc[IMC_METRICS_CAS_WR_CTR];
+        m->act = dc[IMC_METRICS_ACT_CTR];
+        m->pre_miss = dc[IMC_METRICS_PRE_MISS_CTR];
+        m->dclk = dc[IMC_FIXED_CTR];
+        imc_metrics_ratios(m);
+
+        s = topo->channels[i].socket;
+        d->socket[s].cas_rd += m->cas_rd;
+        d->socket[s].cas_wr += m->cas_wr;
+        d->socket[s].act += m->act;
+        d->socket[s].pre_miss += m->pre_miss;
+        d->socket[s].dclk += m->dclk;
+    }
+    for (s = 0; s < d->num_sockets; s++)
+    {
+        imc_metrics_ratios(&d->socket[s]);
     }
     return 0;
 }
 
-int print_mem_page_miss_from_ctr(const unsigned pre, const unsigned cas, FILE *writedest)
+int print_mem_bw_from_ctr(const unsigned counter, FILE *writedest)
 {
     struct pmonctrs_data *pcd = pmon_ctr_storage();
-    uint64_t **pctr = NULL;
-    uint64_t **cctr = NULL;
-    const uint8_t funcnums[4] = {IMC_CH0_FUNC, IMC_CH1_FUNC, IMC_CH2_FUNC, IMC_CH3_FUNC};
-    const uint8_t devnums[2] = {IMC0_DEV, IMC1_DEV};
-    uint8_t devctr = 0;
-    uint8_t func = 0;
-    uint8_t sockctr = 0;
+    struct imc_topology *topo = imc_topology_storage();
+    const uint64_t *v;
     int i;
 
-    read_imc_counter_batch(pre);
-    read_imc_counter_batch(cas);
-    switch (pre)
+    if (read_imc_counter_batch(counter) < 0)
     {
-        case 0:
-            pctr = pcd->ctr0;
-            break;
-        case 1:
-            pctr = pcd->ctr1;
-            break;
-        case 2:
-            pctr = pcd->ctr2;
-            break;
-        case 3:
-            pctr = pcd->ctr3;
-            break;
-        case 4:
-            pctr = pcd->ctr4;
-            break;
+        return -1;
     }
-    switch (cas)
+    fprintf(writedest, "Memory Bandwidth\n");
+    for (i = 0; i < topo->num_channels; i++)
     {
-        case 0:
-            cctr = pcd->ctr0;
-            break;
-        case 1:
-            cctr = pcd->ctr1;
-            break;
-        case 2:
-            cctr = pcd->ctr2;
-            break;
-        case 3:
-            cctr = pcd->ctr3;
-            break;
-        case 4:
-            cctr = pcd->ctr4;
-            break;
+        v = &pcd->value[IMC_CTR_IDX(i, 0)];
+        fprintf(writedest, "dev %d func %d sock %d: ", topo->channels[i].device, topo->channels[i].function, topo->channels[i].socket);
+        fprintf(writedest, "%lu bytes\n", v[counter] * 64LU);
     }
+    return 0;
+}
+
+int print_mem_pct_rw_from_ctr(const unsigned rcounter, const unsigned wcounter, int type, FILE *writedest)
+{
+    struct pmonctrs_data *pcd = pmon_ctr_storage();
+    struct imc_topology *topo = imc_topology_storage();
+    const uint64_t *v;
+    uint64_t total;
+    int i;
+
+    if (read_imc_counters((1U << rcounter) | (1U << wcounter)) < 0)
+    {
+        return -1;
+    }
+    fprintf(writedest, "Percent %s Requests\n", (type ? "read\0" : "write\0"));
+    for (i = 0; i < topo->num_channels; i++)
+    {
+        v = &pcd->value[IMC_CTR_IDX(i, 0)];
+        total = v[rcounter] + v[wcounter];
+        fprintf(writedest, "dev %d func %d sock %d: ", topo->channels[i].device, topo->channels[i].function, topo->channels[i].socket);
+        fprintf(writedest, "%lf\n", (double)v[type ? rcounter : wcounter] / (total ? total : 1));
+    }
+    return 0;
+}
+
+int print_mem_page_empty_from_ctr(const unsigned act, const unsigned pre, const unsigned cas, FILE *writedest)
+{
+    struct pmonctrs_data *pcd = pmon_ctr_storage();
+    struct imc_topology *topo = imc_topology_storage();
+    const uint64_t *v;
+    int i;
+
+    if (read_imc_counters((1U << act) | (1U << pre) | (1U << cas)) < 0)
+    {
+        return -1;
+    }
+    fprintf(writedest, "Percent Requests Caused Page Empty\n");
+    for (i = 0; i < topo->num_channels; i++)
+    {
+        v = &pcd->value[IMC_CTR_IDX(i, 0)];
+        fprintf(writedest, "dev %d func %d sock %d: ", topo->channels[i].device, topo->channels[i].function, topo->channels[i].socket);
+        fprintf(writedest, "%lf\n", (double)(v[act] - v[pre]) / (v[cas] ? v[cas] : 1));
+    }
+    return 0;
+}
+
+int print_mem_page_miss_from_ctr(const unsigned pre, const unsigned cas, FILE *writedest)
+{
+    struct pmonctrs_data *pcd = pmon_ctr_storage();
+    struct imc_topology *topo = imc_topology_storage();
+    const uint64_t *v;
+    int i;
 
+    if (read_imc_counters((1U << pre) | (1U << cas)) < 0)
+    {
+        return -1;
+    }
     fprintf(writedest, "Percent Requests Caused Page Miss\n");
-    for (i = 0; i < NUMCTRS * num_sockets(); i++)
+    for (i = 0; i < topo->num_channels; i++)
     {
-        if (i > 0 && i%4 == 0)
-        {
-            devctr++;
-        }
-        devctr %= 2;
-        func %= 4;
-        if (i > 0 && i%8 == 0)
-        {
-            sockctr++;
-        }
-        fprintf(writedest, "dev %d func %d sock %d: ", devnums[devctr], funcnums[func], sockctr);
-        fprintf(writedest, "%lf\n", (double)*pctr[i] / (*cctr[i] ? *cctr[i] : 1));
-        func++;
+        v = &pcd->value[IMC_CTR_IDX(i, 0)];
+        fprintf(writedest, "dev %d func %d sock %d: ", topo->channels[i].device, topo->channels[i].function, topo->channels[i].socket);
+        fprintf(writedest, "%lf\n", (double)v[pre] / (v[cas] ? v[cas] : 1));
     }
     return 0;
 }
@@ -671,39 +966,23 @@ int print_mem_page_miss_from_ctr(const unsigned pre, const unsigned cas, FILE *w
 int print_pmon_ctrs(void)
 {
     struct pmonctrs_data *pcd = pmon_ctr_storage();
-    const uint8_t funcnums[4] = {IMC_CH0_FUNC, IMC_CH1_FUNC, IMC_CH2_FUNC, IMC_CH3_FUNC};
-    const uint8_t devnums[2] = {IMC0_DEV, IMC1_DEV};
-    uint8_t devctr = 0;
-    uint8_t func = 0;
-    uint8_t sockctr = 0;
-    int i;
+    struct imc_topology *topo = imc_topology_storage();
+    int i, j;
 
     if (init_pmon_ctrs() > 0)
     {
         libmsr_error_handler("print_pmon_ctrs(): CSR iMC PMON counters have not been initialized", LIBMSR_ERROR_CSR_INIT, getenv("HOSTNAME"), __FILE__, __LINE__);
         return -1;
     }
-    do_csr_batch_op(CSR_IMC_CTRS);
+    read_imc_ctrs();
 
-    for (i = 0; i < num_sockets() * NUMCTRS; i++)
+    for (i = 0; i < topo->num_channels; i++)
     {
-        if (i > 0 && i%4 == 0)
-        {
-            devctr++;
-        }
-        devctr %= 2;
-        func %= 4;
-        if (i > 0 && i%8 == 0)
+        fprintf(stdout, "dev %d func %d sock %d\n", topo->channels[i].device, topo->channels[i].function, topo->channels[i].socket);
+        for (j = 0; j < IMC_NUM_CTRS; j++)
         {
-            sockctr++;
+            fprintf(stdout, "CTR%d %lx\n", j, pcd->value[IMC_CTR_IDX(i, j)]);
         }
-        fprintf(stdout, "dev %d func %d sock %d\n", devnums[devctr], funcnums[func], sockctr);
-        fprintf(stdout, "CTR0 %lx\n", *pcd->ctr0[i]);
-        fprintf(stdout, "CTR1 %lx\n", *pcd->ctr1[i]);
-        fprintf(stdout, "CTR2 %lx\n", *pcd->ctr2[i]);
-        fprintf(stdout, "CTR3 %lx\n", *pcd->ctr3[i]);
-        fprintf(stdout, "CTR4 %lx\n", *pcd->ctr4[i]);
-        func++;
     }
     return 0;
 }
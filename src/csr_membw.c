@@ -0,0 +1,294 @@
+/* csr_membw.c
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "msr_core.h"
+#include "csr_core.h"
+#include "csr_imc.h"
+#include "csr_membw.h"
+#include "memhdlr.h"
+#include "cpuid.h"
+#include "libmsr_error.h"
+#include "libmsr_debug.h"
+
+/// @brief Registered bandwidth callback and its argument.
+static membw_callback_t membw_cb = NULL;
+static void *membw_cb_arg = NULL;
+
+int membw_storage(struct membw_data **data)
+{
+    static struct membw_data d;
+    static int init = 0;
+    struct imc_topology *topo;
+    unsigned i;
+
+    if (!init)
+    {
+        topo = imc_topology_storage();
+        if (topo->num_channels == 0)
+        {
+            libmsr_error_handler("membw_storage(): No iMC channels found", LIBMSR_ERROR_CSR_INIT, getenv("HOSTNAME"), __FILE__, __LINE__);
+            return -1;
+        }
+        d.num_channels = topo->num_channels;
+        d.num_sockets = topo->num_sockets;
+        d.channel_read = (double *) libmsr_calloc(d.num_channels, sizeof(double));
+        d.channel_write = (double *) libmsr_calloc(d.num_channels, sizeof(double));
+        d.channel_valid = (int *) libmsr_calloc(d.num_channels, sizeof(int));
+        d.channel_stamp = (double *) libmsr_calloc(d.num_channels, sizeof(double));
+        d.socket_read = (double *) libmsr_calloc(d.num_sockets, sizeof(double));
+        d.socket_write = (double *) libmsr_calloc(d.num_sockets, sizeof(double));
+        d.rd = (uint64_t **) libmsr_calloc(d.num_channels, sizeof(uint64_t *));
+        d.wr = (uint64_t **) libmsr_calloc(d.num_channels, sizeof(uint64_t *));
+        d.old_rd = (uint64_t *) libmsr_calloc(d.num_channels, sizeof(uint64_t));
+        d.old_wr = (uint64_t *) libmsr_calloc(d.num_channels, sizeof(uint64_t));
+
+        allocate_csr_batch(CSR_MEMBW_CTRS, 2 * d.num_channels);
+        for (i = 0; i < d.num_channels; i++)
+        {
+            create_csr_batch_op(CSR_PMONCTR0 + MEMBW_RD_CTR * 8, CSR_UNCORE_BUS, topo->channels[i].device, topo->channels[i].function, topo->channels[i].socket, 1, 8, &d.rd[i], CSR_MEMBW_CTRS);
+            create_csr_batch_op(CSR_PMONCTR0 + MEMBW_WR_CTR * 8, CSR_UNCORE_BUS, topo->channels[i].device, topo->channels[i].function, topo->channels[i].socket, 1, 8, &d.wr[i], CSR_MEMBW_CTRS);
+        }
+        init = 1;
+    }
+    if (data != NULL)
+    {
+        *data = &d;
+    }
+    return 0;
+}
+
+/// @brief Read the CAS counters of every channel, stamp the sample, and mark
+/// which channels were read.
+///
+/// @param [in] d Memory bandwidth data.
+///
+/// @return CLOCK_MONOTONIC time at the middle of the CSR batch, or a negative
+/// value if the batch fails as a whole.
+static double membw_snapshot(struct membw_data *d)
+{
+    double before = monotonic_time();
+    const int *errs = NULL;
+    unsigned i;
+    int res;
+
+    res = do_csr_batch_op(CSR_MEMBW_CTRS);
+    if (res < 0)
+    {
+        return -1.0;
+    }
+    if (res > 0)
+    {
+        csr_batch_errors(CSR_MEMBW_CTRS, &errs);
+    }
+    for (i = 0; i < d->num_channels; i++)
+    {
+        /* Operations were created as (rd, wr) pairs per channel. */
+        d->channel_valid[i] = (errs == NULL || (!errs[2 * i] && !errs[2 * i + 1]));
+    }
+    return (before + monotonic_time()) / 2.0;
+}
+
+int enable_membw(void)
+{
+    struct membw_data *d = NULL;
+    double ts;
+    unsigned i;
+
+    if (membw_storage(&d))
+    {
+        return -1;
+    }
+    init_pmon_ctrs();
+    if (mem_bw_on_ctr(MEMBW_RD_CTR, 0) || mem_bw_on_ctr(MEMBW_WR_CTR, 1))
+    {
+        return -1;
+    }
+    ts = membw_snapshot(d);
+    if (ts < 0.0)
+    {
+        return -1;
+    }
+    for (i = 0; i < d->num_channels; i++)
+    {
+        d->old_rd[i] = *d->rd[i];
+        d->old_wr[i] = *d->wr[i];
+        d->channel_stamp[i] = (d->channel_valid[i] ? ts : 0.0);
+    }
+    d->timestamp = ts;
+    d->elapsed = 0.0;
+    return 0;
+}
+
+int poll_membw_data(void)
+{
+    static struct imc_topology *topo = NULL;
+    struct membw_data *d = NULL;
+    uint64_t cur;
+    double ts, scale;
+    unsigned i, s;
+
+    if (membw_storage(&d))
+    {
+        return -1;
+    }
+    if (topo == NULL)
+    {
+        topo = imc_topology_storage();
+    }
+    ts = membw_snapshot(d);
+    if (ts < 0.0)
+    {
+        return -1;
+    }
+    d->elapsed = ts - d->timestamp;
+    d->timestamp = ts;
+
+    for (s = 0; s < d->num_sockets; s++)
+    {
+        d->socket_read[s] = 0.0;
+        d->socket_write[s] = 0.0;
+    }
+    d->node_read = 0.0;
+    d->node_write = 0.0;
+    for (i = 0; i < d->num_channels; i++)
+    {
+        if (!d->channel_valid[i] || d->channel_stamp[i] == 0.0)
+        {
+            /* Drop this channel for one sample; a channel without a baseline
+             * takes one now. */
+            d->channel_read[i] = 0.0;
+            d->channel_write[i] = 0.0;
+            if (d->channel_valid[i])
+            {
+                d->old_rd[i] = *d->rd[i];
+                d->old_wr[i] = *d->wr[i];
+                d->channel_stamp[i] = ts;
+                d->channel_valid[i] = 0;
+            }
+            continue;
+        }
+        scale = (ts > d->channel_stamp[i] ? MEMBW_BYTES_PER_CAS / ((ts - d->channel_stamp[i]) * 1.0e9) : 0.0);
+        d->channel_stamp[i] = ts;
+        cur = *d->rd[i];
+        d->channel_read[i] = ctr_wrap_delta(cur, d->old_rd[i], MEMBW_CTR_WIDTH) * scale;
+        d->old_rd[i] = cur;
+        cur = *d->wr[i];
+        d->channel_write[i] = ctr_wrap_delta(cur, d->old_wr[i], MEMBW_CTR_WIDTH) * scale;
+        d->old_wr[i] = cur;
+
+        s = topo->channels[i].socket;
+        d->socket_read[s] += d->channel_read[i];
+        d->socket_write[s] += d->channel_write[i];
+        d->node_read += d->channel_read[i];
+        d->node_write += d->channel_write[i];
+    }
+    if (membw_cb != NULL)
+    {
+        membw_cb(d, membw_cb_arg);
+    }
+    return 0;
+}
+
+void set_membw_callback(membw_callback_t cb, void *arg)
+{
+    membw_cb = cb;
+    membw_cb_arg = arg;
+}
+
+int monitor_membw(unsigned interval_ms, unsigned count)
+{
+    struct membw_data *d = NULL;
+    struct timespec next;
+    unsigned n;
+    int rc;
+
+    if (membw_storage(&d))
+    {
+        return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (n = 0; n < count; n++)
+    {
+        /* Sleep to an absolute deadline so polling cost does not drift the
+         * sampling interval. */
+        next.tv_sec += interval_ms / 1000;
+        next.tv_nsec += (interval_ms % 1000) * 1000000L;
+        if (next.tv_nsec >= 1000000000L)
+        {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000L;
+        }
+        /* clock_nanosleep() returns the error number instead of setting
+         * errno; only a signal interruption is worth retrying. */
+        while ((rc = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL)) == EINTR)
+        {
+        }
+        if (rc)
+        {
+            libmsr_error_handler("monitor_membw(): clock_nanosleep failed", LIBMSR_ERROR_RUNTIME, getenv("HOSTNAME"), __FILE__, __LINE__);
+            return -1;
+        }
+        if (poll_membw_data())
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void dump_membw_data_label(FILE *writedest)
+{
+    fprintf(writedest, "timestamp socket read_GBs write_GBs\n");
+}
+
+void dump_membw_data(FILE *writedest)
+{
+    struct membw_data *d = NULL;
+    unsigned s;
+
+    if (membw_storage(&d))
+    {
+        return;
+    }
+    for (s = 0; s < d->num_sockets; s++)
+    {
+        fprintf(writedest, "%.6lf %u %.3lf %.3lf\n", d->timestamp, s, d->socket_read[s], d->socket_write[s]);
+    }
+    fprintf(writedest, "%.6lf node %.3lf %.3lf\n", d->timestamp, d->node_read, d->node_write);
+}
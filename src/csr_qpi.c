@@ -0,0 +1,215 @@
+/* csr_qpi.c
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "csr_core.h"
+#include "csr_qpi.h"
+#include "msr_core.h"
+#include "memhdlr.h"
+#include "cpuid.h"
+#include "libmsr_error.h"
+#include "libmsr_debug.h"
+
+/* Q_Py_PCI_PMON_CTL enable and reset bits. */
+#define QPI_CTL_EN (1UL << 22)
+#define QPI_CTL_RST (1UL << 17)
+
+/// @brief Build the QPI port map.
+///
+/// @param [out] d QPI data.
+static void qpi_discover(struct qpi_data *d)
+{
+    static const unsigned dids[3] = QPI_PORT_DIDS;
+    static const unsigned devs[3] = QPI_PORT_DEVS;
+    static const unsigned funcs[3] = {QPI_PORT_FUNC, QPI_PORT_FUNC, QPI_PORT_FUNC};
+    struct csr_pci_unit *units = NULL;
+    unsigned i;
+
+    d->num_links = csr_pci_units(dids, devs, funcs, QPI_NUM_PORTS, num_sockets(), &units);
+    d->links = (struct qpi_link *) libmsr_calloc(d->num_links, sizeof(struct qpi_link));
+    for (i = 0; i < d->num_links; i++)
+    {
+        d->links[i].socket = units[i].socket;
+        d->links[i].port = units[i].index;
+        d->links[i].device = units[i].device;
+        d->links[i].function = units[i].function;
+    }
+    libmsr_free(units);
+}
+
+int qpi_storage(struct qpi_data **data)
+{
+    static const off_t ctrs[QPI_NUM_CTRS] = {CSR_QPI_PMONCTR0, CSR_QPI_PMONCTR1, CSR_QPI_PMONCTR2, CSR_QPI_PMONCTR3};
+    static const off_t cfgs[QPI_NUM_CTRS] = {CSR_QPI_PMONCTRCFG0, CSR_QPI_PMONCTRCFG1, CSR_QPI_PMONCTRCFG2, CSR_QPI_PMONCTRCFG3};
+    static struct qpi_data d;
+    static int init = 0;
+    struct qpi_link *l;
+    unsigned i, j;
+
+    if (!init)
+    {
+        qpi_discover(&d);
+        if (d.num_links == 0)
+        {
+            libmsr_error_handler("qpi_storage(): No QPI ports found", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+            return -1;
+        }
+        d.stats = (struct qpi_link_stats *) libmsr_calloc(d.num_links, sizeof(struct qpi_link_stats));
+        allocate_csr_batch(CSR_QPI_CTRS, QPI_NUM_CTRS * d.num_links);
+        allocate_csr_batch(CSR_QPI_EVTS, QPI_NUM_CTRS * d.num_links);
+        for (j = 0; j < QPI_NUM_CTRS; j++)
+        {
+            d.ctr[j] = (uint64_t **) libmsr_calloc(d.num_links, sizeof(uint64_t *));
+            d.cfg[j] = (uint64_t **) libmsr_calloc(d.num_links, sizeof(uint64_t *));
+            d.old[j] = (uint64_t *) libmsr_calloc(d.num_links, sizeof(uint64_t));
+            for (i = 0; i < d.num_links; i++)
+            {
+                l = &d.links[i];
+                create_csr_batch_op(ctrs[j], CSR_UNCORE_BUS, l->device, l->function, l->socket, 1, 8, &d.ctr[j][i], CSR_QPI_CTRS);
+                create_csr_batch_op(cfgs[j], CSR_UNCORE_BUS, l->device, l->function, l->socket, 0, 4, &d.cfg[j][i], CSR_QPI_EVTS);
+            }
+        }
+        init = 1;
+    }
+    if (data != NULL)
+    {
+        *data = &d;
+    }
+    return 0;
+}
+
+int enable_qpi(void)
+{
+    static const uint64_t setting[QPI_NUM_CTRS] = {
+        [QPI_CTR_CLOCKTICKS] = QPI_EVT_CLOCKTICKS,
+        [QPI_CTR_RX_DATA] = QPI_EVT_RXL_FLITS_G0 | (QPI_UMASK_FLITS_G0_DATA << 8),
+        [QPI_CTR_TX_DATA] = QPI_EVT_TXL_FLITS_G0 | (QPI_UMASK_FLITS_G0_DATA << 8),
+        [QPI_CTR_RX_IDLE] = QPI_EVT_RXL_FLITS_G0 | (QPI_UMASK_FLITS_G0_IDLE << 8),
+    };
+    struct qpi_data *d = NULL;
+    unsigned i, j;
+
+    if (qpi_storage(&d))
+    {
+        return -1;
+    }
+    for (j = 0; j < QPI_NUM_CTRS; j++)
+    {
+        for (i = 0; i < d->num_links; i++)
+        {
+            *d->cfg[j][i] = QPI_CTL_EN | QPI_CTL_RST | setting[j];
+        }
+    }
+    if (do_csr_batch_op(CSR_QPI_EVTS) || do_csr_batch_op(CSR_QPI_CTRS))
+    {
+        return -1;
+    }
+    d->timestamp = monotonic_time();
+    d->elapsed = 0.0;
+    for (j = 0; j < QPI_NUM_CTRS; j++)
+    {
+        for (i = 0; i < d->num_links; i++)
+        {
+            d->old[j][i] = *d->ctr[j][i];
+        }
+    }
+    return 0;
+}
+
+int poll_qpi_data(void)
+{
+    struct qpi_data *d = NULL;
+    struct qpi_link_stats *st;
+    uint64_t delta[QPI_NUM_CTRS];
+    double before, ts;
+    unsigned i, j;
+
+    if (qpi_storage(&d))
+    {
+        return -1;
+    }
+    before = monotonic_time();
+    if (do_csr_batch_op(CSR_QPI_CTRS))
+    {
+        return -1;
+    }
+    ts = (before + monotonic_time()) / 2.0;
+    d->elapsed = ts - d->timestamp;
+    d->timestamp = ts;
+
+    for (i = 0; i < d->num_links; i++)
+    {
+        for (j = 0; j < QPI_NUM_CTRS; j++)
+        {
+            delta[j] = ctr_wrap_delta(*d->ctr[j][i], d->old[j][i], QPI_CTR_WIDTH);
+            d->old[j][i] = *d->ctr[j][i];
+        }
+        st = &d->stats[i];
+        st->rx_bytes_per_sec = (d->elapsed > 0.0 ? (double)delta[QPI_CTR_RX_DATA] * QPI_BYTES_PER_FLIT / d->elapsed : 0.0);
+        st->tx_bytes_per_sec = (d->elapsed > 0.0 ? (double)delta[QPI_CTR_TX_DATA] * QPI_BYTES_PER_FLIT / d->elapsed : 0.0);
+        if (delta[QPI_CTR_CLOCKTICKS])
+        {
+            st->rx_data_pct = 100.0 * delta[QPI_CTR_RX_DATA] / delta[QPI_CTR_CLOCKTICKS];
+            st->tx_data_pct = 100.0 * delta[QPI_CTR_TX_DATA] / delta[QPI_CTR_CLOCKTICKS];
+            st->rx_util_pct = (delta[QPI_CTR_RX_IDLE] < delta[QPI_CTR_CLOCKTICKS] ? 100.0 * (1.0 - (double)delta[QPI_CTR_RX_IDLE] / delta[QPI_CTR_CLOCKTICKS]) : 0.0);
+        }
+        else
+        {
+            st->rx_data_pct = st->tx_data_pct = st->rx_util_pct = 0.0;
+        }
+    }
+    return 0;
+}
+
+void dump_qpi_data_label(FILE *writedest)
+{
+    fprintf(writedest, "socket port rx_Bps tx_Bps rx_data_pct tx_data_pct rx_util_pct\n");
+}
+
+void dump_qpi_data(FILE *writedest)
+{
+    struct qpi_data *d = NULL;
+    unsigned i;
+
+    if (qpi_storage(&d))
+    {
+        return;
+    }
+    for (i = 0; i < d->num_links; i++)
+    {
+        fprintf(writedest, "%u %u %.0lf %.0lf %.2lf %.2lf %.2lf\n", d->links[i].socket, d->links[i].port, d->stats[i].rx_bytes_per_sec, d->stats[i].tx_bytes_per_sec, d->stats[i].rx_data_pct, d->stats[i].tx_data_pct, d->stats[i].rx_util_pct);
+    }
+}
@@ -0,0 +1,194 @@
+/* csr_r2pcie.c
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "csr_core.h"
+#include "csr_r2pcie.h"
+#include "msr_core.h"
+#include "memhdlr.h"
+#include "cpuid.h"
+#include "libmsr_error.h"
+#include "libmsr_debug.h"
+
+/* R2_PCI_PMON_CTL enable and reset bits. */
+#define R2PCIE_CTL_EN (1UL << 22)
+#define R2PCIE_CTL_RST (1UL << 17)
+
+int r2pcie_storage(struct r2pcie_data **data)
+{
+    static const unsigned did = R2PCIE_DID;
+    static const unsigned dev = R2PCIE_DEV;
+    static const unsigned func = R2PCIE_FUNC;
+    static const off_t ctrs[R2PCIE_NUM_CTRS] = {CSR_R2PCIE_PMONCTR0, CSR_R2PCIE_PMONCTR1, CSR_R2PCIE_PMONCTR2, CSR_R2PCIE_PMONCTR3};
+    static const off_t cfgs[R2PCIE_NUM_CTRS] = {CSR_R2PCIE_PMONCTRCFG0, CSR_R2PCIE_PMONCTRCFG1, CSR_R2PCIE_PMONCTRCFG2, CSR_R2PCIE_PMONCTRCFG3};
+    static struct r2pcie_data d;
+    static int init = 0;
+    struct csr_pci_unit *u;
+    unsigned i, j;
+
+    if (!init)
+    {
+        d.num_units = csr_pci_units(&did, &dev, &func, 1, num_sockets(), &d.units);
+        if (d.num_units == 0)
+        {
+            libmsr_error_handler("r2pcie_storage(): No R2PCIe boxes found", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+            return -1;
+        }
+        d.stats = (struct r2pcie_socket_stats *) libmsr_calloc(d.num_units, sizeof(struct r2pcie_socket_stats));
+        allocate_csr_batch(CSR_R2PCIE_CTRS, R2PCIE_NUM_CTRS * d.num_units);
+        allocate_csr_batch(CSR_R2PCIE_EVTS, R2PCIE_NUM_CTRS * d.num_units);
+        for (j = 0; j < R2PCIE_NUM_CTRS; j++)
+        {
+            d.ctr[j] = (uint64_t **) libmsr_calloc(d.num_units, sizeof(uint64_t *));
+            d.cfg[j] = (uint64_t **) libmsr_calloc(d.num_units, sizeof(uint64_t *));
+            d.old[j] = (uint64_t *) libmsr_calloc(d.num_units, sizeof(uint64_t));
+            for (i = 0; i < d.num_units; i++)
+            {
+                u = &d.units[i];
+                create_csr_batch_op(ctrs[j], CSR_UNCORE_BUS, u->device, u->function, u->socket, 1, 8, &d.ctr[j][i], CSR_R2PCIE_CTRS);
+                create_csr_batch_op(cfgs[j], CSR_UNCORE_BUS, u->device, u->function, u->socket, 0, 4, &d.cfg[j][i], CSR_R2PCIE_EVTS);
+            }
+        }
+        init = 1;
+    }
+    if (data != NULL)
+    {
+        *data = &d;
+    }
+    return 0;
+}
+
+int enable_r2pcie(void)
+{
+    static const uint64_t setting[R2PCIE_NUM_CTRS] = {
+        [R2PCIE_CTR_CLOCKTICKS] = R2PCIE_EVT_CLOCKTICKS,
+        [R2PCIE_CTR_AD_USED] = R2PCIE_EVT_RING_AD_USED | (R2PCIE_UMASK_RING_USED_ALL << 8),
+        [R2PCIE_CTR_BL_USED] = R2PCIE_EVT_RING_BL_USED | (R2PCIE_UMASK_RING_USED_ALL << 8),
+        [R2PCIE_CTR_RXR_NE] = R2PCIE_EVT_RXR_CYCLES_NE | (R2PCIE_UMASK_RXR_NCB_NCS << 8),
+    };
+    struct r2pcie_data *d = NULL;
+    unsigned i, j;
+
+    if (r2pcie_storage(&d))
+    {
+        return -1;
+    }
+    for (j = 0; j < R2PCIE_NUM_CTRS; j++)
+    {
+        for (i = 0; i < d->num_units; i++)
+        {
+            *d->cfg[j][i] = R2PCIE_CTL_EN | R2PCIE_CTL_RST | setting[j];
+        }
+    }
+    if (do_csr_batch_op(CSR_R2PCIE_EVTS) || do_csr_batch_op(CSR_R2PCIE_CTRS))
+    {
+        return -1;
+    }
+    d->timestamp = monotonic_time();
+    d->elapsed = 0.0;
+    for (j = 0; j < R2PCIE_NUM_CTRS; j++)
+    {
+        for (i = 0; i < d->num_units; i++)
+        {
+            d->old[j][i] = *d->ctr[j][i];
+        }
+    }
+    return 0;
+}
+
+int poll_r2pcie_data(void)
+{
+    struct r2pcie_data *d = NULL;
+    struct r2pcie_socket_stats *st;
+    uint64_t clk;
+    double before, ts;
+    unsigned i, j;
+
+    if (r2pcie_storage(&d))
+    {
+        return -1;
+    }
+    before = monotonic_time();
+    if (do_csr_batch_op(CSR_R2PCIE_CTRS))
+    {
+        return -1;
+    }
+    ts = (before + monotonic_time()) / 2.0;
+    d->elapsed = ts - d->timestamp;
+    d->timestamp = ts;
+
+    for (i = 0; i < d->num_units; i++)
+    {
+        st = &d->stats[i];
+        for (j = 0; j < R2PCIE_NUM_CTRS; j++)
+        {
+            st->delta[j] = ctr_wrap_delta(*d->ctr[j][i], d->old[j][i], R2PCIE_CTR_WIDTH);
+            d->old[j][i] = *d->ctr[j][i];
+        }
+        clk = st->delta[R2PCIE_CTR_CLOCKTICKS];
+        if (clk)
+        {
+            st->ad_ring_pct = 100.0 * st->delta[R2PCIE_CTR_AD_USED] / (clk * R2PCIE_RING_SLOTS);
+            st->bl_ring_pct = 100.0 * st->delta[R2PCIE_CTR_BL_USED] / (clk * R2PCIE_RING_SLOTS);
+            st->ingress_busy_pct = 100.0 * st->delta[R2PCIE_CTR_RXR_NE] / clk;
+        }
+        else
+        {
+            st->ad_ring_pct = st->bl_ring_pct = st->ingress_busy_pct = 0.0;
+        }
+    }
+    return 0;
+}
+
+void dump_r2pcie_data_label(FILE *writedest)
+{
+    fprintf(writedest, "socket ad_ring_pct bl_ring_pct ingress_busy_pct\n");
+}
+
+void dump_r2pcie_data(FILE *writedest)
+{
+    struct r2pcie_data *d = NULL;
+    unsigned i;
+
+    if (r2pcie_storage(&d))
+    {
+        return;
+    }
+    for (i = 0; i < d->num_units; i++)
+    {
+        fprintf(writedest, "%u %.2lf %.2lf %.2lf\n", d->units[i].socket, d->stats[i].ad_ring_pct, d->stats[i].bl_ring_pct, d->stats[i].ingress_busy_pct);
+    }
+}
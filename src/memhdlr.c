@@ -121,28 +121,35 @@ int memory_handler(void *address, void *oldaddr, int type)
                 free(arrays);
             }
             return 0;
-        case LIBMSR_REALLOC:
-#ifdef MEMHDLR_DEBUG
-            fprintf(stderr, "MEMHDLR: received address %p, (realloc %p)\n", address, oldaddr);
-#endif
+        case LIBMSR_FREE:
             for (i = 0; i < last; i++)
             {
                 if (arrays[i] == oldaddr)
                 {
-                    arrays[i] = address;
+                    free(oldaddr);
+                    arrays[i] = NULL;
                 }
             }
             return 0;
-        case LIBMSR_FREE:
-            for (i = 0; i < last; i++)
+        case LIBMSR_REALLOC:
+#ifdef MEMHDLR_DEBUG
+            fprintf(stderr, "MEMHDLR: received address %p, (realloc %p)\n", address, oldaddr);
+#endif
+            /* Matching a NULL oldaddr would alias a freed slot, and be freed
+             * twice at finalize, or find nothing and never be tracked. */
+            if (oldaddr != NULL)
             {
-                if (arrays[i] == oldaddr)
+                for (i = 0; i < last; i++)
                 {
-                    free(oldaddr);
-                    arrays[i] = NULL;
+                    if (arrays[i] == oldaddr)
+                    {
+                        arrays[i] = address;
+                        return 0;
+                    }
                 }
             }
-            return 0;
+            /* A realloc from NULL is a new allocation. */
+            /* fall through */
         case LIBMSR_CALLOC:
         case LIBMSR_MALLOC:
             if (arrays == NULL)
@@ -0,0 +1,413 @@
+/* msr_cbo.c
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#include "msr_core.h"
+#include "msr_cbo.h"
+#include "memhdlr.h"
+#include "cpuid.h"
+#include "libmsr_error.h"
+#include "libmsr_debug.h"
+
+/// @brief MSR addresses of a single CBo slice.
+struct cbo_slice_msrs {
+    off_t box_ctl;
+    off_t evtsel[CBO_NUM_CTRS];
+    off_t filter;
+    off_t filter1;
+    off_t ctr[CBO_NUM_CTRS];
+};
+
+#if CBO_HAS_FILTER1
+#define CBO_FILTER1(n) MSR_C##n##_BOX_FILTER1
+#else
+#define CBO_FILTER1(n) 0
+#endif
+
+#define CBO_SLICE(n) \
+    {MSR_C##n##_PMON_BOX_CTL, \
+     {MSR_C##n##_PMON_EVNTSEL0, MSR_C##n##_PMON_EVNTSEL1, MSR_C##n##_PMON_EVNTSEL2, MSR_C##n##_PMON_EVNTSEL3}, \
+     MSR_C##n##_BOX_FILTER, CBO_FILTER1(n), \
+     {MSR_C##n##_PMON_CTR0, MSR_C##n##_PMON_CTR1, MSR_C##n##_PMON_CTR2, MSR_C##n##_PMON_CTR3}}
+
+static const struct cbo_slice_msrs cbo_slices[CBO_NUM_SLICES] = {
+    CBO_SLICE(0), CBO_SLICE(1), CBO_SLICE(2), CBO_SLICE(3),
+    CBO_SLICE(4), CBO_SLICE(5), CBO_SLICE(6), CBO_SLICE(7),
+#if CBO_NUM_SLICES > 8
+    CBO_SLICE(8), CBO_SLICE(9), CBO_SLICE(10), CBO_SLICE(11),
+    CBO_SLICE(12), CBO_SLICE(13), CBO_SLICE(14),
+#endif
+#if CBO_NUM_SLICES > 15
+    CBO_SLICE(15), CBO_SLICE(16), CBO_SLICE(17),
+#endif
+};
+
+/// @brief Event select, umask, and counter restriction of each named event.
+static const struct {
+    const char *name;
+    uint64_t eventsel;
+    uint64_t umask;
+    /// @brief Non-zero if the event may only be counted on counter 0.
+    int ctr0_only;
+} cbo_events[CBO_NUM_EVENTS] = {
+    [CBO_CLOCKTICKS]             = {"CLOCKTICKS",            CBO_EVT_CLOCKTICKS,    0,                             0},
+    [CBO_LLC_LOOKUP_ANY]         = {"LLC_LOOKUP.ANY",        CBO_EVT_LLC_LOOKUP,    CBO_UMASK_LLC_LOOKUP_ANY,      0},
+    [CBO_LLC_LOOKUP_DATA_READ]   = {"LLC_LOOKUP.DATA_READ",  CBO_EVT_LLC_LOOKUP,    CBO_UMASK_LLC_LOOKUP_DATA_READ, 0},
+    [CBO_LLC_LOOKUP_WRITE]       = {"LLC_LOOKUP.WRITE",      CBO_EVT_LLC_LOOKUP,    CBO_UMASK_LLC_LOOKUP_WRITE,    0},
+    [CBO_LLC_VICTIMS]            = {"LLC_VICTIMS",           CBO_EVT_LLC_VICTIMS,   CBO_UMASK_LLC_VICTIMS_ALL,     0},
+    [CBO_TOR_INSERTS_ALL]        = {"TOR_INSERTS.ALL",       CBO_EVT_TOR_INSERTS,   CBO_UMASK_TOR_ALL,             0},
+    [CBO_TOR_INSERTS_MISS_ALL]   = {"TOR_INSERTS.MISS_ALL",  CBO_EVT_TOR_INSERTS,   CBO_UMASK_TOR_MISS_ALL,        0},
+    [CBO_TOR_INSERTS_OPCODE]     = {"TOR_INSERTS.OPCODE",    CBO_EVT_TOR_INSERTS,   CBO_UMASK_TOR_OPCODE,          0},
+    [CBO_TOR_OCCUPANCY_ALL]      = {"TOR_OCCUPANCY.ALL",     CBO_EVT_TOR_OCCUPANCY, CBO_UMASK_TOR_ALL,             1},
+    [CBO_TOR_OCCUPANCY_MISS_ALL] = {"TOR_OCCUPANCY.MISS_ALL", CBO_EVT_TOR_OCCUPANCY, CBO_UMASK_TOR_MISS_ALL,       1},
+};
+
+void cbo_storage(struct cbo_data **cd)
+{
+    static struct cbo_data d;
+    static int init = 0;
+    static uint64_t sockets = 0;
+    uint64_t n, idx;
+    int slice, i;
+
+    if (!init)
+    {
+        sockets = num_sockets();
+        /* There is one CBo per core. */
+        d.num_slices = cores_per_socket();
+        if (d.num_slices > CBO_NUM_SLICES)
+        {
+            d.num_slices = CBO_NUM_SLICES;
+        }
+        n = d.num_slices * sockets;
+
+        d.box_ctl = (uint64_t **) libmsr_calloc(n, sizeof(uint64_t *));
+        d.filter = (uint64_t **) libmsr_calloc(n, sizeof(uint64_t *));
+        d.filter1 = (uint64_t **) libmsr_calloc(n, sizeof(uint64_t *));
+        for (i = 0; i < CBO_NUM_CTRS; i++)
+        {
+            d.evtsel[i] = (uint64_t **) libmsr_calloc(n, sizeof(uint64_t *));
+            d.ctr[i] = (uint64_t **) libmsr_calloc(n, sizeof(uint64_t *));
+            d.old_ctr[i] = (uint64_t *) libmsr_calloc(n, sizeof(uint64_t));
+            d.delta[i] = (uint64_t *) libmsr_calloc(n, sizeof(uint64_t));
+            d.socket_delta[i] = (uint64_t *) libmsr_calloc(sockets, sizeof(uint64_t));
+        }
+        d.num_events = 0;
+
+        allocate_batch(CBO_CTRL, (6 + CBO_HAS_FILTER1) * n);
+        allocate_batch(CBO_DATA, CBO_NUM_CTRS * n);
+        for (slice = 0; slice < d.num_slices; slice++)
+        {
+            idx = slice * sockets;
+            load_socket_batch(cbo_slices[slice].box_ctl, &d.box_ctl[idx], CBO_CTRL);
+            for (i = 0; i < CBO_NUM_CTRS; i++)
+            {
+                load_socket_batch(cbo_slices[slice].evtsel[i], &d.evtsel[i][idx], CBO_CTRL);
+                load_socket_batch(cbo_slices[slice].ctr[i], &d.ctr[i][idx], CBO_DATA);
+            }
+            load_socket_batch(cbo_slices[slice].filter, &d.filter[idx], CBO_CTRL);
+#if CBO_HAS_FILTER1
+            load_socket_batch(cbo_slices[slice].filter1, &d.filter1[idx], CBO_CTRL);
+#endif
+        }
+        /* Keep the current filter settings for later batch writes. */
+        read_batch(CBO_CTRL);
+        init = 1;
+    }
+    if (cd != NULL)
+    {
+        *cd = &d;
+    }
+}
+
+const char *cbo_event_name(enum cbo_event_e event)
+{
+    if (event < 0 || event >= CBO_NUM_EVENTS)
+    {
+        return "UNKNOWN";
+    }
+    return cbo_events[event].name;
+}
+
+/// @brief Clear self-clearing bits of every box control and apply new ones.
+static void cbo_set_box_bits(struct cbo_data *cd, uint64_t bits)
+{
+    uint64_t n = cd->num_slices * num_sockets();
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        *cd->box_ctl[i] &= ~(CBO_BOX_RST_CTRL | CBO_BOX_RST_CTRS | CBO_BOX_FRZ);
+        *cd->box_ctl[i] |= CBO_BOX_FRZ_EN | bits;
+    }
+}
+
+int set_cbo_events(const enum cbo_event_e *events, int nevents)
+{
+    struct cbo_data *cd = NULL;
+    uint64_t n;
+    int i, j;
+
+    if (events == NULL || nevents < 1 || nevents > CBO_NUM_CTRS)
+    {
+        libmsr_error_handler("set_cbo_events(): Invalid number of events", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    for (i = 0; i < nevents; i++)
+    {
+        if (events[i] < 0 || events[i] >= CBO_NUM_EVENTS)
+        {
+            libmsr_error_handler("set_cbo_events(): Unknown CBo event", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+            return -1;
+        }
+        if (i != 0 && cbo_events[events[i]].ctr0_only)
+        {
+            libmsr_error_handler("set_cbo_events(): TOR occupancy can only be counted on counter 0", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+            return -1;
+        }
+    }
+    cbo_storage(&cd);
+    n = cd->num_slices * num_sockets();
+
+    for (j = 0; j < n; j++)
+    {
+        for (i = 0; i < CBO_NUM_CTRS; i++)
+        {
+            if (i < nevents)
+            {
+                *cd->evtsel[i][j] = CBO_EVTSEL_EN | (cbo_events[events[i]].umask << 8) | cbo_events[events[i]].eventsel;
+            }
+            else
+            {
+                *cd->evtsel[i][j] = 0;
+            }
+        }
+    }
+    for (i = 0; i < nevents; i++)
+    {
+        cd->event[i] = events[i];
+    }
+    cd->num_events = nevents;
+    cbo_set_box_bits(cd, CBO_BOX_RST_CTRS);
+
+    if (write_batch(CBO_CTRL))
+    {
+        return -1;
+    }
+    cbo_set_box_bits(cd, 0);
+    /* Establish the baseline so the first poll reports a real delta. */
+    return poll_cbo_data();
+}
+
+int set_cbo_filter(uint64_t filter, uint64_t filter1)
+{
+    struct cbo_data *cd = NULL;
+    uint64_t n;
+    int i;
+
+    cbo_storage(&cd);
+    n = cd->num_slices * num_sockets();
+    for (i = 0; i < n; i++)
+    {
+        *cd->filter[i] = filter;
+#if CBO_HAS_FILTER1
+        *cd->filter1[i] = filter1;
+#endif
+    }
+    cbo_set_box_bits(cd, 0);
+    return write_batch(CBO_CTRL);
+}
+
+int set_cbo_llc_events(void)
+{
+    /* TOR occupancy must be on counter 0. */
+    enum cbo_event_e events[CBO_NUM_CTRS] = {CBO_TOR_OCCUPANCY_MISS_ALL, CBO_LLC_LOOKUP_ANY, CBO_TOR_INSERTS_MISS_ALL, CBO_CLOCKTICKS};
+
+    if (set_cbo_filter(CBO_FILTER_STATE_ALL, 0))
+    {
+        return -1;
+    }
+    return set_cbo_events(events, CBO_NUM_CTRS);
+}
+
+int cbo_box_ctrl(int freeze, int reset)
+{
+    struct cbo_data *cd = NULL;
+    int ret;
+
+    cbo_storage(&cd);
+    cbo_set_box_bits(cd, (freeze ? CBO_BOX_FRZ : 0) | (reset ? CBO_BOX_RST_CTRS : 0));
+    ret = write_batch(CBO_CTRL);
+    cbo_set_box_bits(cd, freeze ? CBO_BOX_FRZ : 0);
+    return ret;
+}
+
+int poll_cbo_data(void)
+{
+    static uint64_t sockets = 0;
+    struct cbo_data *cd = NULL;
+    uint64_t mask = MASK_RANGE(CBO_CTR_WIDTH - 1, 0);
+    uint64_t cur;
+    int slice, socket, i, idx;
+
+    if (!sockets)
+    {
+        sockets = num_sockets();
+    }
+    cbo_storage(&cd);
+    if (read_batch(CBO_DATA))
+    {
+        return -1;
+    }
+    cd->old_now = cd->now;
+    gettimeofday(&cd->now, NULL);
+    cd->elapsed = (cd->now.tv_sec - cd->old_now.tv_sec) + (cd->now.tv_usec - cd->old_now.tv_usec) / 1000000.0;
+
+    for (i = 0; i < CBO_NUM_CTRS; i++)
+    {
+        for (socket = 0; socket < sockets; socket++)
+        {
+            cd->socket_delta[i][socket] = 0;
+        }
+        for (slice = 0; slice < cd->num_slices; slice++)
+        {
+            for (socket = 0; socket < sockets; socket++)
+            {
+                idx = slice * sockets + socket;
+                cur = *cd->ctr[i][idx] & mask;
+                cd->delta[i][idx] = ctr_wrap_delta(cur, cd->old_ctr[i][idx], CBO_CTR_WIDTH);
+                cd->old_ctr[i][idx] = cur;
+                cd->socket_delta[i][socket] += cd->delta[i][idx];
+            }
+        }
+    }
+    return 0;
+}
+
+/// @brief Find the counter an event is programmed on.
+///
+/// @return Counter index, else -1 if the event is not programmed.
+static int cbo_find_event(struct cbo_data *cd, enum cbo_event_e event)
+{
+    int i;
+
+    for (i = 0; i < cd->num_events; i++)
+    {
+        if (cd->event[i] == event)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int get_cbo_llc_stats(const unsigned socket, struct cbo_llc_stats *stats)
+{
+    struct cbo_data *cd = NULL;
+    int lookup, miss, occ, clk;
+    uint64_t clocks;
+
+    if (stats == NULL || sockets_assert(&socket, __LINE__, __FILE__))
+    {
+        return -1;
+    }
+    cbo_storage(&cd);
+    lookup = cbo_find_event(cd, CBO_LLC_LOOKUP_ANY);
+    miss = cbo_find_event(cd, CBO_TOR_INSERTS_MISS_ALL);
+    occ = cbo_find_event(cd, CBO_TOR_OCCUPANCY_MISS_ALL);
+    clk = cbo_find_event(cd, CBO_CLOCKTICKS);
+    if (lookup < 0 || miss < 0)
+    {
+        libmsr_error_handler("get_cbo_llc_stats(): LLC lookup and miss events are not programmed", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    stats->lookups = cd->socket_delta[lookup][socket];
+    stats->misses = cd->socket_delta[miss][socket];
+    stats->miss_ratio = (stats->lookups ? (double)stats->misses / stats->lookups : 0.0);
+    stats->avg_miss_occupancy = 0.0;
+    stats->avg_miss_latency = 0.0;
+    if (occ >= 0)
+    {
+        /* Clockticks are summed over all slices; each slice sees every cycle. */
+        clocks = (clk >= 0 ? cd->socket_delta[clk][socket] / cd->num_slices : 0);
+        stats->avg_miss_occupancy = (clocks ? (double)cd->socket_delta[occ][socket] / clocks : 0.0);
+        stats->avg_miss_latency = (stats->misses ? (double)cd->socket_delta[occ][socket] / stats->misses : 0.0);
+    }
+    return 0;
+}
+
+void dump_cbo_data_label(FILE *writedest)
+{
+    struct cbo_data *cd = NULL;
+    int i;
+
+    cbo_storage(&cd);
+    fprintf(writedest, "socket elapsed ");
+    for (i = 0; i < cd->num_events; i++)
+    {
+        fprintf(writedest, "%s ", cbo_event_name(cd->event[i]));
+    }
+    fprintf(writedest, "\n");
+}
+
+void dump_cbo_data(FILE *writedest)
+{
+    static uint64_t sockets = 0;
+    struct cbo_data *cd = NULL;
+    struct cbo_llc_stats stats;
+    int socket, i;
+
+    if (!sockets)
+    {
+        sockets = num_sockets();
+    }
+    cbo_storage(&cd);
+    for (socket = 0; socket < sockets; socket++)
+    {
+        fprintf(writedest, "%d %.6lf ", socket, cd->elapsed);
+        for (i = 0; i < cd->num_events; i++)
+        {
+            fprintf(writedest, "%lu ", cd->socket_delta[i][socket]);
+        }
+        fprintf(writedest, "\n");
+        if (cbo_find_event(cd, CBO_LLC_LOOKUP_ANY) >= 0 && cbo_find_event(cd, CBO_TOR_INSERTS_MISS_ALL) >= 0 && get_cbo_llc_stats(socket, &stats) == 0)
+        {
+            fprintf(writedest, "  LLC miss ratio %6.2lf%%  avg miss latency %8.2lf cycles\n", 100.0 * stats.miss_ratio, stats.avg_miss_latency);
+        }
+    }
+}
@@ -34,11 +34,13 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "msr_core.h"
 #include "msr_clocks.h"
 #include "memhdlr.h"
 #include "cpuid.h"
+#include "libmsr_error.h"
 #include "libmsr_debug.h"
 
 void clocks_storage(struct clocks_data **cd)
@@ -187,6 +189,209 @@ void dump_clocks_data_readable(FILE *writedest)
     }
 }
 
+int freq_hist_storage(struct freq_hist **fh)
+{
+    static int init = 0;
+    static int avail = 0;
+    static struct freq_hist h;
+    uint64_t platform_info;
+
+    if (!init)
+    {
+        init = 1;
+        if (read_msr_by_coord(0, 0, 0, MSR_PLATFORM_INFO, &platform_info))
+        {
+            libmsr_error_handler("freq_hist_storage(): Unable to read MSR_PLATFORM_INFO", LIBMSR_ERROR_MSR_READ, getenv("HOSTNAME"), __FILE__, __LINE__);
+            return -1;
+        }
+        /* The TSC runs at the maximum non-turbo ratio (bits 15:8). */
+        h.tsc_mhz = MASK_VAL(platform_info, 15, 8) * 100;
+        h.num_threads = num_devs();
+        h.bins = (uint32_t *) libmsr_calloc(h.num_threads * FREQ_HIST_NUM_BINS, sizeof(uint32_t));
+        h.idle = (uint32_t *) libmsr_calloc(h.num_threads, sizeof(uint32_t));
+        h.last_aperf = (uint64_t *) libmsr_calloc(h.num_threads, sizeof(uint64_t));
+        h.last_mperf = (uint64_t *) libmsr_calloc(h.num_threads, sizeof(uint64_t));
+        h.primed = 0;
+        h.intervals = 0;
+        clocks_storage(NULL);
+        avail = 1;
+    }
+    if (!avail)
+    {
+        return -1;
+    }
+    if (fh != NULL)
+    {
+        *fh = &h;
+    }
+    return 0;
+}
+
+int freq_hist_update(void)
+{
+    static struct freq_hist *fh = NULL;
+    static struct clocks_data *cd = NULL;
+    uint64_t thread_idx, aperf, mperf, daperf, dmperf, bin;
+
+    if (fh == NULL)
+    {
+        if (freq_hist_storage(&fh))
+        {
+            return -1;
+        }
+        clocks_storage(&cd);
+    }
+    for (thread_idx = 0; thread_idx < fh->num_threads; thread_idx++)
+    {
+        aperf = *cd->aperf[thread_idx];
+        mperf = *cd->mperf[thread_idx];
+        if (fh->primed)
+        {
+            /* Unsigned deltas stay correct across a 64-bit wraparound. */
+            daperf = aperf - fh->last_aperf[thread_idx];
+            dmperf = mperf - fh->last_mperf[thread_idx];
+            if (dmperf == 0)
+            {
+                fh->idle[thread_idx]++;
+            }
+            else
+            {
+                bin = (uint64_t)((double)fh->tsc_mhz * daperf / dmperf) / FREQ_HIST_BIN_MHZ;
+                if (bin >= FREQ_HIST_NUM_BINS)
+                {
+                    bin = FREQ_HIST_NUM_BINS - 1;
+                }
+                fh->bins[thread_idx * FREQ_HIST_NUM_BINS + bin]++;
+            }
+        }
+        fh->last_aperf[thread_idx] = aperf;
+        fh->last_mperf[thread_idx] = mperf;
+    }
+    if (fh->primed)
+    {
+        fh->intervals++;
+    }
+    fh->primed = 1;
+    return 0;
+}
+
+int poll_freq_hist(void)
+{
+    if (freq_hist_storage(NULL))
+    {
+        return -1;
+    }
+    if (read_batch(CLOCKS_DATA))
+    {
+        libmsr_error_handler("poll_freq_hist(): Unable to read CLOCKS_DATA", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    return freq_hist_update();
+}
+
+void freq_hist_reset(void)
+{
+    struct freq_hist *fh = NULL;
+    uint64_t i;
+
+    if (freq_hist_storage(&fh))
+    {
+        return;
+    }
+    for (i = 0; i < fh->num_threads * FREQ_HIST_NUM_BINS; i++)
+    {
+        fh->bins[i] = 0;
+    }
+    for (i = 0; i < fh->num_threads; i++)
+    {
+        fh->idle[i] = 0;
+    }
+    fh->primed = 0;
+    fh->intervals = 0;
+}
+
+void dump_freq_hist_csv(FILE *writedest)
+{
+    struct freq_hist *fh = NULL;
+    uint64_t ncores, coresPerSocket, core, thread_idx, bin, idle, total_idle = 0;
+    uint64_t row[FREQ_HIST_NUM_BINS];
+    uint64_t total[FREQ_HIST_NUM_BINS] = {0};
+    unsigned socket, sock_core, thread;
+
+    if (freq_hist_storage(&fh))
+    {
+        return;
+    }
+    ncores = num_cores();
+    coresPerSocket = cores_per_socket();
+    fprintf(writedest, "core,idle");
+    for (bin = 0; bin < FREQ_HIST_NUM_BINS; bin++)
+    {
+        fprintf(writedest, ",%lu", bin * FREQ_HIST_BIN_MHZ);
+    }
+    fprintf(writedest, "\n");
+    for (core = 0; core < ncores; core++)
+    {
+        idle = 0;
+        for (bin = 0; bin < FREQ_HIST_NUM_BINS; bin++)
+        {
+            row[bin] = 0;
+        }
+        for (thread_idx = 0; thread_idx < fh->num_threads; thread_idx++)
+        {
+            thread_batch_coord(thread_idx, &socket, &sock_core, &thread);
+            if (socket * coresPerSocket + sock_core != core)
+            {
+                continue;
+            }
+            idle += fh->idle[thread_idx];
+            for (bin = 0; bin < FREQ_HIST_NUM_BINS; bin++)
+            {
+                row[bin] += fh->bins[thread_idx * FREQ_HIST_NUM_BINS + bin];
+            }
+        }
+        fprintf(writedest, "%lu,%lu", core, idle);
+        for (bin = 0; bin < FREQ_HIST_NUM_BINS; bin++)
+        {
+            fprintf(writedest, ",%lu", row[bin]);
+            total[bin] += row[bin];
+        }
+        fprintf(writedest, "\n");
+        total_idle += idle;
+    }
+    fprintf(writedest, "all,%lu", total_idle);
+    for (bin = 0; bin < FREQ_HIST_NUM_BINS; bin++)
+    {
+        fprintf(writedest, ",%lu", total[bin]);
+    }
+    fprintf(writedest, "\n");
+}
+
+int dump_freq_hist_binary(FILE *writedest)
+{
+    struct freq_hist *fh = NULL;
+    uint32_t header[6];
+
+    if (freq_hist_storage(&fh))
+    {
+        return -1;
+    }
+    header[0] = 0x54534846; /* "FHST" */
+    header[1] = 1;
+    header[2] = fh->num_threads;
+    header[3] = FREQ_HIST_NUM_BINS;
+    header[4] = FREQ_HIST_BIN_MHZ;
+    header[5] = fh->tsc_mhz;
+    if (fwrite(header, sizeof(uint32_t), 6, writedest) != 6 ||
+        fwrite(fh->idle, sizeof(uint32_t), fh->num_threads, writedest) != fh->num_threads ||
+        fwrite(fh->bins, sizeof(uint32_t), fh->num_threads * FREQ_HIST_NUM_BINS, writedest) != fh->num_threads * FREQ_HIST_NUM_BINS)
+    {
+        libmsr_error_handler("dump_freq_hist_binary(): Unable to write histograms", LIBMSR_ERROR_RUNTIME, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    return 0;
+}
+
 void dump_clock_mod(struct clock_mod *s, FILE *writedest)
 {
     double percent = 0.0;
@@ -38,6 +38,7 @@
 #include <fcntl.h>
 #include <linux/ioctl.h>
 #include <linux/types.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -45,11 +46,13 @@
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "msr_core.h"
 #include "memhdlr.h"
 #include "msr_counters.h"
+#include "msr_region.h"
 #include "cpuid.h"
 #include "libmsr_error.h"
 #include "libmsr_debug.h"
@@ -203,6 +206,28 @@ static int compatibility_batch(int batchnum, int type)
     return 0;
 }
 
+static int batchfd = -1;
+static pthread_once_t batchfd_once = PTHREAD_ONCE_INIT;
+
+/// @brief Open the msr_batch driver once.
+static void open_batch_fd(void)
+{
+    if ((batchfd = open(MSR_BATCH_DIR, O_RDWR)) < 0)
+    {
+        perror(MSR_BATCH_DIR);
+        batchfd = -1;
+    }
+}
+
+/// @brief Retrieve file descriptor of the msr_batch driver.
+///
+/// @return File descriptor, else -1 if /dev/cpu/msr_batch could not be opened.
+static int batch_fd(void)
+{
+    pthread_once(&batchfd_once, open_batch_fd);
+    return batchfd;
+}
+
 /// @brief Execute read/write batch operation on a specific set of batch
 /// registers.
 ///
@@ -214,22 +239,13 @@ static int compatibility_batch(int batchnum, int type)
 /// allocation is for 0 or less operations.
 static int do_batch_op(int batchnum, int type)
 {
-    static int batchfd = 0;
     struct msr_batch_array *batch = NULL;
     int res, i, j;
 
-    if (batchfd == 0)
-    {
-        if ((batchfd = open(MSR_BATCH_DIR, O_RDWR)) < 0)
-        {
-            perror(MSR_BATCH_DIR);
-            batchfd = -1;
-        }
-    }
 #ifdef USE_NO_BATCH
     return compatibility_batch(batchnum, type);
 #endif
-    if (batchfd < 0)
+    if (batch_fd() < 0)
     {
         return compatibility_batch(batchnum, type);
     }
@@ -255,7 +271,7 @@ static int do_batch_op(int batchnum, int type)
             batch->ops[j].isrdmsr = readflag;
         }
     }
-    res = ioctl(batchfd, X86_IOC_MSR_BATCH, batch);
+    res = ioctl(batch_fd(), X86_IOC_MSR_BATCH, batch);
     if (res < 0)
     {
         libmsr_error_handler("do_batch_op(): IOctl failed, does /dev/cpu/msr_batch exist?", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
@@ -698,6 +714,7 @@ int finalize_msr(void)
             }
         }
     }
+    libmsr_region_finalize();
     memhdlr_finalize();
     return 0;
 }
@@ -770,6 +787,71 @@ int read_batch(const int batchnum)
     return do_batch_op(batchnum, BATCH_READ);
 }
 
+int read_batch_array(struct msr_batch_array *batch)
+{
+    int i;
+
+    if (batch == NULL || batch->numops == 0)
+    {
+        libmsr_error_handler("read_batch_array(): Using empty batch", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+#ifndef USE_NO_BATCH
+    if (batch_fd() >= 0)
+    {
+        if (ioctl(batch_fd(), X86_IOC_MSR_BATCH, batch) < 0)
+        {
+            libmsr_error_handler("read_batch_array(): IOctl failed, does /dev/cpu/msr_batch exist?", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+            return -1;
+        }
+        return 0;
+    }
+#endif
+    for (i = 0; i < batch->numops; i++)
+    {
+        if (read_msr_by_idx(batch->ops[i].cpu, batch->ops[i].msr, (uint64_t *) &batch->ops[i].msrdata))
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+uint64_t socket_batch_idx(unsigned socket)
+{
+    uint64_t coresPerSocket, threadsPerCore, sockets;
+
+    if (CPU_DEV_VER == 1)
+    {
+        core_config(&coresPerSocket, &threadsPerCore, &sockets, NULL);
+        return socket * coresPerSocket * threadsPerCore;
+    }
+    return socket;
+}
+
+double monotonic_time(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1.0e9;
+}
+
+uint64_t ctr_wrap_delta(uint64_t cur, uint64_t last, int width)
+{
+    uint64_t mask = (width > 0 && width < 64 ? (((uint64_t)1) << width) - 1 : ~((uint64_t)0));
+
+    return (cur - last) & mask;
+}
+
+uint64_t read_tsc(void)
+{
+    uint32_t lo, hi;
+
+    asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
 int write_batch(const int batchnum)
 {
     return do_batch_op(batchnum, BATCH_WRITE);
@@ -903,6 +985,40 @@ int load_thread_batch(off_t msr, uint64_t **val, int batchnum)
     return 0;
 }
 
+int thread_batch_coord(uint64_t idx, unsigned *socket, unsigned *core, unsigned *thread)
+{
+    static uint64_t coresPerSocket = 0;
+    static uint64_t threadsPerCore = 0;
+    static uint64_t sockets = 0;
+    uint64_t local;
+
+    if (coresPerSocket == 0 || threadsPerCore == 0)
+    {
+        core_config(&coresPerSocket, &threadsPerCore, &sockets, NULL);
+    }
+    if (idx >= NUM_DEVS)
+    {
+        libmsr_error_handler("thread_batch_coord(): Array reference out of bounds", LIBMSR_ERROR_ARRAY_BOUNDS, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    /* Mirrors the loading order of load_thread_batch(). */
+    if (CPU_DEV_VER == 1)
+    {
+        local = idx % (sockets * coresPerSocket);
+        *socket = local / coresPerSocket;
+        *core = local % coresPerSocket;
+        *thread = idx / (sockets * coresPerSocket);
+    }
+    else
+    {
+        local = idx % (coresPerSocket * threadsPerCore);
+        *socket = idx / (coresPerSocket * threadsPerCore);
+        *core = local % coresPerSocket;
+        *thread = local / coresPerSocket;
+    }
+    return 0;
+}
+
 int read_msr_by_idx(int dev_idx, off_t msr, uint64_t *val)
 {
     int rc;
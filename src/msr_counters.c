@@ -42,6 +42,13 @@
 #include "cpuid.h"
 #include "libmsr_debug.h"
 
+/// @brief Non-zero once init_counter_overflow() has taken a baseline, after
+/// which counter reads go through the overflow tracking batch.
+static int counter_ovf_active = 0;
+
+static int read_counter_batch(int batchnum);
+static void rebase_counter_overflow(int batchnum);
+
 void print_available_counters(void)
 {
     fprintf(stdout, "IA32_FIXED_CTR_CTRL, 38Dh\nIA32_PERF_GLOBAL_CTRL, 38Fh\nIA32_PERF_GLOBAL_STATUS, 38Eh\n");
@@ -351,6 +358,7 @@ void clear_all_pmc(void)
         }
     }
     write_batch(COUNTERS_DATA);
+    rebase_counter_overflow(COUNTERS_DATA);
 }
 
 int clear_pmc(int idx)
@@ -406,7 +414,7 @@ void dump_pmc_data_readable(FILE *writedest)
         numDevs = num_devs();
         pmc_storage(&p);
     }
-    read_batch(COUNTERS_DATA);
+    read_counter_batch(COUNTERS_DATA);
     fprintf(writedest, "PMC Counters:\n");
     for (i = 0; i < numDevs; i++)
     {
@@ -600,15 +608,17 @@ int clear_pcu(int idx)
         sockets = num_sockets();
         unc_counters_storage(&uc);
     }
-    if (idx < sockets)
-    {
-        uc->c0[idx] = 0;
-    }
-    else
+    if (idx >= sockets)
     {
         return -1;
     }
-    //write_batch(UNCORE_COUNT);
+    /* Refresh the other sockets so the write leaves them unchanged. */
+    read_batch(UNCORE_COUNT);
+    *uc->c0[idx] = 0;
+    *uc->c1[idx] = 0;
+    *uc->c2[idx] = 0;
+    *uc->c3[idx] = 0;
+    write_batch(UNCORE_COUNT);
     return 0;
 }
 
@@ -700,7 +710,8 @@ void init_fixed_counter(struct fixed_counter *ctr)
     ctr->ring_level = (uint64_t *) libmsr_malloc(totalThreads * sizeof(uint64_t));
     ctr->anyThread = (uint64_t *) libmsr_malloc(totalThreads * sizeof(uint64_t));
     ctr->pmi = (uint64_t *) libmsr_malloc(totalThreads * sizeof(uint64_t));
-    ctr->overflow = (uint64_t *) libmsr_malloc(totalThreads * sizeof(uint64_t));
+    ctr->overflow = (uint64_t *) libmsr_calloc(totalThreads, sizeof(uint64_t));
+    ctr->accumulated = (uint64_t *) libmsr_calloc(totalThreads, sizeof(uint64_t));
     ctr->value = (uint64_t **) libmsr_malloc(totalThreads * sizeof(uint64_t *));
 }
 
@@ -782,6 +793,7 @@ void set_fixed_counter_ctrl(struct fixed_counter *ctr0, struct fixed_counter *ct
     }
     write_batch(FIXED_COUNTERS_CTR_DATA);
     write_batch(FIXED_COUNTERS_DATA);
+    rebase_counter_overflow(FIXED_COUNTERS_DATA);
 }
 
 void get_fixed_counter_config(struct fixed_counter_config *data)
@@ -812,6 +824,47 @@ void enable_fixed_counters(void)
     set_fixed_counter_ctrl(c0, c1, c2);
 }
 
+int ensure_fixed_counters(void)
+{
+    static uint64_t totalThreads = 0;
+    static uint64_t **perf_global_ctrl = NULL;
+    static uint64_t **fixed_ctr_ctrl = NULL;
+    int changed = 0;
+    int i, j;
+
+    if (!totalThreads)
+    {
+        totalThreads = num_devs();
+        fixed_counter_ctrl_storage(&perf_global_ctrl, &fixed_ctr_ctrl);
+    }
+    if (read_batch(FIXED_COUNTERS_CTR_DATA))
+    {
+        return -1;
+    }
+    for (i = 0; i < totalThreads; i++)
+    {
+        for (j = 0; j < 3; j++)
+        {
+            /* A counter counts when enabled globally and in some ring. */
+            if (MASK_VAL(*perf_global_ctrl[i], 32 + j, 32 + j) && MASK_VAL(*fixed_ctr_ctrl[i], 4 * j + 1, 4 * j))
+            {
+                continue;
+            }
+            *perf_global_ctrl[i] |= 1ULL << (32 + j);
+            /* Same settings as enable_fixed_counters(): usr + os, any thread,
+             * no PMI. */
+            *fixed_ctr_ctrl[i] = (*fixed_ctr_ctrl[i] & ~(0xFULL << (4 * j))) | (0x7ULL << (4 * j));
+            changed = 1;
+        }
+    }
+    /* Counter values are left alone so running measurements stay valid. */
+    if (changed && write_batch(FIXED_COUNTERS_CTR_DATA))
+    {
+        return -1;
+    }
+    return 0;
+}
+
 void disable_fixed_counters(void)
 {
     static uint64_t totalThreads = 0;
@@ -846,7 +899,7 @@ void dump_fixed_counter_data_terse(FILE *writedest)
     }
     fixed_counter_storage(&c0, &c1, &c2);
 
-    read_batch(FIXED_COUNTERS_DATA);
+    read_counter_batch(FIXED_COUNTERS_DATA);
     for (i = 0; i < totalThreads; i++)
     {
         fprintf(writedest, "%lu %lu %lu ", *c0->value[i], *c1->value[i], *c2->value[i]);
@@ -890,9 +943,367 @@ void dump_fixed_counter_data_readable(FILE *writedest)
     }
     fixed_counter_storage(&c0, &c1, &c2);
 
-    read_batch(FIXED_COUNTERS_DATA);
+    read_counter_batch(FIXED_COUNTERS_DATA);
     for (i = 0; i < totalThreads; i++)
     {
         fprintf(writedest, "IR%02d: %lu UCC%02d:%lu URC%02d:%lu\n", i, *c0->value[i], i, *c1->value[i], i, *c2->value[i]);
     }
 }
+
+/********************/
+/* Counter Overflow */
+/********************/
+
+/// @brief Structure containing batch pointers and previous raw values used to
+/// track counter overflow.
+struct counter_ovf_state {
+    /// @brief Number of general-purpose performance counters tracked.
+    int avail;
+    /// @brief Raw 64-bit value stored in IA32_PERF_GLOBAL_STATUS.
+    uint64_t **status;
+    /// @brief Raw 64-bit value to be written to IA32_PERF_GLOBAL_OVF_CTRL.
+    uint64_t **ovf_ctrl;
+    /// @brief Raw 64-bit value stored in IA32_FIXED_CTR[0-2].
+    uint64_t **fixed[3];
+    /// @brief Raw 64-bit value stored in IA32_PMC[0-7].
+    uint64_t **pmc[8];
+    /// @brief IA32_FIXED_CTR[0-2] value at the previous poll.
+    uint64_t *last_fixed[3];
+    /// @brief IA32_PMC[0-7] value at the previous poll.
+    uint64_t *last_pmc[8];
+    /// @brief Overflow of IA32_FIXED_CTR[0-2] flagged without a visible wrap,
+    /// credited at the next poll.
+    uint8_t *pending_fixed[3];
+    /// @brief Overflow of IA32_PMC[0-7] flagged without a visible wrap,
+    /// credited at the next poll.
+    uint8_t *pending_pmc[8];
+};
+
+/// @brief Initialize the batches and storage used to track counter overflow.
+///
+/// @return Pointer to overflow tracking state.
+static struct counter_ovf_state *counter_ovf_storage(void)
+{
+    static const off_t pmcs[8] = {IA32_PMC0, IA32_PMC1, IA32_PMC2, IA32_PMC3, IA32_PMC4, IA32_PMC5, IA32_PMC6, IA32_PMC7};
+    static const off_t fixed[3] = {IA32_FIXED_CTR0, IA32_FIXED_CTR1, IA32_FIXED_CTR2};
+    static struct counter_ovf_state st;
+    static int init = 0;
+    uint64_t numDevs;
+    int i;
+
+    if (!init)
+    {
+        numDevs = num_devs();
+        st.avail = cpuid_num_pmc();
+        if (st.avail < 0)
+        {
+            st.avail = 0;
+        }
+        if (st.avail > 8)
+        {
+            st.avail = 8;
+        }
+        st.status = (uint64_t **) libmsr_calloc(numDevs, sizeof(uint64_t *));
+        st.ovf_ctrl = (uint64_t **) libmsr_calloc(numDevs, sizeof(uint64_t *));
+        allocate_batch(COUNTERS_OVF_DATA, (1UL + 3 + st.avail) * numDevs);
+        for (i = 0; i < 3; i++)
+        {
+            st.fixed[i] = (uint64_t **) libmsr_calloc(numDevs, sizeof(uint64_t *));
+            st.last_fixed[i] = (uint64_t *) libmsr_calloc(numDevs, sizeof(uint64_t));
+            st.pending_fixed[i] = (uint8_t *) libmsr_calloc(numDevs, sizeof(uint8_t));
+            load_thread_batch(fixed[i], st.fixed[i], COUNTERS_OVF_DATA);
+        }
+        for (i = 0; i < st.avail; i++)
+        {
+            st.pmc[i] = (uint64_t **) libmsr_calloc(numDevs, sizeof(uint64_t *));
+            st.last_pmc[i] = (uint64_t *) libmsr_calloc(numDevs, sizeof(uint64_t));
+            st.pending_pmc[i] = (uint8_t *) libmsr_calloc(numDevs, sizeof(uint8_t));
+            load_thread_batch(pmcs[i], st.pmc[i], COUNTERS_OVF_DATA);
+        }
+        /* Status is read after every counter, so an overflow that lands in
+         * between is flagged against a pre-wrap value. counter_delta() holds
+         * such a flag until the next poll instead of crediting it twice. */
+        load_thread_batch(IA32_PERF_GLOBAL_STATUS, st.status, COUNTERS_OVF_DATA);
+        allocate_batch(COUNTERS_OVF_CTRL, numDevs);
+        load_thread_batch(IA32_PERF_GLOBAL_OVF_CTRL, st.ovf_ctrl, COUNTERS_OVF_CTRL);
+        init = 1;
+    }
+    return &st;
+}
+
+void pmc_accumulated_storage(struct pmc_accumulated **a)
+{
+    static struct pmc_accumulated acc;
+    static int init = 0;
+    uint64_t numDevs;
+    int avail;
+    int i;
+
+    if (!init)
+    {
+        numDevs = num_devs();
+        avail = counter_ovf_storage()->avail;
+        for (i = 0; i < avail; i++)
+        {
+            acc.value[i] = (uint64_t *) libmsr_calloc(numDevs, sizeof(uint64_t));
+            acc.overflow[i] = (uint64_t *) libmsr_calloc(numDevs, sizeof(uint64_t));
+        }
+        init = 1;
+    }
+    if (a != NULL)
+    {
+        *a = &acc;
+    }
+}
+
+/// @brief Clear the counter overflow bits set in IA32_PERF_GLOBAL_STATUS on
+/// every logical processor with one batched write.
+///
+/// @param [in] st Overflow tracking state holding the last status read.
+///
+/// @param [in] mask Overflow bits owned by the tracked counters.
+///
+/// @return 0 if nothing was pending or the write succeeded, else -1.
+static int clear_counter_overflow(struct counter_ovf_state *st, uint64_t mask)
+{
+    static uint64_t numDevs = 0;
+    uint64_t pending = 0;
+    int i;
+
+    if (!numDevs)
+    {
+        numDevs = num_devs();
+    }
+    for (i = 0; i < numDevs; i++)
+    {
+        *st->ovf_ctrl[i] = *st->status[i] & mask;
+        pending |= *st->ovf_ctrl[i];
+    }
+    if (!pending)
+    {
+        return 0;
+    }
+    return write_batch(COUNTERS_OVF_CTRL);
+}
+
+int init_counter_overflow(void)
+{
+    static uint64_t numDevs = 0;
+    static uint64_t mask = 0;
+    struct counter_ovf_state *st = counter_ovf_storage();
+    struct fixed_counter *c[3];
+    struct pmc_accumulated *acc;
+    int i, j;
+
+    if (!numDevs)
+    {
+        numDevs = num_devs();
+        mask = MASK_RANGE(34, 32) | (st->avail ? MASK_RANGE(st->avail - 1, 0) : 0);
+    }
+    fixed_counter_storage(&c[0], &c[1], &c[2]);
+    pmc_accumulated_storage(&acc);
+
+    if (read_batch(COUNTERS_OVF_DATA))
+    {
+        return -1;
+    }
+    for (i = 0; i < numDevs; i++)
+    {
+        for (j = 0; j < 3; j++)
+        {
+            st->last_fixed[j][i] = *st->fixed[j][i];
+            st->pending_fixed[j][i] = 0;
+            c[j]->accumulated[i] = 0;
+            c[j]->overflow[i] = 0;
+        }
+        for (j = 0; j < st->avail; j++)
+        {
+            st->last_pmc[j][i] = *st->pmc[j][i];
+            st->pending_pmc[j][i] = 0;
+            acc->value[j][i] = 0;
+            acc->overflow[j][i] = 0;
+        }
+    }
+    counter_ovf_active = 1;
+    return clear_counter_overflow(st, mask);
+}
+
+/// @brief Compute elapsed count of a counter between two reads.
+///
+/// @param [in] cur Current raw counter value.
+///
+/// @param [in] last Raw counter value at the previous read.
+///
+/// @param [in] width Bit width of the counter.
+///
+/// @param [in] ovf Overflow bit of the counter in IA32_PERF_GLOBAL_STATUS,
+/// read after the counter.
+///
+/// @param [in,out] pending Overflow flagged at the previous poll without a
+/// visible wrap.
+///
+/// @return Elapsed count. The masked difference already covers one wrap. An
+/// overflow flagged while the counter has not visibly wrapped either
+/// happened after the counter was read, in which case the next poll shows
+/// the wrap, or is a full extra wrap. It is held in pending and a full span
+/// is credited only if the next poll still shows no wrap.
+static uint64_t counter_delta(uint64_t cur, uint64_t last, int width, int ovf, uint8_t *pending)
+{
+    uint64_t span = (width > 0 && width < 64 ? ((uint64_t)1) << width : 0);
+    uint64_t delta = (cur - last) & (span - 1);
+    int wrapped = (cur < last);
+
+    if (*pending && !wrapped)
+    {
+        delta += span;
+    }
+    *pending = (ovf && !wrapped);
+    return delta;
+}
+
+int poll_counter_overflow(void)
+{
+    static uint64_t numDevs = 0;
+    static uint64_t mask = 0;
+    static int fixed_width = 0;
+    static int pmc_width = 0;
+    static struct fixed_counter *c[3];
+    static struct pmc_accumulated *acc = NULL;
+    struct counter_ovf_state *st = counter_ovf_storage();
+    uint64_t status, cur;
+    int i, j, ovf;
+
+    if (!numDevs)
+    {
+        numDevs = num_devs();
+        mask = MASK_RANGE(34, 32) | (st->avail ? MASK_RANGE(st->avail - 1, 0) : 0);
+        fixed_width = cpuid_width_fixed_counters();
+        pmc_width = cpuid_width_pmc();
+        fixed_counter_storage(&c[0], &c[1], &c[2]);
+        pmc_accumulated_storage(&acc);
+    }
+    if (read_batch(COUNTERS_OVF_DATA))
+    {
+        return -1;
+    }
+    for (i = 0; i < numDevs; i++)
+    {
+        status = *st->status[i];
+        for (j = 0; j < 3; j++)
+        {
+            cur = *st->fixed[j][i];
+            ovf = MASK_VAL(status, 32 + j, 32 + j);
+            c[j]->accumulated[i] += counter_delta(cur, st->last_fixed[j][i], fixed_width, ovf, &st->pending_fixed[j][i]);
+            c[j]->overflow[i] += ovf;
+            st->last_fixed[j][i] = cur;
+        }
+        for (j = 0; j < st->avail; j++)
+        {
+            cur = *st->pmc[j][i];
+            ovf = MASK_VAL(status, j, j);
+            acc->value[j][i] += counter_delta(cur, st->last_pmc[j][i], pmc_width, ovf, &st->pending_pmc[j][i]);
+            acc->overflow[j][i] += ovf;
+            st->last_pmc[j][i] = cur;
+        }
+    }
+    return clear_counter_overflow(st, mask);
+}
+
+/// @brief Read the fixed-function or general-purpose counters.
+///
+/// Once overflow tracking is active, the counters are read through
+/// poll_counter_overflow() instead, so every read also folds overflows into
+/// the accumulated values, and the raw values are copied to the
+/// FIXED_COUNTERS_DATA or COUNTERS_DATA storage.
+///
+/// @param [in] batchnum FIXED_COUNTERS_DATA or COUNTERS_DATA.
+///
+/// @return 0 if successful, else -1 if batch operations fail.
+static int read_counter_batch(int batchnum)
+{
+    struct counter_ovf_state *st;
+    struct fixed_counter *c[3];
+    struct pmc *p;
+    uint64_t **pmcs[8];
+    uint64_t numDevs;
+    int i, j;
+
+    if (!counter_ovf_active)
+    {
+        return read_batch(batchnum);
+    }
+    if (poll_counter_overflow())
+    {
+        return -1;
+    }
+    st = counter_ovf_storage();
+    numDevs = num_devs();
+    if (batchnum == FIXED_COUNTERS_DATA)
+    {
+        fixed_counter_storage(&c[0], &c[1], &c[2]);
+        for (j = 0; j < 3; j++)
+        {
+            for (i = 0; i < numDevs; i++)
+            {
+                *c[j]->value[i] = *st->fixed[j][i];
+            }
+        }
+    }
+    else if (batchnum == COUNTERS_DATA)
+    {
+        pmc_storage(&p);
+        pmcs[0] = p->pmc0;
+        pmcs[1] = p->pmc1;
+        pmcs[2] = p->pmc2;
+        pmcs[3] = p->pmc3;
+        pmcs[4] = p->pmc4;
+        pmcs[5] = p->pmc5;
+        pmcs[6] = p->pmc6;
+        pmcs[7] = p->pmc7;
+        for (j = 0; j < st->avail; j++)
+        {
+            for (i = 0; i < numDevs; i++)
+            {
+                *pmcs[j][i] = *st->pmc[j][i];
+            }
+        }
+    }
+    return 0;
+}
+
+/// @brief Reset the overflow tracking baseline of counters that were just
+/// zeroed, so the next poll does not read the reset as a wrap.
+///
+/// @param [in] batchnum FIXED_COUNTERS_DATA or COUNTERS_DATA.
+static void rebase_counter_overflow(int batchnum)
+{
+    struct counter_ovf_state *st;
+    uint64_t numDevs;
+    int i, j;
+
+    if (!counter_ovf_active)
+    {
+        return;
+    }
+    st = counter_ovf_storage();
+    numDevs = num_devs();
+    for (i = 0; i < numDevs; i++)
+    {
+        if (batchnum == FIXED_COUNTERS_DATA)
+        {
+            for (j = 0; j < 3; j++)
+            {
+                st->last_fixed[j][i] = 0;
+                st->pending_fixed[j][i] = 0;
+            }
+        }
+        else if (batchnum == COUNTERS_DATA)
+        {
+            for (j = 0; j < st->avail; j++)
+            {
+                st->last_pmc[j][i] = 0;
+                st->pending_pmc[j][i] = 0;
+            }
+        }
+    }
+}
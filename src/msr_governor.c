@@ -0,0 +1,319 @@
+/* msr_governor.c
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "msr_core.h"
+#include "msr_counters.h"
+#include "msr_governor.h"
+#include "msr_pstate.h"
+#include "cpuid.h"
+#include "memhdlr.h"
+#include "libmsr_error.h"
+#include "libmsr_debug.h"
+
+/// @brief Number of registers sampled per logical processor.
+#define GOVERNOR_NUM_REGS 5
+
+static pthread_t governor_thread;
+static volatile int governor_running = 0;
+static struct governor_config governor_cfg;
+
+void governor_storage(struct governor_data **gd)
+{
+    static int init = 0;
+    static struct governor_data d;
+    uint64_t cpu;
+
+    if (!init)
+    {
+        init = 1;
+        d.num_threads = num_devs();
+        d.aperf = (uint64_t **) libmsr_malloc(d.num_threads * sizeof(uint64_t *));
+        d.mperf = (uint64_t **) libmsr_malloc(d.num_threads * sizeof(uint64_t *));
+        d.tsc = (uint64_t **) libmsr_malloc(d.num_threads * sizeof(uint64_t *));
+        d.inst = (uint64_t **) libmsr_malloc(d.num_threads * sizeof(uint64_t *));
+        d.clk = (uint64_t **) libmsr_malloc(d.num_threads * sizeof(uint64_t *));
+        d.old = (uint64_t *) libmsr_calloc(GOVERNOR_NUM_REGS * d.num_threads, sizeof(uint64_t));
+        d.sample = (struct governor_sample *) libmsr_calloc(d.num_threads, sizeof(struct governor_sample));
+        d.ratio = (uint64_t *) libmsr_calloc(d.num_threads, sizeof(uint64_t));
+        d.old_time = 0.0;
+        d.intervals = 0;
+        allocate_batch(GOVERNOR_DATA, GOVERNOR_NUM_REGS * d.num_threads);
+        /* Load by device index so entry i is Linux CPU i, as in the
+         * PSTATE_CTL batch. */
+        for (cpu = 0; cpu < d.num_threads; cpu++)
+        {
+            create_batch_op(IA32_APERF, cpu, &d.aperf[cpu], GOVERNOR_DATA);
+            create_batch_op(IA32_MPERF, cpu, &d.mperf[cpu], GOVERNOR_DATA);
+            create_batch_op(IA32_TIME_STAMP_COUNTER, cpu, &d.tsc[cpu], GOVERNOR_DATA);
+            create_batch_op(IA32_FIXED_CTR0, cpu, &d.inst[cpu], GOVERNOR_DATA);
+            create_batch_op(IA32_FIXED_CTR1, cpu, &d.clk[cpu], GOVERNOR_DATA);
+        }
+    }
+    if (gd != NULL)
+    {
+        *gd = &d;
+    }
+}
+
+int governor_default_config(struct governor_config *cfg)
+{
+    uint64_t platform_info;
+
+    if (read_msr_by_coord(0, 0, 0, MSR_PLATFORM_INFO, &platform_info))
+    {
+        libmsr_error_handler("governor_default_config(): Unable to read MSR_PLATFORM_INFO", LIBMSR_ERROR_MSR_READ, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    cfg->interval_us = 10000;
+    cfg->max_perf_loss = 0.05;
+    /* Max efficiency ratio (bits 47:40) and max non-turbo ratio (15:8). */
+    cfg->min_ratio = MASK_VAL(platform_info, 47, 40);
+    cfg->max_ratio = MASK_VAL(platform_info, 15, 8);
+    cfg->cpu = -1;
+    cfg->policy = governor_default_policy;
+    cfg->policy_arg = NULL;
+    return 0;
+}
+
+uint64_t governor_default_policy(uint64_t cpu, const struct governor_sample *s, const struct governor_config *cfg)
+{
+    double fcur, stall, bound;
+    uint64_t ratio;
+
+    fcur = s->freq / 100.0;
+    if (s->c0 < 0.01 || fcur <= 0.0 || cfg->max_ratio == 0)
+    {
+        return 0;
+    }
+    stall = s->stall < 0.0 ? 0.0 : (s->stall > 1.0 ? 1.0 : s->stall);
+    /* Time relative to the last interval is (1 - stall) * fcur / f + stall;
+     * bound it by (1 + loss) times the time at max_ratio and solve for f. */
+    bound = (1.0 + cfg->max_perf_loss) * ((1.0 - stall) * fcur / cfg->max_ratio + stall) - stall;
+    if (bound <= 0.0)
+    {
+        return cfg->min_ratio;
+    }
+    ratio = (uint64_t) ceil((1.0 - stall) * fcur / bound);
+    if (ratio < cfg->min_ratio)
+    {
+        ratio = cfg->min_ratio;
+    }
+    if (ratio > cfg->max_ratio)
+    {
+        ratio = cfg->max_ratio;
+    }
+    return ratio;
+}
+
+int governor_step(const struct governor_config *cfg)
+{
+    static struct governor_data *gd = NULL;
+    static uint64_t ctr_mask = 0;
+    uint64_t cpu, *old;
+    uint64_t d_aperf, d_mperf, d_tsc, d_inst, d_clk;
+    double now, elapsed;
+    int baseline;
+
+    if (gd == NULL)
+    {
+        governor_storage(&gd);
+        ctr_mask = (cpuid_width_fixed_counters() >= 64 ? ~0ULL : (1ULL << cpuid_width_fixed_counters()) - 1);
+    }
+    if (read_batch(GOVERNOR_DATA))
+    {
+        libmsr_error_handler("governor_step(): Unable to read counters", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    now = monotonic_time();
+    elapsed = now - gd->old_time;
+    baseline = (gd->old_time == 0.0);
+    for (cpu = 0; cpu < gd->num_threads; cpu++)
+    {
+        old = &gd->old[GOVERNOR_NUM_REGS * cpu];
+        d_aperf = *gd->aperf[cpu] - old[0];
+        d_mperf = *gd->mperf[cpu] - old[1];
+        d_tsc = *gd->tsc[cpu] - old[2];
+        d_inst = (*gd->inst[cpu] - old[3]) & ctr_mask;
+        d_clk = (*gd->clk[cpu] - old[4]) & ctr_mask;
+        old[0] = *gd->aperf[cpu];
+        old[1] = *gd->mperf[cpu];
+        old[2] = *gd->tsc[cpu];
+        old[3] = *gd->inst[cpu];
+        old[4] = *gd->clk[cpu];
+        if (baseline)
+        {
+            continue;
+        }
+        gd->sample[cpu].freq = (d_mperf && elapsed > 0.0 ? (d_tsc / elapsed) * ((double) d_aperf / d_mperf) / 1.0e6 : 0.0);
+        gd->sample[cpu].c0 = (d_tsc ? (double) d_mperf / d_tsc : 0.0);
+        gd->sample[cpu].ipc = (d_clk ? (double) d_inst / d_clk : 0.0);
+        gd->sample[cpu].stall = 1.0 - gd->sample[cpu].ipc / GOVERNOR_PEAK_IPC;
+        if (gd->ratio[cpu])
+        {
+            gd->sample[cpu].ratio = gd->ratio[cpu];
+        }
+        gd->ratio[cpu] = cfg->policy(cpu, &gd->sample[cpu], cfg);
+    }
+    gd->old_time = now;
+    if (baseline)
+    {
+        return 0;
+    }
+    gd->intervals++;
+    /* One batched IA32_PERF_CTL write for every logical processor. */
+    if (set_pstate_array(gd->ratio, 0) < 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/// @brief Body of the governor thread: sleep one interval, then step.
+static void *governor_loop(void *arg)
+{
+    struct timespec interval;
+
+    interval.tv_sec = governor_cfg.interval_us / 1000000;
+    interval.tv_nsec = (governor_cfg.interval_us % 1000000) * 1000;
+    while (governor_running)
+    {
+        nanosleep(&interval, NULL);
+        if (governor_running)
+        {
+            governor_step(&governor_cfg);
+        }
+    }
+    return NULL;
+}
+
+int governor_start(const struct governor_config *cfg)
+{
+    struct governor_data *gd = NULL;
+    struct pstate_data *pd = NULL;
+    pthread_attr_t attr;
+    cpu_set_t cpus;
+    uint64_t cpu;
+    int ret;
+
+    if (governor_running)
+    {
+        libmsr_error_handler("governor_start(): Governor is already running", LIBMSR_ERROR_RUNTIME, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    if (cfg == NULL || cfg->policy == NULL || cfg->interval_us == 0 || cfg->min_ratio > cfg->max_ratio || cfg->max_perf_loss < 0.0)
+    {
+        libmsr_error_handler("governor_start(): Invalid governor configuration", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    governor_cfg = *cfg;
+    governor_storage(&gd);
+    pstate_storage(&pd);
+    /* Do not reset counters that regions or other users are measuring. */
+    if (ensure_fixed_counters())
+    {
+        return -1;
+    }
+    /* Seed the requested ratios from the current IA32_PERF_CTL. */
+    pstate_lock();
+    for (cpu = 0; cpu < gd->num_threads; cpu++)
+    {
+        gd->sample[cpu].ratio = PSTATE_CTL_RATIO(*pd->ctl[cpu]);
+        gd->ratio[cpu] = 0;
+    }
+    pstate_unlock();
+    gd->old_time = 0.0;
+    if (governor_step(&governor_cfg))
+    {
+        return -1;
+    }
+
+    pthread_attr_init(&attr);
+    if (governor_cfg.cpu >= 0)
+    {
+        CPU_ZERO(&cpus);
+        CPU_SET(governor_cfg.cpu, &cpus);
+        if (pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpus))
+        {
+            pthread_attr_destroy(&attr);
+            libmsr_error_handler("governor_start(): Unable to pin governor thread", LIBMSR_ERROR_RUNTIME, getenv("HOSTNAME"), __FILE__, __LINE__);
+            return -1;
+        }
+    }
+    governor_running = 1;
+    ret = pthread_create(&governor_thread, &attr, governor_loop, NULL);
+    pthread_attr_destroy(&attr);
+    if (ret)
+    {
+        governor_running = 0;
+        libmsr_error_handler("governor_start(): Unable to start governor thread", LIBMSR_ERROR_RUNTIME, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    return 0;
+}
+
+int governor_stop(void)
+{
+    if (!governor_running)
+    {
+        libmsr_error_handler("governor_stop(): Governor is not running", LIBMSR_ERROR_RUNTIME, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    governor_running = 0;
+    pthread_join(governor_thread, NULL);
+    return 0;
+}
+
+void dump_governor_data(FILE *writedest)
+{
+    static struct governor_data *gd = NULL;
+    uint64_t cpu;
+
+    if (gd == NULL)
+    {
+        governor_storage(&gd);
+    }
+    fprintf(writedest, "interval %lu\n", gd->intervals);
+    for (cpu = 0; cpu < gd->num_threads; cpu++)
+    {
+        fprintf(writedest, "cpu%02lu: freq %7.1f MHz c0 %5.3f ipc %5.3f stall %5.3f ratio %3lu -> %3lu\n", cpu, gd->sample[cpu].freq, gd->sample[cpu].c0, gd->sample[cpu].ipc, gd->sample[cpu].stall, gd->sample[cpu].ratio, gd->ratio[cpu]);
+    }
+}
@@ -0,0 +1,524 @@
+/* msr_hwp.c
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cpuid.h"
+#include "msr_core.h"
+#include "msr_hwp.h"
+#include "memhdlr.h"
+#include "libmsr_error.h"
+#include "libmsr_debug.h"
+
+int hwp_storage(struct hwp_data **hd)
+{
+    static int init = 0;
+    static int avail = 0;
+    static struct hwp_data d;
+    uint64_t cpu, socket;
+
+    if (!init)
+    {
+        init = 1;
+        d.hwp_avail = cpuid_hwp_avail();
+        d.epp_avail = d.hwp_avail && cpuid_hwp_epp_avail();
+        d.pkg_avail = d.hwp_avail && cpuid_hwp_pkg_request_avail();
+        d.epb_avail = cpuid_energy_perf_bias_avail();
+        if (!d.hwp_avail && !d.epb_avail)
+        {
+            libmsr_error_handler("hwp_storage(): Neither HWP nor IA32_ENERGY_PERF_BIAS is available", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+            return -1;
+        }
+        d.num_threads = num_devs();
+        d.num_sockets = num_sockets();
+        d.hwp_enabled = 0;
+        if (d.hwp_avail)
+        {
+            d.pm_enable = (uint64_t **) libmsr_calloc(d.num_sockets, sizeof(uint64_t *));
+            d.cap = (uint64_t **) libmsr_malloc(d.num_threads * sizeof(uint64_t *));
+            d.req = (uint64_t **) libmsr_malloc(d.num_threads * sizeof(uint64_t *));
+            allocate_batch(HWP_ENABLE, d.num_sockets);
+            allocate_batch(HWP_CAP, d.num_threads);
+            allocate_batch(HWP_REQ, d.num_threads);
+            load_socket_batch(IA32_PM_ENABLE, d.pm_enable, HWP_ENABLE);
+            /* Load by device index rather than with load_thread_batch() so
+             * the batch order matches the Linux CPU numbering of CPU
+             * masks. */
+            for (cpu = 0; cpu < d.num_threads; cpu++)
+            {
+                create_batch_op(IA32_HWP_CAPABILITIES, cpu, &d.cap[cpu], HWP_CAP);
+                create_batch_op(IA32_HWP_REQUEST, cpu, &d.req[cpu], HWP_REQ);
+            }
+            if (d.pkg_avail)
+            {
+                d.pkg_req = (uint64_t **) libmsr_calloc(d.num_sockets, sizeof(uint64_t *));
+                allocate_batch(HWP_PKG_REQ, d.num_sockets);
+                load_socket_batch(IA32_HWP_REQUEST_PKG, d.pkg_req, HWP_PKG_REQ);
+            }
+            if (read_batch(HWP_ENABLE) == 0)
+            {
+                d.hwp_enabled = 1;
+                for (socket = 0; socket < d.num_sockets; socket++)
+                {
+                    d.hwp_enabled &= (*d.pm_enable[socket] & 1);
+                }
+            }
+        }
+        if (d.epb_avail)
+        {
+            d.epb = (uint64_t **) libmsr_malloc(d.num_threads * sizeof(uint64_t *));
+            allocate_batch(EPB_CTL, d.num_threads);
+            for (cpu = 0; cpu < d.num_threads; cpu++)
+            {
+                create_batch_op(IA32_ENERGY_PERF_BIAS, cpu, &d.epb[cpu], EPB_CTL);
+            }
+        }
+        avail = 1;
+        hwp_sync();
+    }
+    if (!avail)
+    {
+        return -1;
+    }
+    if (hd != NULL)
+    {
+        *hd = &d;
+    }
+    return 0;
+}
+
+/// @brief Check that HWP is enabled before touching registers other than
+/// IA32_PM_ENABLE, which fault otherwise.
+///
+/// @param [in] hd HWP data.
+///
+/// @param [in] func Name of the caller for the error message.
+///
+/// @return 0 if HWP is enabled, else -1.
+static int hwp_check_enabled(struct hwp_data *hd, const char *func)
+{
+    char msg[128];
+
+    if (!hd->hwp_enabled)
+    {
+        snprintf(msg, sizeof(msg), "%s(): HWP is %s", func, hd->hwp_avail ? "not enabled, call enable_hwp() first" : "not available");
+        libmsr_error_handler(msg, hd->hwp_avail ? LIBMSR_ERROR_INVAL : LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    return 0;
+}
+
+/// @brief Check that a request can be written with the given fields.
+///
+/// @param [in] hd HWP data.
+///
+/// @param [in] req Request to check.
+///
+/// @param [in] fields Bitwise OR of hwp_field_e values to write.
+///
+/// @param [in] func Name of the caller for the error message.
+///
+/// @return 0 if the request is valid, else -1.
+static int hwp_check_request(struct hwp_data *hd, const struct hwp_request *req, int fields, const char *func)
+{
+    char msg[128];
+
+    if ((fields & HWP_FIELD_EPP) && !hd->epp_avail)
+    {
+        snprintf(msg, sizeof(msg), "%s(): HWP energy/performance preference is not available", func);
+        libmsr_error_handler(msg, LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    if ((fields & HWP_FIELD_MIN) && (fields & HWP_FIELD_MAX) && req->min > req->max)
+    {
+        snprintf(msg, sizeof(msg), "%s(): Minimum performance above maximum", func);
+        libmsr_error_handler(msg, LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    return 0;
+}
+
+uint64_t hwp_encode(uint64_t raw, const struct hwp_request *req, int fields)
+{
+    if (fields & HWP_FIELD_MIN)
+    {
+        raw = (raw & ~((uint64_t)0xFF << HWP_MIN_SHIFT)) | ((uint64_t)req->min << HWP_MIN_SHIFT);
+    }
+    if (fields & HWP_FIELD_MAX)
+    {
+        raw = (raw & ~((uint64_t)0xFF << HWP_MAX_SHIFT)) | ((uint64_t)req->max << HWP_MAX_SHIFT);
+    }
+    if (fields & HWP_FIELD_DESIRED)
+    {
+        raw = (raw & ~((uint64_t)0xFF << HWP_DESIRED_SHIFT)) | ((uint64_t)req->desired << HWP_DESIRED_SHIFT);
+    }
+    if (fields & HWP_FIELD_EPP)
+    {
+        raw = (raw & ~((uint64_t)0xFF << HWP_EPP_SHIFT)) | ((uint64_t)req->epp << HWP_EPP_SHIFT);
+    }
+    return raw;
+}
+
+void hwp_decode(uint64_t raw, struct hwp_request *req)
+{
+    req->min = HWP_FIELD(raw, HWP_MIN_SHIFT);
+    req->max = HWP_FIELD(raw, HWP_MAX_SHIFT);
+    req->desired = HWP_FIELD(raw, HWP_DESIRED_SHIFT);
+    req->epp = HWP_FIELD(raw, HWP_EPP_SHIFT);
+    req->pkg_control = (raw & HWP_PKG_CONTROL) != 0;
+}
+
+int enable_hwp(void)
+{
+    struct hwp_data *hd = NULL;
+    uint64_t socket;
+
+    if (hwp_storage(&hd))
+    {
+        return -1;
+    }
+    if (!hd->hwp_avail)
+    {
+        libmsr_error_handler("enable_hwp(): HWP is not available", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    if (hd->hwp_enabled)
+    {
+        return 0;
+    }
+    for (socket = 0; socket < hd->num_sockets; socket++)
+    {
+        *hd->pm_enable[socket] |= 1;
+    }
+    if (write_batch(HWP_ENABLE))
+    {
+        libmsr_error_handler("enable_hwp(): Unable to write IA32_PM_ENABLE", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    hd->hwp_enabled = 1;
+    return hwp_sync();
+}
+
+int hwp_sync(void)
+{
+    struct hwp_data *hd = NULL;
+
+    if (hwp_storage(&hd))
+    {
+        return -1;
+    }
+    if (hd->hwp_enabled)
+    {
+        if (read_batch(HWP_REQ))
+        {
+            libmsr_error_handler("hwp_sync(): Unable to read IA32_HWP_REQUEST", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+            return -1;
+        }
+        if (hd->pkg_avail && read_batch(HWP_PKG_REQ))
+        {
+            libmsr_error_handler("hwp_sync(): Unable to read IA32_HWP_REQUEST_PKG", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+            return -1;
+        }
+    }
+    if (hd->epb_avail && read_batch(EPB_CTL))
+    {
+        libmsr_error_handler("hwp_sync(): Unable to read IA32_ENERGY_PERF_BIAS", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    return 0;
+}
+
+int get_hwp_capabilities(struct hwp_caps *caps)
+{
+    struct hwp_data *hd = NULL;
+    uint64_t cpu;
+
+    if (hwp_storage(&hd) || hwp_check_enabled(hd, "get_hwp_capabilities"))
+    {
+        return -1;
+    }
+    /* Guaranteed performance follows power and thermal limits, so the
+     * capabilities are read on every call rather than cached. */
+    if (read_batch(HWP_CAP))
+    {
+        libmsr_error_handler("get_hwp_capabilities(): Unable to read IA32_HWP_CAPABILITIES", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    for (cpu = 0; cpu < hd->num_threads; cpu++)
+    {
+        caps[cpu].highest = HWP_FIELD(*hd->cap[cpu], HWP_CAP_HIGHEST_SHIFT);
+        caps[cpu].guaranteed = HWP_FIELD(*hd->cap[cpu], HWP_CAP_GUARANTEED_SHIFT);
+        caps[cpu].efficient = HWP_FIELD(*hd->cap[cpu], HWP_CAP_EFFICIENT_SHIFT);
+        caps[cpu].lowest = HWP_FIELD(*hd->cap[cpu], HWP_CAP_LOWEST_SHIFT);
+    }
+    return 0;
+}
+
+int get_hwp_request(struct hwp_request *reqs)
+{
+    struct hwp_data *hd = NULL;
+    uint64_t cpu;
+
+    if (hwp_storage(&hd) || hwp_check_enabled(hd, "get_hwp_request"))
+    {
+        return -1;
+    }
+    if (read_batch(HWP_REQ))
+    {
+        libmsr_error_handler("get_hwp_request(): Unable to read IA32_HWP_REQUEST", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    for (cpu = 0; cpu < hd->num_threads; cpu++)
+    {
+        hwp_decode(*hd->req[cpu], &reqs[cpu]);
+    }
+    return 0;
+}
+
+int set_hwp_request_mask(const uint64_t *cpumask, const struct hwp_request *req, int fields)
+{
+    struct hwp_data *hd = NULL;
+    uint64_t cpu;
+
+    if (hwp_storage(&hd) || hwp_check_enabled(hd, "set_hwp_request_mask") || hwp_check_request(hd, req, fields, "set_hwp_request_mask"))
+    {
+        return -1;
+    }
+    for (cpu = 0; cpu < hd->num_threads; cpu++)
+    {
+        if (CPUMASK_ISSET(cpumask, cpu))
+        {
+            *hd->req[cpu] = hwp_encode(*hd->req[cpu], req, fields) & ~HWP_PKG_CONTROL;
+        }
+    }
+    if (write_batch(HWP_REQ))
+    {
+        libmsr_error_handler("set_hwp_request_mask(): Unable to write IA32_HWP_REQUEST", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    return 0;
+}
+
+int set_hwp_request_array(const struct hwp_request *reqs, int fields)
+{
+    struct hwp_data *hd = NULL;
+    uint64_t cpu;
+
+    if (hwp_storage(&hd) || hwp_check_enabled(hd, "set_hwp_request_array"))
+    {
+        return -1;
+    }
+    for (cpu = 0; cpu < hd->num_threads; cpu++)
+    {
+        if (hwp_check_request(hd, &reqs[cpu], fields, "set_hwp_request_array"))
+        {
+            return -1;
+        }
+    }
+    for (cpu = 0; cpu < hd->num_threads; cpu++)
+    {
+        *hd->req[cpu] = hwp_encode(*hd->req[cpu], &reqs[cpu], fields) & ~HWP_PKG_CONTROL;
+    }
+    if (write_batch(HWP_REQ))
+    {
+        libmsr_error_handler("set_hwp_request_array(): Unable to write IA32_HWP_REQUEST", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    return 0;
+}
+
+int set_hwp_pkg_request(const struct hwp_request *req, int fields)
+{
+    struct hwp_data *hd = NULL;
+    uint64_t socket;
+
+    if (hwp_storage(&hd) || hwp_check_enabled(hd, "set_hwp_pkg_request") || hwp_check_request(hd, req, fields, "set_hwp_pkg_request"))
+    {
+        return -1;
+    }
+    if (!hd->pkg_avail)
+    {
+        libmsr_error_handler("set_hwp_pkg_request(): IA32_HWP_REQUEST_PKG is not available", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    for (socket = 0; socket < hd->num_sockets; socket++)
+    {
+        *hd->pkg_req[socket] = hwp_encode(*hd->pkg_req[socket], req, fields);
+    }
+    if (write_batch(HWP_PKG_REQ))
+    {
+        libmsr_error_handler("set_hwp_pkg_request(): Unable to write IA32_HWP_REQUEST_PKG", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    return 0;
+}
+
+int set_hwp_pkg_control(const uint64_t *cpumask, int enable)
+{
+    struct hwp_data *hd = NULL;
+    uint64_t cpu;
+
+    if (hwp_storage(&hd) || hwp_check_enabled(hd, "set_hwp_pkg_control"))
+    {
+        return -1;
+    }
+    if (!hd->pkg_avail)
+    {
+        libmsr_error_handler("set_hwp_pkg_control(): IA32_HWP_REQUEST_PKG is not available", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    for (cpu = 0; cpu < hd->num_threads; cpu++)
+    {
+        if (CPUMASK_ISSET(cpumask, cpu))
+        {
+            if (enable)
+            {
+                *hd->req[cpu] |= HWP_PKG_CONTROL;
+            }
+            else
+            {
+                *hd->req[cpu] &= ~HWP_PKG_CONTROL;
+            }
+        }
+    }
+    if (write_batch(HWP_REQ))
+    {
+        libmsr_error_handler("set_hwp_pkg_control(): Unable to write IA32_HWP_REQUEST", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    return 0;
+}
+
+int get_epb(uint64_t *epb)
+{
+    struct hwp_data *hd = NULL;
+    uint64_t cpu;
+
+    if (hwp_storage(&hd))
+    {
+        return -1;
+    }
+    if (!hd->epb_avail)
+    {
+        libmsr_error_handler("get_epb(): IA32_ENERGY_PERF_BIAS is not available", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    if (read_batch(EPB_CTL))
+    {
+        libmsr_error_handler("get_epb(): Unable to read IA32_ENERGY_PERF_BIAS", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    for (cpu = 0; cpu < hd->num_threads; cpu++)
+    {
+        epb[cpu] = *hd->epb[cpu] & EPB_MASK;
+    }
+    return 0;
+}
+
+int set_epb_mask(const uint64_t *cpumask, uint64_t epb)
+{
+    struct hwp_data *hd = NULL;
+    uint64_t cpu;
+
+    if (hwp_storage(&hd))
+    {
+        return -1;
+    }
+    if (!hd->epb_avail)
+    {
+        libmsr_error_handler("set_epb_mask(): IA32_ENERGY_PERF_BIAS is not available", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    if (epb > EPB_MASK)
+    {
+        libmsr_error_handler("set_epb_mask(): Bias out of range", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    for (cpu = 0; cpu < hd->num_threads; cpu++)
+    {
+        if (CPUMASK_ISSET(cpumask, cpu))
+        {
+            *hd->epb[cpu] = (*hd->epb[cpu] & ~EPB_MASK) | epb;
+        }
+    }
+    if (write_batch(EPB_CTL))
+    {
+        libmsr_error_handler("set_epb_mask(): Unable to write IA32_ENERGY_PERF_BIAS", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    return 0;
+}
+
+void dump_hwp(FILE *writedest)
+{
+    struct hwp_data *hd = NULL;
+    struct hwp_request req;
+    uint64_t cpu, socket;
+
+    if (hwp_storage(&hd) || hwp_sync())
+    {
+        return;
+    }
+    if (hd->hwp_enabled && read_batch(HWP_CAP))
+    {
+        return;
+    }
+    for (cpu = 0; cpu < hd->num_threads; cpu++)
+    {
+        fprintf(writedest, "cpu%02lu:", cpu);
+        if (hd->hwp_enabled)
+        {
+            hwp_decode(*hd->req[cpu], &req);
+            fprintf(writedest, " cap %lu/%lu/%lu/%lu req min %u max %u desired %u epp %u%s", HWP_FIELD(*hd->cap[cpu], HWP_CAP_LOWEST_SHIFT), HWP_FIELD(*hd->cap[cpu], HWP_CAP_EFFICIENT_SHIFT), HWP_FIELD(*hd->cap[cpu], HWP_CAP_GUARANTEED_SHIFT), HWP_FIELD(*hd->cap[cpu], HWP_CAP_HIGHEST_SHIFT), req.min, req.max, req.desired, req.epp, req.pkg_control ? " (pkg)" : "");
+        }
+        else if (hd->hwp_avail)
+        {
+            fprintf(writedest, " hwp disabled");
+        }
+        if (hd->epb_avail)
+        {
+            fprintf(writedest, " epb %lu", *hd->epb[cpu] & EPB_MASK);
+        }
+        fprintf(writedest, "\n");
+    }
+    if (hd->hwp_enabled && hd->pkg_avail)
+    {
+        for (socket = 0; socket < hd->num_sockets; socket++)
+        {
+            hwp_decode(*hd->pkg_req[socket], &req);
+            fprintf(writedest, "Socket %lu: pkg req min %u max %u desired %u epp %u\n", socket, req.min, req.max, req.desired, req.epp);
+        }
+    }
+}
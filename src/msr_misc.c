@@ -34,12 +34,14 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/time.h>
 
 #include "msr_core.h"
 #include "msr_misc.h"
 #include "memhdlr.h"
 #include "cpuid.h"
+#include "libmsr_error.h"
 
 /// @brief Allocate data structures to store package-level C-state
 /// residencies.
@@ -176,10 +178,11 @@ void dump_pkg_cres(FILE *writedest)
 {
     struct pkg_cres *pcr;
     int i;
+    uint64_t sockets = num_sockets();
 
     pkg_cres_storage(&pcr);
     read_batch(PKG_CRES);
-    for (i = 0; i < num_sockets(); i++)
+    for (i = 0; i < sockets; i++)
     {
         fprintf(writedest, "%lx\t", *pcr->pkg_c2[i]);
         fprintf(writedest, "%lx\t", *pcr->pkg_c3[i]);
@@ -198,10 +201,11 @@ void dump_core_cres(FILE *writedest)
 {
     struct core_cres *ccr;
     int i = 0;
+    uint64_t cores = num_cores();
 
     core_cres_storage(&ccr);
     read_batch(CORE_CRES);
-    for (i = 0; i < num_cores(); i++)
+    for (i = 0; i < cores; i++)
     {
         fprintf(writedest, "%lx\t", *ccr->core_c3[i]);
         fprintf(writedest, "%lx\t", *ccr->core_c6[i]);
@@ -209,3 +213,186 @@ void dump_core_cres(FILE *writedest)
         fprintf(writedest, "\n");
     }
 }
+
+void cres_sample_storage(struct cres_sample **cs)
+{
+    static int init = 0;
+    static struct cres_sample d;
+    static const off_t pkg_msrs[CRES_PKG_NUM] = {0, MSR_PKG_C2_RESIDENCY, MSR_PKG_C3_RESIDENCY, MSR_PKG_C6_RESIDENCY, MSR_PKG_C7_RESIDENCY};
+    static const off_t core_msrs[CRES_CORE_NUM] = {0, 0, MSR_CORE_C3_RESIDENCY, MSR_CORE_C6_RESIDENCY, MSR_CORE_C7_RESIDENCY};
+    unsigned socket, core, thread;
+    int i;
+
+    if (!init)
+    {
+        init = 1;
+        d.num_sockets = num_sockets();
+        d.num_cores = num_cores();
+        d.num_threads = num_devs();
+        d.tsc = (uint64_t **) libmsr_calloc(d.num_sockets, sizeof(uint64_t *));
+        d.mperf = (uint64_t **) libmsr_calloc(d.num_threads, sizeof(uint64_t *));
+        d.thread_core = (uint64_t *) libmsr_calloc(d.num_threads, sizeof(uint64_t));
+        d.old_mperf = (uint64_t *) libmsr_calloc(d.num_threads, sizeof(uint64_t));
+        d.core_mperf = (uint64_t *) libmsr_calloc(d.num_cores, sizeof(uint64_t));
+        for (i = 0; i < d.num_threads; i++)
+        {
+            thread_batch_coord(i, &socket, &core, &thread);
+            d.thread_core[i] = socket * (d.num_cores / d.num_sockets) + core;
+        }
+        d.old = (uint64_t *) libmsr_calloc(CRES_PKG_NUM * d.num_sockets + CRES_CORE_NUM * d.num_cores, sizeof(uint64_t));
+        d.pkg_pct = (double *) libmsr_calloc(CRES_PKG_NUM * d.num_sockets, sizeof(double));
+        d.core_pct = (double *) libmsr_calloc(CRES_CORE_NUM * d.num_cores, sizeof(double));
+        d.intervals = 0;
+        allocate_batch(CRES_SAMPLE, (CRES_PKG_NUM * d.num_sockets) + ((CRES_CORE_NUM - 2) * d.num_cores) + d.num_threads);
+        load_socket_batch(IA32_TIME_STAMP_COUNTER, d.tsc, CRES_SAMPLE);
+        for (i = CRES_PKG_C2; i < CRES_PKG_NUM; i++)
+        {
+            d.pkg[i] = (uint64_t **) libmsr_calloc(d.num_sockets, sizeof(uint64_t *));
+            load_socket_batch(pkg_msrs[i], d.pkg[i], CRES_SAMPLE);
+        }
+        load_thread_batch(IA32_MPERF, d.mperf, CRES_SAMPLE);
+        for (i = CRES_CORE_C3; i < CRES_CORE_NUM; i++)
+        {
+            d.core[i] = (uint64_t **) libmsr_calloc(d.num_cores, sizeof(uint64_t *));
+            load_core_batch(core_msrs[i], d.core[i], CRES_SAMPLE);
+        }
+    }
+    if (cs != NULL)
+    {
+        *cs = &d;
+    }
+}
+
+/// @brief Convert a residency delta to a percentage of a TSC delta, clamped
+/// to [0, 100] against counters that are not sampled at the same instant.
+static double cres_pct(uint64_t delta, uint64_t d_tsc)
+{
+    double pct = (d_tsc ? 100.0 * delta / d_tsc : 0.0);
+
+    return (pct < 0.0 ? 0.0 : (pct > 100.0 ? 100.0 : pct));
+}
+
+int poll_cres_sample(void)
+{
+    static struct cres_sample *cs = NULL;
+    static uint64_t coresPerSocket = 0;
+    static int primed = 0;
+    uint64_t *old, *old_tsc, d_tsc, d_mperf, socket, core;
+    double *pct, rest;
+    int i, baseline;
+
+    if (cs == NULL)
+    {
+        cres_sample_storage(&cs);
+        coresPerSocket = cores_per_socket();
+    }
+    if (read_batch(CRES_SAMPLE))
+    {
+        libmsr_error_handler("poll_cres_sample(): Unable to read C-state residencies", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    baseline = !primed;
+    primed = 1;
+    /* Unsigned deltas stay correct across a 64-bit wraparound. The old TSC
+     * is kept in the unused CRES_PKG_C0 slot of each socket. */
+    for (socket = 0; socket < cs->num_sockets; socket++)
+    {
+        old = &cs->old[CRES_PKG_NUM * socket];
+        pct = &cs->pkg_pct[CRES_PKG_NUM * socket];
+        d_tsc = *cs->tsc[socket] - old[CRES_PKG_C0];
+        rest = 100.0;
+        for (i = CRES_PKG_C2; i < CRES_PKG_NUM; i++)
+        {
+            pct[i] = cres_pct(*cs->pkg[i][socket] - old[i], d_tsc);
+            rest -= pct[i];
+            old[i] = *cs->pkg[i][socket];
+        }
+        pct[CRES_PKG_C0] = (rest < 0.0 ? 0.0 : rest);
+    }
+    for (core = 0; core < cs->num_cores; core++)
+    {
+        cs->core_mperf[core] = 0;
+    }
+    /* The core is in C0 while any sibling thread is. */
+    for (i = 0; i < cs->num_threads; i++)
+    {
+        d_mperf = *cs->mperf[i] - cs->old_mperf[i];
+        if (d_mperf > cs->core_mperf[cs->thread_core[i]])
+        {
+            cs->core_mperf[cs->thread_core[i]] = d_mperf;
+        }
+        cs->old_mperf[i] = *cs->mperf[i];
+    }
+    for (core = 0; core < cs->num_cores; core++)
+    {
+        socket = core / coresPerSocket;
+        old_tsc = &cs->old[CRES_PKG_NUM * socket + CRES_PKG_C0];
+        old = &cs->old[CRES_PKG_NUM * cs->num_sockets + CRES_CORE_NUM * core];
+        pct = &cs->core_pct[CRES_CORE_NUM * core];
+        d_tsc = *cs->tsc[socket] - *old_tsc;
+        pct[CRES_CORE_C0] = cres_pct(cs->core_mperf[core], d_tsc);
+        rest = 100.0 - pct[CRES_CORE_C0];
+        for (i = CRES_CORE_C3; i < CRES_CORE_NUM; i++)
+        {
+            pct[i] = cres_pct(*cs->core[i][core] - old[i], d_tsc);
+            rest -= pct[i];
+            old[i] = *cs->core[i][core];
+        }
+        pct[CRES_CORE_C1] = (rest < 0.0 ? 0.0 : rest);
+    }
+    for (socket = 0; socket < cs->num_sockets; socket++)
+    {
+        cs->old[CRES_PKG_NUM * socket + CRES_PKG_C0] = *cs->tsc[socket];
+    }
+    if (baseline)
+    {
+        /* Percentages against a zero baseline are meaningless. */
+        for (i = 0; i < CRES_PKG_NUM * cs->num_sockets; i++)
+        {
+            cs->pkg_pct[i] = 0.0;
+        }
+        for (i = 0; i < CRES_CORE_NUM * cs->num_cores; i++)
+        {
+            cs->core_pct[i] = 0.0;
+        }
+        return 0;
+    }
+    cs->intervals++;
+    return 0;
+}
+
+void dump_cres_sample_label(FILE *writedest)
+{
+    fprintf(writedest, "PKG:c0%%\tc2%%\tc3%%\tc6%%\tc7%%\n");
+    fprintf(writedest, "CORE:c0%%\tc1%%\tc3%%\tc6%%\tc7%%\n");
+}
+
+void dump_cres_sample(FILE *writedest)
+{
+    static struct cres_sample *cs = NULL;
+    uint64_t i;
+    int j;
+
+    if (cs == NULL)
+    {
+        cres_sample_storage(&cs);
+    }
+    for (i = 0; i < cs->num_sockets; i++)
+    {
+        fprintf(writedest, "pkg%lu", i);
+        for (j = 0; j < CRES_PKG_NUM; j++)
+        {
+            fprintf(writedest, "\t%.2f", cs->pkg_pct[CRES_PKG_NUM * i + j]);
+        }
+        fprintf(writedest, "\n");
+    }
+    for (i = 0; i < cs->num_cores; i++)
+    {
+        fprintf(writedest, "core%lu", i);
+        for (j = 0; j < CRES_CORE_NUM; j++)
+        {
+            fprintf(writedest, "\t%.2f", cs->core_pct[CRES_CORE_NUM * i + j]);
+        }
+        fprintf(writedest, "\n");
+    }
+}
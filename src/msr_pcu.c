@@ -0,0 +1,386 @@
+/* msr_pcu.c
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "msr_core.h"
+#include "msr_pcu.h"
+#include "msr_counters.h"
+#include "msr_rapl.h"
+#include "memhdlr.h"
+#include "cpuid.h"
+#include "libmsr_error.h"
+#include "libmsr_debug.h"
+
+/// @brief Event select and occupancy select of each named PCU event.
+static const struct {
+    const char *name;
+    uint64_t eventsel;
+    uint64_t occ;
+    /// @brief Non-zero if the event counts cycles (comparable to clockticks).
+    int cycles;
+} pcu_events[PCU_NUM_EVENTS] = {
+    [PCU_CLOCKTICKS]        = {"CLOCKTICKS",       PCU_EVT_CLOCKTICKS,              0,          0},
+    [PCU_FREQ_BAND0]        = {"FREQ_BAND0",       PCU_EVT_FREQ_BAND0_CYCLES,       0,          1},
+    [PCU_FREQ_BAND1]        = {"FREQ_BAND1",       PCU_EVT_FREQ_BAND1_CYCLES,       0,          1},
+    [PCU_FREQ_BAND2]        = {"FREQ_BAND2",       PCU_EVT_FREQ_BAND2_CYCLES,       0,          1},
+    [PCU_FREQ_BAND3]        = {"FREQ_BAND3",       PCU_EVT_FREQ_BAND3_CYCLES,       0,          1},
+    [PCU_FREQ_MAX_THERMAL]  = {"FREQ_MAX_THERMAL", PCU_EVT_FREQ_MAX_LIMIT_THERMAL,  0,          1},
+    [PCU_FREQ_MAX_POWER]    = {"FREQ_MAX_POWER",   PCU_EVT_FREQ_MAX_POWER,          0,          1},
+    [PCU_FREQ_MAX_OS]       = {"FREQ_MAX_OS",      PCU_EVT_FREQ_MAX_OS,             0,          1},
+    [PCU_PROCHOT_INTERNAL]  = {"PROCHOT_INTERNAL", PCU_EVT_PROCHOT_INTERNAL,        0,          1},
+    [PCU_PROCHOT_EXTERNAL]  = {"PROCHOT_EXTERNAL", PCU_EVT_PROCHOT_EXTERNAL,        0,          1},
+    [PCU_C0_OCCUPANCY]      = {"C0_OCCUPANCY",     PCU_EVT_POWER_STATE_OCCUPANCY,   PCU_OCC_C0, 0},
+    [PCU_C3_OCCUPANCY]      = {"C3_OCCUPANCY",     PCU_EVT_POWER_STATE_OCCUPANCY,   PCU_OCC_C3, 0},
+    [PCU_C6_OCCUPANCY]      = {"C6_OCCUPANCY",     PCU_EVT_POWER_STATE_OCCUPANCY,   PCU_OCC_C6, 0},
+    [PCU_CORE0_TRANSITIONS] = {"CORE0_TRANSITIONS", PCU_EVT_CORE0_TRANSITION_CYCLES, 0,         1},
+};
+
+/// @brief Inverse of the package energy unit per socket.
+///
+/// @return Pointer to array of per-socket energy units.
+static double *pcu_energy_units(void)
+{
+    static double *units = NULL;
+    struct rapl_units *ru = NULL;
+    uint64_t sockets;
+    int i;
+
+    if (units == NULL)
+    {
+        sockets = num_sockets();
+        units = (double *) libmsr_calloc(sockets, sizeof(double));
+        ru = (struct rapl_units *) libmsr_calloc(sockets, sizeof(struct rapl_units));
+        get_rapl_power_unit(ru);
+        for (i = 0; i < sockets; i++)
+        {
+            units[i] = ru[i].joules;
+        }
+        libmsr_free(ru);
+    }
+    return units;
+}
+
+void pcu_storage(struct pcu_data **pd)
+{
+    static struct pcu_data d;
+    static int init = 0;
+    static uint64_t sockets = 0;
+    int i;
+
+    if (!init)
+    {
+        sockets = num_sockets();
+        for (i = 0; i < PCU_NUM_CTRS; i++)
+        {
+            d.ctr[i] = (uint64_t **) libmsr_calloc(sockets, sizeof(uint64_t *));
+            d.old_ctr[i] = (uint64_t *) libmsr_calloc(sockets, sizeof(uint64_t));
+            d.delta[i] = (uint64_t *) libmsr_calloc(sockets, sizeof(uint64_t));
+        }
+        d.pkg_energy = (uint64_t **) libmsr_calloc(sockets, sizeof(uint64_t *));
+        d.old_pkg_energy = (uint64_t *) libmsr_calloc(sockets, sizeof(uint64_t));
+        d.pkg_joules = (double *) libmsr_calloc(sockets, sizeof(double));
+        d.num_events = 0;
+
+        allocate_batch(PCU_DATA, (PCU_NUM_CTRS + 1) * sockets);
+        load_socket_batch(MSR_PCU_PMON_CTR0, d.ctr[0], PCU_DATA);
+        load_socket_batch(MSR_PCU_PMON_CTR1, d.ctr[1], PCU_DATA);
+        load_socket_batch(MSR_PCU_PMON_CTR2, d.ctr[2], PCU_DATA);
+        load_socket_batch(MSR_PCU_PMON_CTR3, d.ctr[3], PCU_DATA);
+        load_socket_batch(MSR_PKG_ENERGY_STATUS, d.pkg_energy, PCU_DATA);
+        init = 1;
+    }
+    if (pd != NULL)
+    {
+        *pd = &d;
+    }
+}
+
+void pcu_box_storage(uint64_t ***box_ctl, uint64_t ***box_filter)
+{
+    static uint64_t **ctl = NULL;
+    static uint64_t **filter = NULL;
+    static int init = 0;
+    static uint64_t sockets = 0;
+
+    if (!init)
+    {
+        sockets = num_sockets();
+        ctl = (uint64_t **) libmsr_calloc(sockets, sizeof(uint64_t *));
+        filter = (uint64_t **) libmsr_calloc(sockets, sizeof(uint64_t *));
+        allocate_batch(PCU_BOX_CTRL, 2 * sockets);
+        load_socket_batch(MSR_PCU_PMON_BOX_CTL, ctl, PCU_BOX_CTRL);
+        load_socket_batch(MSR_PCU_PMON_BOX_FILTER, filter, PCU_BOX_CTRL);
+        init = 1;
+    }
+    if (box_ctl != NULL)
+    {
+        *box_ctl = ctl;
+    }
+    if (box_filter != NULL)
+    {
+        *box_filter = filter;
+    }
+}
+
+const char *pcu_event_name(enum pcu_event_e event)
+{
+    if (event < 0 || event >= PCU_NUM_EVENTS)
+    {
+        return "UNKNOWN";
+    }
+    return pcu_events[event].name;
+}
+
+int set_pcu_events(const enum pcu_event_e *events, int nevents)
+{
+    static struct unc_perfevtsel *uevt = NULL;
+    static uint64_t sockets = 0;
+    struct pcu_data *pd = NULL;
+    uint64_t **evtsel[PCU_NUM_CTRS];
+    int i, j;
+
+    if (events == NULL || nevents < 1 || nevents > PCU_NUM_CTRS)
+    {
+        libmsr_error_handler("set_pcu_events(): Invalid number of events", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    for (i = 0; i < nevents; i++)
+    {
+        if (events[i] < 0 || events[i] >= PCU_NUM_EVENTS)
+        {
+            libmsr_error_handler("set_pcu_events(): Unknown PCU event", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+            return -1;
+        }
+    }
+    if (uevt == NULL)
+    {
+        sockets = num_sockets();
+        unc_perfevtsel_storage(&uevt);
+    }
+    pcu_storage(&pd);
+
+    evtsel[0] = uevt->c0;
+    evtsel[1] = uevt->c1;
+    evtsel[2] = uevt->c2;
+    evtsel[3] = uevt->c3;
+    for (j = 0; j < sockets; j++)
+    {
+        for (i = 0; i < PCU_NUM_CTRS; i++)
+        {
+            if (i < nevents)
+            {
+                *evtsel[i][j] = PCU_EVTSEL_EN | (pcu_events[events[i]].occ << 14) | pcu_events[events[i]].eventsel;
+            }
+            else
+            {
+                *evtsel[i][j] = 0;
+            }
+        }
+    }
+    for (i = 0; i < nevents; i++)
+    {
+        pd->event[i] = events[i];
+    }
+    pd->num_events = nevents;
+
+    if (write_batch(UNCORE_EVTSEL) || pcu_box_ctrl(0, 1))
+    {
+        return -1;
+    }
+    /* Establish the baseline so the first poll reports a real delta. */
+    return poll_pcu_data();
+}
+
+int set_pcu_band_thresholds(const unsigned band_mhz[4])
+{
+    static uint64_t sockets = 0;
+    uint64_t **box_filter = NULL;
+    uint64_t filter = 0;
+    int i;
+
+    if (band_mhz == NULL)
+    {
+        return -1;
+    }
+    for (i = 0; i < 4; i++)
+    {
+        /* Each band is an 8-bit ratio in 100 MHz units. */
+        if (band_mhz[i] / 100 > 0xFF)
+        {
+            libmsr_error_handler("set_pcu_band_thresholds(): Band threshold out of range", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+            return -1;
+        }
+        filter |= ((uint64_t)(band_mhz[i] / 100)) << (8 * i);
+    }
+    if (!sockets)
+    {
+        sockets = num_sockets();
+    }
+    pcu_box_storage(NULL, &box_filter);
+    if (read_batch(PCU_BOX_CTRL))
+    {
+        return -1;
+    }
+    for (i = 0; i < sockets; i++)
+    {
+        *box_filter[i] = (*box_filter[i] & ~MASK_RANGE(31, 0)) | filter;
+    }
+    return write_batch(PCU_BOX_CTRL);
+}
+
+int pcu_box_ctrl(int freeze, int reset)
+{
+    static uint64_t sockets = 0;
+    uint64_t **box_ctl = NULL;
+    int i;
+
+    if (!sockets)
+    {
+        sockets = num_sockets();
+    }
+    pcu_box_storage(&box_ctl, NULL);
+    if (read_batch(PCU_BOX_CTRL))
+    {
+        return -1;
+    }
+    for (i = 0; i < sockets; i++)
+    {
+        /* Reset bits are self-clearing, so never carry them over. */
+        *box_ctl[i] &= ~(PCU_BOX_RST_CTRL | PCU_BOX_RST_CTRS | PCU_BOX_FRZ);
+        *box_ctl[i] |= PCU_BOX_FRZ_EN;
+        if (freeze)
+        {
+            *box_ctl[i] |= PCU_BOX_FRZ;
+        }
+        if (reset)
+        {
+            *box_ctl[i] |= PCU_BOX_RST_CTRS;
+        }
+    }
+    return write_batch(PCU_BOX_CTRL);
+}
+
+int poll_pcu_data(void)
+{
+    static uint64_t sockets = 0;
+    static double *units = NULL;
+    struct pcu_data *pd = NULL;
+    int i, j;
+
+    if (!sockets)
+    {
+        sockets = num_sockets();
+        units = pcu_energy_units();
+    }
+    pcu_storage(&pd);
+    if (read_batch(PCU_DATA))
+    {
+        return -1;
+    }
+    pd->old_now = pd->now;
+    gettimeofday(&pd->now, NULL);
+    pd->elapsed = (pd->now.tv_sec - pd->old_now.tv_sec) + (pd->now.tv_usec - pd->old_now.tv_usec) / 1000000.0;
+
+    for (j = 0; j < sockets; j++)
+    {
+        for (i = 0; i < PCU_NUM_CTRS; i++)
+        {
+            uint64_t cur = *pd->ctr[i][j] & MASK_RANGE(PCU_CTR_WIDTH - 1, 0);
+            pd->delta[i][j] = ctr_wrap_delta(cur, pd->old_ctr[i][j], PCU_CTR_WIDTH);
+            pd->old_ctr[i][j] = cur;
+        }
+        /* Energy status register holds 32 bits. */
+        pd->pkg_joules[j] = (double)((*pd->pkg_energy[j] - pd->old_pkg_energy[j]) & 0xFFFFFFFF) / units[j];
+        pd->old_pkg_energy[j] = *pd->pkg_energy[j];
+    }
+    return 0;
+}
+
+void dump_pcu_data_label(FILE *writedest)
+{
+    struct pcu_data *pd = NULL;
+    int i;
+
+    pcu_storage(&pd);
+    fprintf(writedest, "socket elapsed pkg_W ");
+    for (i = 0; i < pd->num_events; i++)
+    {
+        fprintf(writedest, "%s/s ", pcu_event_name(pd->event[i]));
+    }
+    fprintf(writedest, "\n");
+}
+
+void dump_pcu_data(FILE *writedest)
+{
+    static uint64_t sockets = 0;
+    struct pcu_data *pd = NULL;
+    int clk = -1;
+    int i, j;
+
+    if (!sockets)
+    {
+        sockets = num_sockets();
+    }
+    pcu_storage(&pd);
+    for (i = 0; i < pd->num_events; i++)
+    {
+        if (pd->event[i] == PCU_CLOCKTICKS)
+        {
+            clk = i;
+        }
+    }
+    for (j = 0; j < sockets; j++)
+    {
+        fprintf(writedest, "%d %.6lf %8.4lf ", j, pd->elapsed, (pd->elapsed > 0.0 ? pd->pkg_joules[j] / pd->elapsed : 0.0));
+        for (i = 0; i < pd->num_events; i++)
+        {
+            fprintf(writedest, "%.0lf ", (pd->elapsed > 0.0 ? pd->delta[i][j] / pd->elapsed : 0.0));
+        }
+        fprintf(writedest, "\n");
+        if (clk < 0 || pd->delta[clk][j] == 0)
+        {
+            continue;
+        }
+        for (i = 0; i < pd->num_events; i++)
+        {
+            if (pcu_events[pd->event[i]].cycles)
+            {
+                fprintf(writedest, "  %-18s %6.2lf%% of PCU cycles\n", pcu_event_name(pd->event[i]), 100.0 * pd->delta[i][j] / pd->delta[clk][j]);
+            }
+        }
+    }
+}
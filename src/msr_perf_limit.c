@@ -0,0 +1,248 @@
+/* msr_perf_limit.c
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "msr_core.h"
+#include "msr_perf_limit.h"
+#include "msr_rapl.h"
+#include "memhdlr.h"
+#include "libmsr_error.h"
+#include "libmsr_debug.h"
+
+static const char *perf_limit_names[PERF_LIMIT_NUM_REASONS] = {
+    "prochot",
+    "thermal",
+    "budget",
+    "platform_config",
+    "residency",
+    "autonomous",
+    "vr_therm",
+    "vr_tdc",
+    "edp",
+    "core_power",
+    "pl1",
+    "pl2",
+    "max_turbo",
+    "turbo_atten",
+};
+
+static const char *perf_limit_domain_names[PERF_LIMIT_NUM_DOMAINS] = {
+    "core",
+    "graphics",
+    "ring",
+};
+
+int perf_limit_storage(struct perf_limit_data **pd)
+{
+    static int init = 0;
+    static int avail = 0;
+    static struct perf_limit_data d;
+    static const off_t msrs[PERF_LIMIT_NUM_DOMAINS] = {MSR_CORE_PERF_LIMIT_REASONS, MSR_GRAPHICS_PERF_LIMIT_REASONS, MSR_RING_PERF_LIMIT_REASONS};
+    static const uint64_t flags[PERF_LIMIT_NUM_DOMAINS] = {CORE_PERF_LIMIT_REASONS, GRAPHICS_PERF_LIMIT_REASONS, RING_PERF_LIMIT_REASONS};
+    uint64_t *rapl_flags = NULL;
+    int i, ndomains = 0;
+
+    if (!init)
+    {
+        init = 1;
+        if (rapl_storage(NULL, &rapl_flags))
+        {
+            return -1;
+        }
+        for (i = 0; i < PERF_LIMIT_NUM_DOMAINS; i++)
+        {
+            d.avail[i] = ((*rapl_flags & flags[i]) != 0);
+            ndomains += d.avail[i];
+        }
+        if (ndomains == 0)
+        {
+            libmsr_error_handler("perf_limit_storage(): No perf limit reasons register on this platform", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+            return -1;
+        }
+        d.num_sockets = num_sockets();
+        d.status_count = (uint64_t *) libmsr_calloc(d.num_sockets * PERF_LIMIT_NUM_DOMAINS * PERF_LIMIT_NUM_REASONS, sizeof(uint64_t));
+        d.log_count = (uint64_t *) libmsr_calloc(d.num_sockets * PERF_LIMIT_NUM_DOMAINS * PERF_LIMIT_NUM_REASONS, sizeof(uint64_t));
+        d.intervals = 0;
+        allocate_batch(PERF_LIMIT_DATA, ndomains * d.num_sockets);
+        for (i = 0; i < PERF_LIMIT_NUM_DOMAINS; i++)
+        {
+            if (d.avail[i])
+            {
+                d.raw[i] = (uint64_t **) libmsr_calloc(d.num_sockets, sizeof(uint64_t *));
+                load_socket_batch(msrs[i], d.raw[i], PERF_LIMIT_DATA);
+            }
+        }
+        avail = 1;
+    }
+    if (!avail)
+    {
+        return -1;
+    }
+    if (pd != NULL)
+    {
+        *pd = &d;
+    }
+    return 0;
+}
+
+int clear_perf_limit_log(void)
+{
+    struct perf_limit_data *pd = NULL;
+    uint64_t socket;
+    int i;
+
+    if (perf_limit_storage(&pd))
+    {
+        return -1;
+    }
+    /* Log flags are cleared by writing 0; status flags are read-only. */
+    for (i = 0; i < PERF_LIMIT_NUM_DOMAINS; i++)
+    {
+        if (pd->avail[i])
+        {
+            for (socket = 0; socket < pd->num_sockets; socket++)
+            {
+                *pd->raw[i][socket] &= ~PERF_LIMIT_LOG_MASK;
+            }
+        }
+    }
+    if (write_batch(PERF_LIMIT_DATA))
+    {
+        libmsr_error_handler("clear_perf_limit_log(): Unable to clear log flags", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    return 0;
+}
+
+int poll_perf_limit(int clear_log)
+{
+    struct perf_limit_data *pd = NULL;
+    uint64_t socket, raw, *status, *log;
+    int i, r;
+
+    if (perf_limit_storage(&pd))
+    {
+        return -1;
+    }
+    if (read_batch(PERF_LIMIT_DATA))
+    {
+        libmsr_error_handler("poll_perf_limit(): Unable to read perf limit reasons", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    for (socket = 0; socket < pd->num_sockets; socket++)
+    {
+        for (i = 0; i < PERF_LIMIT_NUM_DOMAINS; i++)
+        {
+            if (!pd->avail[i])
+            {
+                continue;
+            }
+            raw = *pd->raw[i][socket];
+            status = &pd->status_count[(socket * PERF_LIMIT_NUM_DOMAINS + i) * PERF_LIMIT_NUM_REASONS];
+            log = &pd->log_count[(socket * PERF_LIMIT_NUM_DOMAINS + i) * PERF_LIMIT_NUM_REASONS];
+            for (r = 0; r < PERF_LIMIT_NUM_REASONS; r++)
+            {
+                status[r] += (raw >> r) & 1;
+                log[r] += (raw >> (r + PERF_LIMIT_LOG_SHIFT)) & 1;
+            }
+        }
+    }
+    pd->intervals++;
+    if (clear_log)
+    {
+        return clear_perf_limit_log();
+    }
+    return 0;
+}
+
+void reset_perf_limit_counts(void)
+{
+    struct perf_limit_data *pd = NULL;
+    uint64_t i;
+
+    if (perf_limit_storage(&pd))
+    {
+        return;
+    }
+    for (i = 0; i < pd->num_sockets * PERF_LIMIT_NUM_DOMAINS * PERF_LIMIT_NUM_REASONS; i++)
+    {
+        pd->status_count[i] = 0;
+        pd->log_count[i] = 0;
+    }
+    pd->intervals = 0;
+}
+
+const char *perf_limit_reason_name(int reason)
+{
+    if (reason < 0 || reason >= PERF_LIMIT_NUM_REASONS)
+    {
+        return "unknown";
+    }
+    return perf_limit_names[reason];
+}
+
+void dump_perf_limit(FILE *writedest)
+{
+    struct perf_limit_data *pd = NULL;
+    uint64_t socket, idx;
+    int i, r;
+
+    if (perf_limit_storage(&pd))
+    {
+        return;
+    }
+    fprintf(writedest, "intervals %lu\n", pd->intervals);
+    for (socket = 0; socket < pd->num_sockets; socket++)
+    {
+        for (i = 0; i < PERF_LIMIT_NUM_DOMAINS; i++)
+        {
+            if (!pd->avail[i])
+            {
+                continue;
+            }
+            fprintf(writedest, "Socket %lu %s:", socket, perf_limit_domain_names[i]);
+            for (r = 0; r < PERF_LIMIT_NUM_REASONS; r++)
+            {
+                idx = (socket * PERF_LIMIT_NUM_DOMAINS + i) * PERF_LIMIT_NUM_REASONS + r;
+                if (pd->status_count[idx] || pd->log_count[idx])
+                {
+                    fprintf(writedest, " %s=%lu/%lu", perf_limit_names[r], pd->status_count[idx], pd->log_count[idx]);
+                }
+            }
+            fprintf(writedest, "\n");
+        }
+    }
+}
@@ -0,0 +1,273 @@
+/* msr_pstate.c
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "msr_core.h"
+#include "msr_pstate.h"
+#include "memhdlr.h"
+#include "libmsr_error.h"
+#include "libmsr_debug.h"
+
+/// @brief Serializes edits of the IA32_PERF_CTL shadow with the PSTATE_CTL
+/// and PSTATE_DATA batch operations that use it.
+static pthread_mutex_t pstate_lock_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void pstate_lock(void)
+{
+    pthread_mutex_lock(&pstate_lock_mutex);
+}
+
+void pstate_unlock(void)
+{
+    pthread_mutex_unlock(&pstate_lock_mutex);
+}
+
+void pstate_storage(struct pstate_data **pd)
+{
+    static int init = 0;
+    static struct pstate_data d;
+    uint64_t cpu;
+
+    if (!init)
+    {
+        init = 1;
+        d.num_threads = num_devs();
+        d.ctl = (uint64_t **) libmsr_malloc(d.num_threads * sizeof(uint64_t *));
+        d.ctl_readback = (uint64_t **) libmsr_malloc(d.num_threads * sizeof(uint64_t *));
+        d.status = (uint64_t **) libmsr_malloc(d.num_threads * sizeof(uint64_t *));
+        allocate_batch(PSTATE_CTL, d.num_threads);
+        allocate_batch(PSTATE_DATA, 2UL * d.num_threads);
+        /* Load by device index rather than with load_thread_batch() so the
+         * batch order matches the Linux CPU numbering of CPU masks. */
+        for (cpu = 0; cpu < d.num_threads; cpu++)
+        {
+            create_batch_op(IA32_PERF_CTL, cpu, &d.ctl[cpu], PSTATE_CTL);
+            create_batch_op(IA32_PERF_CTL, cpu, &d.ctl_readback[cpu], PSTATE_DATA);
+            create_batch_op(IA32_PERF_STATUS, cpu, &d.status[cpu], PSTATE_DATA);
+        }
+        read_batch(PSTATE_CTL);
+    }
+    if (pd != NULL)
+    {
+        *pd = &d;
+    }
+}
+
+int pstate_sync(void)
+{
+    static struct pstate_data *pd = NULL;
+
+    if (pd == NULL)
+    {
+        pstate_storage(&pd);
+    }
+    pstate_lock();
+    if (read_batch(PSTATE_CTL))
+    {
+        pstate_unlock();
+        libmsr_error_handler("pstate_sync(): Unable to read IA32_PERF_CTL", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    pstate_unlock();
+    return 0;
+}
+
+/// @brief Write the PSTATE_CTL batch and optionally check the requested
+/// ratios against a fused IA32_PERF_CTL/IA32_PERF_STATUS readback.
+///
+/// @param [in] pd Per-thread p-state data.
+///
+/// @param [in] expect Array of requested ratios per thread, 0 for threads
+/// not part of the request.
+///
+/// @param [in] verify If non-zero, read back and compare.
+///
+/// Must be called with pstate_lock() held.
+///
+/// @return 0 if successful, number of mismatching threads if verify is set,
+/// else -1 if a batch failed.
+static int apply_pstate(struct pstate_data *pd, const uint64_t *expect, int verify)
+{
+    uint64_t cpu;
+    int mismatch = 0;
+
+    if (write_batch(PSTATE_CTL))
+    {
+        libmsr_error_handler("apply_pstate(): Unable to write IA32_PERF_CTL", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    if (!verify)
+    {
+        return 0;
+    }
+    if (read_batch(PSTATE_DATA))
+    {
+        libmsr_error_handler("apply_pstate(): Unable to read back IA32_PERF_CTL", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    for (cpu = 0; cpu < pd->num_threads; cpu++)
+    {
+        /* IA32_PERF_STATUS lags the request by the transition latency, so
+         * only the readback of IA32_PERF_CTL is compared. */
+        if (expect[cpu] && PSTATE_CTL_RATIO(*pd->ctl_readback[cpu]) != expect[cpu])
+        {
+            mismatch++;
+        }
+        /* The readback is fresher than the shadow. */
+        *pd->ctl[cpu] = *pd->ctl_readback[cpu];
+    }
+    return mismatch;
+}
+
+int set_pstate_mask(const uint64_t *cpumask, uint64_t ratio, int verify)
+{
+    static struct pstate_data *pd = NULL;
+    static uint64_t *expect = NULL;
+    uint64_t cpu;
+    int ret;
+
+    if (ratio == 0 || ratio > 0xFF)
+    {
+        libmsr_error_handler("set_pstate_mask(): Ratio out of range", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    pstate_lock();
+    if (pd == NULL)
+    {
+        pstate_storage(&pd);
+        expect = (uint64_t *) libmsr_calloc(pd->num_threads, sizeof(uint64_t));
+    }
+    for (cpu = 0; cpu < pd->num_threads; cpu++)
+    {
+        expect[cpu] = 0;
+        if (CPUMASK_ISSET(cpumask, cpu))
+        {
+            *pd->ctl[cpu] = (*pd->ctl[cpu] & ~PSTATE_RATIO_MASK) | (ratio << PSTATE_RATIO_SHIFT);
+            expect[cpu] = ratio;
+        }
+    }
+    ret = apply_pstate(pd, expect, verify);
+    pstate_unlock();
+    return ret;
+}
+
+int set_pstate_array(const uint64_t *ratios, int verify)
+{
+    static struct pstate_data *pd = NULL;
+    uint64_t cpu;
+    int ret;
+
+    if (pd == NULL)
+    {
+        pstate_storage(&pd);
+    }
+    for (cpu = 0; cpu < pd->num_threads; cpu++)
+    {
+        if (ratios[cpu] > 0xFF)
+        {
+            libmsr_error_handler("set_pstate_array(): Ratio out of range", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+            return -1;
+        }
+    }
+    pstate_lock();
+    for (cpu = 0; cpu < pd->num_threads; cpu++)
+    {
+        if (ratios[cpu])
+        {
+            *pd->ctl[cpu] = (*pd->ctl[cpu] & ~PSTATE_RATIO_MASK) | (ratios[cpu] << PSTATE_RATIO_SHIFT);
+        }
+    }
+    ret = apply_pstate(pd, ratios, verify);
+    pstate_unlock();
+    return ret;
+}
+
+int get_pstate(uint64_t *current, uint64_t *requested)
+{
+    static struct pstate_data *pd = NULL;
+    uint64_t cpu;
+
+    if (pd == NULL)
+    {
+        pstate_storage(&pd);
+    }
+    pstate_lock();
+    if (read_batch(PSTATE_DATA))
+    {
+        pstate_unlock();
+        libmsr_error_handler("get_pstate(): Unable to read IA32_PERF_STATUS", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    for (cpu = 0; cpu < pd->num_threads; cpu++)
+    {
+        if (current != NULL)
+        {
+            current[cpu] = PSTATE_STATUS_RATIO(*pd->status[cpu]);
+        }
+        if (requested != NULL)
+        {
+            requested[cpu] = PSTATE_CTL_RATIO(*pd->ctl_readback[cpu]);
+        }
+    }
+    pstate_unlock();
+    return 0;
+}
+
+void dump_pstate(FILE *writedest)
+{
+    static struct pstate_data *pd = NULL;
+    static uint64_t *current = NULL;
+    static uint64_t *requested = NULL;
+    uint64_t cpu;
+
+    if (pd == NULL)
+    {
+        pstate_storage(&pd);
+        current = (uint64_t *) libmsr_calloc(pd->num_threads, sizeof(uint64_t));
+        requested = (uint64_t *) libmsr_calloc(pd->num_threads, sizeof(uint64_t));
+    }
+    /* Decode under the lock in get_pstate() rather than from the batch,
+     * which the governor may be reading back concurrently. */
+    if (get_pstate(current, requested))
+    {
+        return;
+    }
+    for (cpu = 0; cpu < pd->num_threads; cpu++)
+    {
+        fprintf(writedest, "cpu%02lu: requested %4lu MHz current %4lu MHz\n", cpu, requested[cpu] * 100, current[cpu] * 100);
+    }
+}
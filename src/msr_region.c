@@ -0,0 +1,645 @@
+/* msr_region.c
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "msr_core.h"
+#include "msr_region.h"
+#include "msr_rapl.h"
+#include "msr_counters.h"
+#include "memhdlr.h"
+#include "cpuid.h"
+#include "libmsr_error.h"
+#include "libmsr_debug.h"
+
+/// @brief Number of per-thread counters in a snapshot (IA32_FIXED_CTR[0-2],
+/// IA32_APERF, IA32_MPERF).
+#define REGION_NUM_COUNTERS 5
+
+/// @brief Structure containing the totals of one region in a per-thread table.
+struct region_entry {
+    /// @brief Full path of the region.
+    char path[REGION_PATH_SIZE];
+    /// @brief Hash of the path.
+    uint64_t hash;
+    /// @brief Nesting depth of the region (0 is outermost).
+    unsigned depth;
+    /// @brief Accumulated totals.
+    struct region_totals totals;
+    /// @brief Next entry in the same hash bucket.
+    struct region_entry *next;
+};
+
+/// @brief Hash table of regions recorded by a single thread.
+struct region_shard {
+    struct region_entry *buckets[REGION_HASH_BUCKETS];
+    unsigned numentries;
+};
+
+/// @brief Open region on a thread's stack.
+struct region_frame {
+    /// @brief Entry receiving the totals when the region ends.
+    struct region_entry *entry;
+    /// @brief Length of the enclosing path, restored when the region ends.
+    size_t parent_len;
+    /// @brief Offset of this region's name within the path.
+    size_t name_off;
+    /// @brief Logical processor whose counters were sampled at begin.
+    int cpu;
+    /// @brief Time when the region began.
+    struct timespec start;
+};
+
+/// @brief Per-thread region stack, shard, and private batch.
+struct region_thread {
+    unsigned depth;
+    char path[REGION_PATH_SIZE];
+    struct region_frame frames[REGION_MAX_DEPTH];
+    /// @brief Raw snapshots, one per open region plus one scratch snapshot.
+    uint64_t *snap;
+    /// @brief Batch read by this thread only (see region_batch_storage()).
+    struct msr_batch_array batch;
+    struct region_shard *shard;
+    struct region_batch *rb;
+};
+
+/// @brief Layout of the per-thread region batch.
+struct region_batch {
+    /// @brief Number of values in one snapshot.
+    uint64_t numvals;
+    uint64_t sockets;
+    /// @brief Index of the first per-thread counter in a snapshot.
+    uint64_t counters;
+    /// @brief Inverse of the package energy unit per socket.
+    double *pkg_units;
+    /// @brief Inverse of the DRAM energy unit per socket.
+    double *dram_units;
+    /// @brief Non-zero if MSR_DRAM_ENERGY_STATUS is in the batch.
+    int have_dram;
+    /// @brief Mask matching the width of the fixed-function counters.
+    uint64_t fixed_mask;
+};
+
+/* Serializes region setup, shard creation, merging, and the memory handler.
+ * Markers only take it the first time a thread or region is seen. */
+static pthread_mutex_t region_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct region_shard *region_shards[REGION_MAX_SHARDS];
+static unsigned region_numshards = 0;
+static unsigned region_generation = 1;
+
+static __thread struct region_thread *region_tls = NULL;
+static __thread unsigned region_tls_generation = 0;
+
+/// @brief Store the layout of the per-thread region batch.
+///
+/// Snapshot layout (N sockets): [0,N) MSR_PKG_ENERGY_STATUS, [N,2N)
+/// MSR_DRAM_ENERGY_STATUS (if supported), followed by IA32_FIXED_CTR0,
+/// IA32_FIXED_CTR1, IA32_FIXED_CTR2, IA32_APERF, and IA32_MPERF of the
+/// logical processor the calling thread runs on. Must be called with
+/// region_lock held.
+///
+/// @param [out] rb Pointer to batch layout, NULL if not yet initialized.
+///
+/// @param [in] reset Forget the current layout (used at finalize).
+static void region_batch_storage(struct region_batch **rb, int reset)
+{
+    static struct region_batch b;
+    static int init = 0;
+
+    if (reset)
+    {
+        init = 0;
+        return;
+    }
+    if (!init)
+    {
+        uint64_t *rapl_flags = NULL;
+        struct rapl_units *ru = NULL;
+        uint64_t model = 0;
+        int width;
+        int i;
+
+        if (rapl_storage(NULL, &rapl_flags))
+        {
+            *rb = NULL;
+            return;
+        }
+        b.sockets = num_sockets();
+        b.have_dram = (*rapl_flags & DRAM_ENERGY_STATUS) ? 1 : 0;
+        b.counters = (1 + b.have_dram) * b.sockets;
+        b.numvals = b.counters + REGION_NUM_COUNTERS;
+        b.pkg_units = (double *) libmsr_calloc(b.sockets, sizeof(double));
+        b.dram_units = (double *) libmsr_calloc(b.sockets, sizeof(double));
+
+        ru = (struct rapl_units *) libmsr_calloc(b.sockets, sizeof(struct rapl_units));
+        get_rapl_power_unit(ru);
+        cpuid_get_model(&model);
+        for (i = 0; i < b.sockets; i++)
+        {
+            b.pkg_units[i] = ru[i].joules;
+            /* Haswell-EP DRAM domain uses a fixed energy unit. */
+            b.dram_units[i] = (model == 0x3F ? STD_ENERGY_UNIT : ru[i].joules);
+        }
+        libmsr_free(ru);
+        width = cpuid_width_fixed_counters();
+        b.fixed_mask = (width > 0 && width < 64) ? MASK_RANGE(width - 1, 0) : ~((uint64_t)0);
+        init = 1;
+    }
+    *rb = &b;
+}
+
+/// @brief Fill in the ops of a thread's private batch.
+///
+/// The cpu of the counter ops is set by region_sample() on every read.
+static void region_batch_load(struct region_batch *rb, struct msr_batch_op *ops)
+{
+    static const off_t counters[REGION_NUM_COUNTERS] = {
+        IA32_FIXED_CTR0, IA32_FIXED_CTR1, IA32_FIXED_CTR2, IA32_APERF, IA32_MPERF
+    };
+    uint64_t i;
+
+    for (i = 0; i < rb->numvals; i++)
+    {
+        ops[i].isrdmsr = 1;
+    }
+    for (i = 0; i < rb->sockets; i++)
+    {
+        ops[i].cpu = (__u16) socket_batch_idx(i);
+        ops[i].msr = MSR_PKG_ENERGY_STATUS;
+        if (rb->have_dram)
+        {
+            ops[rb->sockets + i].cpu = ops[i].cpu;
+            ops[rb->sockets + i].msr = MSR_DRAM_ENERGY_STATUS;
+        }
+    }
+    for (i = 0; i < REGION_NUM_COUNTERS; i++)
+    {
+        ops[rb->counters + i].msr = counters[i];
+    }
+}
+
+/// @brief FNV-1a hash of a region path.
+static uint64_t region_hash(const char *path)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    while (*path)
+    {
+        h ^= (uint64_t)(unsigned char)*path++;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/// @brief Find a region in a table.
+static struct region_entry *region_find(struct region_shard *shard, const char *path, uint64_t hash)
+{
+    struct region_entry *e;
+
+    for (e = shard->buckets[hash % REGION_HASH_BUCKETS]; e != NULL; e = e->next)
+    {
+        if (e->hash == hash && strcmp(e->path, path) == 0)
+        {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+/// @brief Link a zeroed entry into a table.
+///
+/// Per-thread shards are only modified with region_lock held, since
+/// region_merge() walks them from other threads.
+static void region_insert(struct region_shard *shard, struct region_entry *e, const char *path, uint64_t hash, unsigned depth)
+{
+    unsigned bucket = hash % REGION_HASH_BUCKETS;
+
+    snprintf(e->path, REGION_PATH_SIZE, "%s", path);
+    e->hash = hash;
+    e->depth = depth;
+    e->next = shard->buckets[bucket];
+    shard->buckets[bucket] = e;
+    shard->numentries++;
+}
+
+/// @brief Retrieve (and lazily create) the calling thread's region state.
+static struct region_thread *region_thread_state(void)
+{
+    struct region_batch *rb = NULL;
+    struct region_thread *t;
+
+    if (region_tls != NULL && region_tls_generation == __atomic_load_n(&region_generation, __ATOMIC_ACQUIRE))
+    {
+        return region_tls;
+    }
+    if (libmsr_region_init())
+    {
+        return NULL;
+    }
+    pthread_mutex_lock(&region_lock);
+    if (region_numshards >= REGION_MAX_SHARDS)
+    {
+        pthread_mutex_unlock(&region_lock);
+        libmsr_error_handler("region_thread_state(): Too many threads recording regions", LIBMSR_ERROR_ARRAY_BOUNDS, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return NULL;
+    }
+    region_batch_storage(&rb, 0);
+    t = (struct region_thread *) libmsr_calloc(1, sizeof(struct region_thread));
+    t->rb = rb;
+    t->snap = (uint64_t *) libmsr_calloc((REGION_MAX_DEPTH + 1) * rb->numvals, sizeof(uint64_t));
+    t->batch.numops = rb->numvals;
+    t->batch.ops = (struct msr_batch_op *) libmsr_calloc(rb->numvals, sizeof(struct msr_batch_op));
+    region_batch_load(rb, t->batch.ops);
+    t->shard = (struct region_shard *) libmsr_calloc(1, sizeof(struct region_shard));
+    region_shards[region_numshards++] = t->shard;
+    region_tls_generation = region_generation;
+    pthread_mutex_unlock(&region_lock);
+
+    region_tls = t;
+    return t;
+}
+
+/// @brief Read the calling thread's private batch and copy the values into a
+/// snapshot.
+///
+/// @param [in] cpu Logical processor whose counters are read.
+static int region_sample(struct region_thread *t, int cpu, uint64_t *snap, struct timespec *ts)
+{
+    struct region_batch *rb = t->rb;
+    int i;
+    int ret;
+
+    for (i = 0; i < REGION_NUM_COUNTERS; i++)
+    {
+        t->batch.ops[rb->counters + i].cpu = (__u16) cpu;
+    }
+    ret = read_batch_array(&t->batch);
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    for (i = 0; i < rb->numvals; i++)
+    {
+        snap[i] = (uint64_t) t->batch.ops[i].msrdata;
+    }
+    return ret;
+}
+
+/// @brief Add the difference between two snapshots to a region's totals.
+static void region_accumulate(struct region_batch *rb, struct region_totals *tot, const uint64_t *old, const uint64_t *cur, const struct timespec *start, const struct timespec *stop)
+{
+    uint64_t base = 0;
+    uint64_t *sum[REGION_NUM_COUNTERS];
+    int i, k;
+
+    tot->calls++;
+    tot->seconds += (double)(stop->tv_sec - start->tv_sec) + (stop->tv_nsec - start->tv_nsec) / 1000000000.0;
+
+    /* Energy status registers are 32 bits wide. */
+    for (i = 0; i < rb->sockets; i++)
+    {
+        tot->pkg_joules += (double)((cur[i] - old[i]) & 0xFFFFFFFF) / rb->pkg_units[i];
+    }
+    base += rb->sockets;
+    if (rb->have_dram)
+    {
+        for (i = 0; i < rb->sockets; i++)
+        {
+            tot->dram_joules += (double)((cur[base + i] - old[base + i]) & 0xFFFFFFFF) / rb->dram_units[i];
+        }
+    }
+
+    sum[0] = &tot->inst_retired;
+    sum[1] = &tot->core_cycles;
+    sum[2] = &tot->ref_cycles;
+    sum[3] = &tot->aperf;
+    sum[4] = &tot->mperf;
+    for (k = 0, base = rb->counters; k < REGION_NUM_COUNTERS; k++, base++)
+    {
+        /* Fixed counters wrap at their reported width, APERF/MPERF at 64. */
+        uint64_t mask = (k < 3 ? rb->fixed_mask : ~((uint64_t)0));
+        *sum[k] += (cur[base] - old[base]) & mask;
+    }
+}
+
+int libmsr_region_init(void)
+{
+    struct region_batch *rb = NULL;
+    static unsigned init_generation = 0;
+
+    pthread_mutex_lock(&region_lock);
+    if (init_generation != region_generation)
+    {
+        enable_fixed_counters();
+        region_batch_storage(&rb, 0);
+        if (rb == NULL)
+        {
+            pthread_mutex_unlock(&region_lock);
+            return -1;
+        }
+        init_generation = region_generation;
+    }
+    pthread_mutex_unlock(&region_lock);
+    return 0;
+}
+
+int libmsr_region_begin(const char *name)
+{
+    struct region_thread *t;
+    struct region_frame *f;
+    size_t len, namelen;
+    uint64_t hash;
+
+    if (name == NULL)
+    {
+        return -1;
+    }
+    t = region_thread_state();
+    if (t == NULL)
+    {
+        return -1;
+    }
+    if (t->depth >= REGION_MAX_DEPTH)
+    {
+        libmsr_error_handler("libmsr_region_begin(): Regions nested too deeply", LIBMSR_ERROR_ARRAY_BOUNDS, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    len = strlen(t->path);
+    namelen = strlen(name);
+    if (len + namelen + 2 > REGION_PATH_SIZE)
+    {
+        libmsr_error_handler("libmsr_region_begin(): Region path too long", LIBMSR_ERROR_ARRAY_BOUNDS, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+
+    f = &t->frames[t->depth];
+    f->parent_len = len;
+    if (t->depth > 0)
+    {
+        t->path[len++] = '/';
+    }
+    f->name_off = len;
+    memcpy(&t->path[len], name, namelen + 1);
+
+    hash = region_hash(t->path);
+    f->entry = region_find(t->shard, t->path, hash);
+    if (f->entry == NULL)
+    {
+        pthread_mutex_lock(&region_lock);
+        f->entry = (struct region_entry *) libmsr_calloc(1, sizeof(struct region_entry));
+        region_insert(t->shard, f->entry, t->path, hash, t->depth);
+        pthread_mutex_unlock(&region_lock);
+    }
+    f->cpu = sched_getcpu();
+    if (f->cpu < 0)
+    {
+        libmsr_error_handler("libmsr_region_begin(): Could not determine current CPU", LIBMSR_ERROR_PLATFORM_ENV, getenv("HOSTNAME"), __FILE__, __LINE__);
+        t->path[f->parent_len] = '\0';
+        return -1;
+    }
+    /* Sample last so setup cost is not charged to the region. */
+    if (region_sample(t, f->cpu, &t->snap[t->depth * t->rb->numvals], &f->start))
+    {
+        t->path[f->parent_len] = '\0';
+        return -1;
+    }
+    t->depth++;
+    return 0;
+}
+
+int libmsr_region_end(const char *name)
+{
+    struct region_thread *t;
+    struct region_frame *f;
+    struct timespec stop;
+    uint64_t *scratch;
+
+    if (name == NULL)
+    {
+        return -1;
+    }
+    t = region_thread_state();
+    if (t == NULL)
+    {
+        return -1;
+    }
+    if (t->depth == 0)
+    {
+        libmsr_error_handler("libmsr_region_end(): No open region", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    f = &t->frames[t->depth - 1];
+    scratch = &t->snap[REGION_MAX_DEPTH * t->rb->numvals];
+    /* Sample first so bookkeeping cost is not charged to the region. Read the
+     * same logical processor as at begin, even if the thread migrated. */
+    if (region_sample(t, f->cpu, scratch, &stop))
+    {
+        return -1;
+    }
+    if (strcmp(&t->path[f->name_off], name) != 0)
+    {
+        libmsr_error_handler("libmsr_region_end(): Name does not match innermost open region", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    region_accumulate(t->rb, &f->entry->totals, &t->snap[(t->depth - 1) * t->rb->numvals], scratch, &f->start, &stop);
+    t->path[f->parent_len] = '\0';
+    t->depth--;
+    return 0;
+}
+
+/// @brief Merge all per-thread shards into one table.
+///
+/// Must be called with region_lock held. Entries of the merged table are
+/// scratch memory owned by the caller, released with region_free_table().
+///
+/// @param [out] merged Table receiving the merged totals.
+///
+/// @return Number of distinct regions, else -1 if an allocation fails.
+static int region_merge(struct region_shard *merged)
+{
+    struct region_entry *e, *m;
+    unsigned s, b;
+
+    for (s = 0; s < region_numshards; s++)
+    {
+        for (b = 0; b < REGION_HASH_BUCKETS; b++)
+        {
+            for (e = region_shards[s]->buckets[b]; e != NULL; e = e->next)
+            {
+                m = region_find(merged, e->path, e->hash);
+                if (m == NULL)
+                {
+                    m = (struct region_entry *) calloc(1, sizeof(struct region_entry));
+                    if (m == NULL)
+                    {
+                        libmsr_error_handler("region_merge(): Could not allocate merged region", LIBMSR_ERROR_MEMORY_ALLOCATION, getenv("HOSTNAME"), __FILE__, __LINE__);
+                        return -1;
+                    }
+                    region_insert(merged, m, e->path, e->hash, e->depth);
+                }
+                m->totals.calls += e->totals.calls;
+                m->totals.seconds += e->totals.seconds;
+                m->totals.pkg_joules += e->totals.pkg_joules;
+                m->totals.dram_joules += e->totals.dram_joules;
+                m->totals.inst_retired += e->totals.inst_retired;
+                m->totals.core_cycles += e->totals.core_cycles;
+                m->totals.ref_cycles += e->totals.ref_cycles;
+                m->totals.aperf += e->totals.aperf;
+                m->totals.mperf += e->totals.mperf;
+            }
+        }
+    }
+    return merged->numentries;
+}
+
+/// @brief Release the entries of a merged table.
+static void region_free_table(struct region_shard *table)
+{
+    struct region_entry *e, *next;
+    unsigned b;
+
+    for (b = 0; b < REGION_HASH_BUCKETS; b++)
+    {
+        for (e = table->buckets[b]; e != NULL; e = next)
+        {
+            next = e->next;
+            free(e);
+        }
+        table->buckets[b] = NULL;
+    }
+    table->numentries = 0;
+}
+
+int libmsr_region_get(const char *path, struct region_totals *totals)
+{
+    struct region_shard merged;
+    struct region_entry *e;
+    int ret = -1;
+    int n;
+
+    if (path == NULL || totals == NULL)
+    {
+        return -1;
+    }
+    memset(&merged, 0, sizeof(merged));
+    pthread_mutex_lock(&region_lock);
+    n = region_merge(&merged);
+    pthread_mutex_unlock(&region_lock);
+    e = (n > 0 ? region_find(&merged, path, region_hash(path)) : NULL);
+    if (e != NULL)
+    {
+        *totals = e->totals;
+        ret = 0;
+    }
+    region_free_table(&merged);
+    return ret;
+}
+
+static int region_cmp(const void *a, const void *b)
+{
+    return strcmp((*(struct region_entry **)a)->path, (*(struct region_entry **)b)->path);
+}
+
+void dump_region_data(FILE *writedest)
+{
+    struct region_shard merged;
+    struct region_entry **sorted;
+    struct region_entry *e;
+    unsigned b, i;
+    int n;
+
+    memset(&merged, 0, sizeof(merged));
+    pthread_mutex_lock(&region_lock);
+    n = region_merge(&merged);
+    pthread_mutex_unlock(&region_lock);
+    if (n <= 0)
+    {
+        region_free_table(&merged);
+        return;
+    }
+    sorted = (struct region_entry **) malloc(n * sizeof(struct region_entry *));
+    if (sorted == NULL)
+    {
+        libmsr_error_handler("dump_region_data(): Could not allocate sorted regions", LIBMSR_ERROR_MEMORY_ALLOCATION, getenv("HOSTNAME"), __FILE__, __LINE__);
+        region_free_table(&merged);
+        return;
+    }
+    for (b = 0, i = 0; b < REGION_HASH_BUCKETS; b++)
+    {
+        for (e = merged.buckets[b]; e != NULL; e = e->next)
+        {
+            sorted[i++] = e;
+        }
+    }
+    qsort(sorted, n, sizeof(struct region_entry *), region_cmp);
+
+    fprintf(writedest, "region depth calls seconds pkg_J dram_J pkg_W inst_ret core_cyc ref_cyc IPC aperf/mperf\n");
+    for (i = 0; i < n; i++)
+    {
+        struct region_totals *t = &sorted[i]->totals;
+        fprintf(writedest, "%s %u %lu %.6lf %.4lf %.4lf %.4lf %lu %lu %lu %.4lf %.4lf\n",
+                sorted[i]->path, sorted[i]->depth, t->calls, t->seconds,
+                t->pkg_joules, t->dram_joules,
+                (t->seconds > 0.0 ? t->pkg_joules / t->seconds : 0.0),
+                t->inst_retired, t->core_cycles, t->ref_cycles,
+                (t->core_cycles ? (double)t->inst_retired / t->core_cycles : 0.0),
+                (t->mperf ? (double)t->aperf / t->mperf : 0.0));
+    }
+    free(sorted);
+    region_free_table(&merged);
+}
+
+void libmsr_region_finalize(void)
+{
+    unsigned n;
+
+    pthread_mutex_lock(&region_lock);
+    n = region_numshards;
+    pthread_mutex_unlock(&region_lock);
+    if (n == 0)
+    {
+        return;
+    }
+    dump_region_data(stdout);
+    /* Storage is released by memhdlr_finalize(), so forget all of it. */
+    pthread_mutex_lock(&region_lock);
+    region_numshards = 0;
+    __atomic_store_n(&region_generation, region_generation + 1, __ATOMIC_RELEASE);
+    region_batch_storage(NULL, 1);
+    pthread_mutex_unlock(&region_lock);
+}
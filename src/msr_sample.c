@@ -0,0 +1,131 @@
+/* msr_sample.c
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "msr_core.h"
+#include "msr_sample.h"
+#include "csr_core.h"
+#include "libmsr_error.h"
+#include "libmsr_debug.h"
+
+void libmsr_sample_init(struct sample_txn *txn)
+{
+    txn->num_msr = 0;
+    txn->num_csr = 0;
+    txn->tsc = 0;
+    txn->timestamp = 0.0;
+    txn->skew_tsc = 0;
+    txn->skew = 0.0;
+    txn->msr_time = 0.0;
+    txn->csr_time = 0.0;
+    txn->msr_tsc = 0;
+    txn->csr_tsc = 0;
+    txn->csr_failed = 0;
+}
+
+int libmsr_sample_add_msr(struct sample_txn *txn, const int batchnum)
+{
+    if (txn->num_msr >= SAMPLE_MAX_BATCHES)
+    {
+        libmsr_error_handler("libmsr_sample_add_msr(): Too many MSR batches in sampling transaction", LIBMSR_ERROR_ARRAY_BOUNDS, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    txn->msr_batches[txn->num_msr++] = batchnum;
+    return 0;
+}
+
+int libmsr_sample_add_csr(struct sample_txn *txn, const int batchnum)
+{
+    if (txn->num_csr >= SAMPLE_MAX_BATCHES)
+    {
+        libmsr_error_handler("libmsr_sample_add_csr(): Too many CSR batches in sampling transaction", LIBMSR_ERROR_ARRAY_BOUNDS, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    txn->csr_batches[txn->num_csr++] = batchnum;
+    return 0;
+}
+
+int libmsr_sample_run(struct sample_txn *txn)
+{
+    uint64_t tsc_start, tsc_mid, tsc_end;
+    double start, mid, end;
+    unsigned i;
+    int res = 0;
+    int failed = 0;
+    int ret;
+
+    start = monotonic_time();
+    tsc_start = read_tsc();
+    for (i = 0; i < txn->num_msr; i++)
+    {
+        res |= read_batch(txn->msr_batches[i]);
+    }
+    tsc_mid = read_tsc();
+    mid = monotonic_time();
+    for (i = 0; i < txn->num_csr; i++)
+    {
+        ret = do_csr_batch_op(txn->csr_batches[i]);
+        if (ret < 0)
+        {
+            res = -1;
+        }
+        else
+        {
+            failed += ret;
+        }
+    }
+    tsc_end = read_tsc();
+    end = monotonic_time();
+
+    txn->tsc = tsc_start + (tsc_end - tsc_start) / 2;
+    txn->timestamp = (start + end) / 2.0;
+    txn->skew_tsc = tsc_end - tsc_start;
+    txn->skew = end - start;
+    txn->msr_time = mid - start;
+    txn->csr_time = end - mid;
+    txn->msr_tsc = tsc_mid - tsc_start;
+    txn->csr_tsc = tsc_end - tsc_mid;
+    txn->csr_failed = failed;
+#ifdef LIBMSR_DEBUG
+    fprintf(stderr, "%s %s::%d DEBUG: (libmsr_sample_run) %u MSR and %u CSR batches, skew %.9lf s\n", getenv("HOSTNAME"), __FILE__, __LINE__, txn->num_msr, txn->num_csr, txn->skew);
+#endif
+    return (res ? -1 : 0);
+}
+
+void dump_sample_txn(FILE *writedest, const struct sample_txn *txn)
+{
+    fprintf(writedest, "timestamp %.9lf tsc %lu skew %.9lf s (%lu ticks) msr %.9lf s (%lu ticks) csr %.9lf s (%lu ticks) csr_failed %d\n", txn->timestamp, txn->tsc, txn->skew, txn->skew_tsc, txn->msr_time, txn->msr_tsc, txn->csr_time, txn->csr_tsc, txn->csr_failed);
+}
@@ -0,0 +1,373 @@
+/* msr_topdown.c
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+#include "msr_core.h"
+#include "msr_topdown.h"
+#include "msr_counters.h"
+#include "memhdlr.h"
+#include "cpuid.h"
+#include "libmsr_error.h"
+#include "libmsr_debug.h"
+
+/// @brief Event select, umask, and cmask of each top-down event.
+static const struct {
+    uint64_t eventsel;
+    uint64_t umask;
+    uint64_t cmask;
+} topdown_events[TOPDOWN_NUM_EVENTS] = {
+    [TOPDOWN_FETCH_BUBBLES]   = {EVT_IDQ_UOPS_NOT_DELIVERED, UMASK_IDQ_UOPS_NOT_DELIVERED_CORE, 0},
+    [TOPDOWN_UOPS_ISSUED]     = {EVT_UOPS_ISSUED,            UMASK_UOPS_ISSUED_ANY,             0},
+    [TOPDOWN_UOPS_RETIRED]    = {EVT_UOPS_RETIRED,           UMASK_UOPS_RETIRED_RETIRE_SLOTS,   0},
+    [TOPDOWN_RECOVERY_CYCLES] = {EVT_INT_MISC,               UMASK_INT_MISC_RECOVERY_CYCLES,    CMASK_INT_MISC_RECOVERY_CYCLES},
+};
+
+/* IA32_PERFEVTSELx flags [23:16]: USR, OS, and EN. */
+#define TOPDOWN_EVTSEL_FLAGS 0x43
+
+int topdown_storage(struct topdown_data **td)
+{
+    static struct topdown_data d;
+    static int init = 0;
+    static const off_t pmcs[TOPDOWN_NUM_EVENTS] = {IA32_PMC0, IA32_PMC1, IA32_PMC2, IA32_PMC3};
+    uint64_t threads, cores, sockets;
+    unsigned socket, core, thread;
+    int avail, i, t;
+
+    if (!init)
+    {
+        avail = cpuid_num_pmc();
+        if (avail < 1)
+        {
+            libmsr_error_handler("topdown_storage(): No general-purpose performance counters available", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+            return -1;
+        }
+        threads = num_devs();
+        cores = num_cores();
+        sockets = num_sockets();
+        d.group_size = (avail < TOPDOWN_NUM_EVENTS ? avail : TOPDOWN_NUM_EVENTS);
+        d.num_groups = (TOPDOWN_NUM_EVENTS + d.group_size - 1) / d.group_size;
+        d.active_group = 0;
+
+        d.clk = (uint64_t **) libmsr_calloc(threads, sizeof(uint64_t *));
+        d.old_clk = (uint64_t *) libmsr_calloc(threads, sizeof(uint64_t));
+        d.core_of = (unsigned *) libmsr_calloc(threads, sizeof(unsigned));
+        for (i = 0; i < TOPDOWN_NUM_EVENTS; i++)
+        {
+            d.pmc[i] = (uint64_t **) libmsr_calloc(threads, sizeof(uint64_t *));
+            d.old_pmc[i] = (uint64_t *) libmsr_calloc(threads, sizeof(uint64_t));
+            d.core_rate[i] = (double *) libmsr_calloc(cores, sizeof(double));
+            d.socket_rate[i] = (double *) libmsr_calloc(sockets, sizeof(double));
+        }
+        d.core = (struct topdown_fractions *) libmsr_calloc(cores, sizeof(struct topdown_fractions));
+        d.socket = (struct topdown_fractions *) libmsr_calloc(sockets, sizeof(struct topdown_fractions));
+
+        allocate_batch(TOPDOWN_DATA, (1 + d.group_size) * threads);
+        load_thread_batch(IA32_FIXED_CTR1, d.clk, TOPDOWN_DATA);
+        for (i = 0; i < d.group_size; i++)
+        {
+            load_thread_batch(pmcs[i], d.pmc[i], TOPDOWN_DATA);
+        }
+        for (t = 0; t < threads; t++)
+        {
+            thread_batch_coord(t, &socket, &core, &thread);
+            d.core_of[t] = socket * cores_per_socket() + core;
+        }
+        init = 1;
+    }
+    if (td != NULL)
+    {
+        *td = &d;
+    }
+    return 0;
+}
+
+/// @brief Program the events of one group on every thread with one batch
+/// write.
+static int topdown_program_group(struct topdown_data *td, int group)
+{
+    static uint64_t threads = 0;
+    int i, e, t;
+
+    if (!threads)
+    {
+        threads = num_devs();
+    }
+    for (t = 0; t < threads; t++)
+    {
+        for (i = 0; i < td->group_size; i++)
+        {
+            e = group * td->group_size + i;
+            if (e < TOPDOWN_NUM_EVENTS)
+            {
+                set_pmc_ctrl_flags(topdown_events[e].cmask, TOPDOWN_EVTSEL_FLAGS, topdown_events[e].umask, topdown_events[e].eventsel, i + 1, t);
+            }
+            else
+            {
+                set_pmc_ctrl_flags(0, 0, 0, 0, i + 1, t);
+            }
+        }
+    }
+    return write_batch(COUNTERS_CTRL);
+}
+
+/// @brief Sample the counters and use them as the new baseline.
+static int topdown_baseline(struct topdown_data *td)
+{
+    static uint64_t threads = 0;
+    int i, t;
+
+    if (!threads)
+    {
+        threads = num_devs();
+    }
+    if (read_batch(TOPDOWN_DATA))
+    {
+        return -1;
+    }
+    for (t = 0; t < threads; t++)
+    {
+        td->old_clk[t] = *td->clk[t];
+        for (i = 0; i < td->group_size; i++)
+        {
+            td->old_pmc[i][t] = *td->pmc[i][t];
+        }
+    }
+    return 0;
+}
+
+/// @brief Convert events per slot into the level 1 breakdown.
+static void topdown_breakdown(double *rate[TOPDOWN_NUM_EVENTS], int idx, struct topdown_fractions *f)
+{
+    double sum;
+
+    f->frontend_bound = rate[TOPDOWN_FETCH_BUBBLES][idx];
+    f->bad_speculation = rate[TOPDOWN_UOPS_ISSUED][idx] - rate[TOPDOWN_UOPS_RETIRED][idx] + TOPDOWN_SLOTS_PER_CYCLE * rate[TOPDOWN_RECOVERY_CYCLES][idx];
+    f->retiring = rate[TOPDOWN_UOPS_RETIRED][idx];
+    /* Counter skew can push a category slightly outside [0,1]. */
+    f->frontend_bound = (f->frontend_bound < 0.0 ? 0.0 : (f->frontend_bound > 1.0 ? 1.0 : f->frontend_bound));
+    f->bad_speculation = (f->bad_speculation < 0.0 ? 0.0 : (f->bad_speculation > 1.0 ? 1.0 : f->bad_speculation));
+    f->retiring = (f->retiring < 0.0 ? 0.0 : (f->retiring > 1.0 ? 1.0 : f->retiring));
+    sum = f->frontend_bound + f->bad_speculation + f->retiring;
+    f->backend_bound = (sum < 1.0 ? 1.0 - sum : 0.0);
+}
+
+int enable_topdown(void)
+{
+    static uint64_t threads = 0;
+    struct topdown_data *td = NULL;
+    uint64_t **perf_global_ctrl = NULL;
+    int t;
+
+    if (topdown_storage(&td))
+    {
+        return -1;
+    }
+    if (!threads)
+    {
+        threads = num_devs();
+    }
+    /* FIXED_CTR1 counts with AnyThread set, i.e., cycles of the whole core. */
+    enable_fixed_counters();
+    fixed_counter_ctrl_storage(&perf_global_ctrl, NULL);
+    read_batch(FIXED_COUNTERS_CTR_DATA);
+    for (t = 0; t < threads; t++)
+    {
+        *perf_global_ctrl[t] |= MASK_RANGE(td->group_size - 1, 0);
+    }
+    write_batch(FIXED_COUNTERS_CTR_DATA);
+
+    td->active_group = 0;
+    if (topdown_program_group(td, td->active_group))
+    {
+        return -1;
+    }
+    return topdown_baseline(td);
+}
+
+int poll_topdown_data(void)
+{
+    static uint64_t threads = 0;
+    static uint64_t cores = 0;
+    static uint64_t sockets = 0;
+    static uint64_t clk_mask = 0;
+    static uint64_t pmc_mask = 0;
+    static uint64_t *core_clk = NULL;
+    static uint64_t *core_evt[TOPDOWN_NUM_EVENTS];
+    static double *socket_slots = NULL;
+    static double *socket_evt[TOPDOWN_NUM_EVENTS];
+    struct topdown_data *td = NULL;
+    uint64_t cur, delta;
+    double slots;
+    int i, e, t, c, s;
+
+    if (topdown_storage(&td))
+    {
+        return -1;
+    }
+    if (!threads)
+    {
+        threads = num_devs();
+        cores = num_cores();
+        sockets = num_sockets();
+        i = cpuid_width_fixed_counters();
+        clk_mask = (i > 0 && i < 64 ? MASK_RANGE(i - 1, 0) : ~((uint64_t)0));
+        i = cpuid_width_pmc();
+        pmc_mask = (i > 0 && i < 64 ? MASK_RANGE(i - 1, 0) : ~((uint64_t)0));
+        core_clk = (uint64_t *) libmsr_calloc(cores, sizeof(uint64_t));
+        socket_slots = (double *) libmsr_calloc(sockets, sizeof(double));
+        for (i = 0; i < TOPDOWN_NUM_EVENTS; i++)
+        {
+            core_evt[i] = (uint64_t *) libmsr_calloc(cores, sizeof(uint64_t));
+            socket_evt[i] = (double *) libmsr_calloc(sockets, sizeof(double));
+        }
+    }
+    if (read_batch(TOPDOWN_DATA))
+    {
+        return -1;
+    }
+
+    for (c = 0; c < cores; c++)
+    {
+        core_clk[c] = 0;
+        for (i = 0; i < td->group_size; i++)
+        {
+            core_evt[i][c] = 0;
+        }
+    }
+    for (t = 0; t < threads; t++)
+    {
+        c = td->core_of[t];
+        cur = *td->clk[t];
+        delta = (cur - td->old_clk[t]) & clk_mask;
+        td->old_clk[t] = cur;
+        /* Sibling threads see the same AnyThread core cycles. */
+        if (delta > core_clk[c])
+        {
+            core_clk[c] = delta;
+        }
+        for (i = 0; i < td->group_size; i++)
+        {
+            cur = *td->pmc[i][t];
+            core_evt[i][c] += (cur - td->old_pmc[i][t]) & pmc_mask;
+            td->old_pmc[i][t] = cur;
+        }
+    }
+
+    for (s = 0; s < sockets; s++)
+    {
+        socket_slots[s] = 0.0;
+        for (i = 0; i < td->group_size; i++)
+        {
+            socket_evt[i][s] = 0.0;
+        }
+    }
+    for (c = 0; c < cores; c++)
+    {
+        s = c / cores_per_socket();
+        slots = (double)TOPDOWN_SLOTS_PER_CYCLE * core_clk[c];
+        socket_slots[s] += slots;
+        for (i = 0; i < td->group_size; i++)
+        {
+            e = td->active_group * td->group_size + i;
+            if (e >= TOPDOWN_NUM_EVENTS)
+            {
+                break;
+            }
+            socket_evt[i][s] += core_evt[i][c];
+            if (slots > 0.0)
+            {
+                td->core_rate[e][c] = core_evt[i][c] / slots;
+            }
+        }
+        topdown_breakdown(td->core_rate, c, &td->core[c]);
+    }
+    for (s = 0; s < sockets; s++)
+    {
+        for (i = 0; i < td->group_size; i++)
+        {
+            e = td->active_group * td->group_size + i;
+            if (e < TOPDOWN_NUM_EVENTS && socket_slots[s] > 0.0)
+            {
+                td->socket_rate[e][s] = socket_evt[i][s] / socket_slots[s];
+            }
+        }
+        topdown_breakdown(td->socket_rate, s, &td->socket[s]);
+    }
+
+    if (td->num_groups > 1)
+    {
+        td->active_group = (td->active_group + 1) % td->num_groups;
+        if (topdown_program_group(td, td->active_group))
+        {
+            return -1;
+        }
+        return topdown_baseline(td);
+    }
+    return 0;
+}
+
+void dump_topdown_data_label(FILE *writedest)
+{
+    fprintf(writedest, "scope id frontend_bound bad_speculation backend_bound retiring\n");
+}
+
+void dump_topdown_data(FILE *writedest)
+{
+    static uint64_t cores = 0;
+    static uint64_t sockets = 0;
+    struct topdown_data *td = NULL;
+    int i;
+
+    if (topdown_storage(&td))
+    {
+        return;
+    }
+    if (!cores)
+    {
+        cores = num_cores();
+        sockets = num_sockets();
+    }
+    for (i = 0; i < sockets; i++)
+    {
+        fprintf(writedest, "socket %d %.4lf %.4lf %.4lf %.4lf\n", i, td->socket[i].frontend_bound, td->socket[i].bad_speculation, td->socket[i].backend_bound, td->socket[i].retiring);
+    }
+    for (i = 0; i < cores; i++)
+    {
+        fprintf(writedest, "core %d %.4lf %.4lf %.4lf %.4lf\n", i, td->core[i].frontend_bound, td->core[i].bad_speculation, td->core[i].backend_bound, td->core[i].retiring);
+    }
+}
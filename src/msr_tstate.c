@@ -0,0 +1,238 @@
+/* msr_tstate.c
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "msr_core.h"
+#include "msr_tstate.h"
+#include "cpuid.h"
+#include "memhdlr.h"
+#include "libmsr_error.h"
+#include "libmsr_debug.h"
+
+void tstate_storage(struct tstate_data **td)
+{
+    static int init = 0;
+    static struct tstate_data d;
+    uint64_t cpu;
+
+    if (!init)
+    {
+        init = 1;
+        d.num_threads = num_devs();
+        d.extended = cpuid_enable_ExtendedClockMod();
+        d.clock_mod = (uint64_t **) libmsr_malloc(d.num_threads * sizeof(uint64_t *));
+        allocate_batch(TSTATE_CTL, d.num_threads);
+        for (cpu = 0; cpu < d.num_threads; cpu++)
+        {
+            create_batch_op(IA32_CLOCK_MODULATION, cpu, &d.clock_mod[cpu], TSTATE_CTL);
+        }
+        read_batch(TSTATE_CTL);
+    }
+    if (td != NULL)
+    {
+        *td = &d;
+    }
+}
+
+uint64_t tstate_encode(const struct tstate_data *td, unsigned duty)
+{
+    if (duty >= TSTATE_DUTY_OFF)
+    {
+        return 0;
+    }
+    if (!td->extended)
+    {
+        duty &= ~1U;
+        duty = (duty ? duty : 2);
+    }
+    return TSTATE_ENABLE | duty;
+}
+
+unsigned tstate_decode(const struct tstate_data *td, uint64_t raw)
+{
+    if (!(raw & TSTATE_ENABLE))
+    {
+        return TSTATE_DUTY_OFF;
+    }
+    return (unsigned) (raw & (td->extended ? TSTATE_DUTY_MASK : TSTATE_DUTY_MASK & ~1ULL));
+}
+
+/// @brief Write the TSTATE_CTL batch and optionally read it back and
+/// compare against the requested encodings.
+///
+/// @param [in] td Per-thread T-state data.
+///
+/// @param [in] expect Array of requested encodings per thread, with ~0 for
+/// threads not part of the request.
+///
+/// @param [in] verify If non-zero, read back and compare.
+///
+/// @return 0 if successful, number of mismatching threads if verify is set,
+/// else -1 if a batch failed.
+static int apply_tstate(struct tstate_data *td, const uint64_t *expect, int verify)
+{
+    uint64_t cpu;
+    int mismatch = 0;
+
+    if (write_batch(TSTATE_CTL))
+    {
+        libmsr_error_handler("apply_tstate(): Unable to write IA32_CLOCK_MODULATION", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    if (!verify)
+    {
+        return 0;
+    }
+    if (read_batch(TSTATE_CTL))
+    {
+        libmsr_error_handler("apply_tstate(): Unable to read back IA32_CLOCK_MODULATION", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    for (cpu = 0; cpu < td->num_threads; cpu++)
+    {
+        if (expect[cpu] != ~0ULL && (*td->clock_mod[cpu] & (TSTATE_ENABLE | TSTATE_DUTY_MASK)) != expect[cpu])
+        {
+            mismatch++;
+        }
+    }
+    return mismatch;
+}
+
+int get_tstate(unsigned *duty)
+{
+    static struct tstate_data *td = NULL;
+    uint64_t cpu;
+
+    if (td == NULL)
+    {
+        tstate_storage(&td);
+    }
+    if (read_batch(TSTATE_CTL))
+    {
+        libmsr_error_handler("get_tstate(): Unable to read IA32_CLOCK_MODULATION", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    if (duty != NULL)
+    {
+        for (cpu = 0; cpu < td->num_threads; cpu++)
+        {
+            duty[cpu] = tstate_decode(td, *td->clock_mod[cpu]);
+        }
+    }
+    return 0;
+}
+
+int set_tstate_mask(const uint64_t *cpumask, unsigned duty, int verify)
+{
+    static struct tstate_data *td = NULL;
+    static uint64_t *expect = NULL;
+    uint64_t cpu, bits;
+
+    if (td == NULL)
+    {
+        tstate_storage(&td);
+        expect = (uint64_t *) libmsr_calloc(td->num_threads, sizeof(uint64_t));
+    }
+    if (duty == 0 || duty > TSTATE_DUTY_OFF)
+    {
+        libmsr_error_handler("set_tstate_mask(): Duty cycle out of range", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    bits = tstate_encode(td, duty);
+    for (cpu = 0; cpu < td->num_threads; cpu++)
+    {
+        expect[cpu] = ~0ULL;
+        if (CPUMASK_ISSET(cpumask, cpu))
+        {
+            *td->clock_mod[cpu] = (*td->clock_mod[cpu] & ~(TSTATE_ENABLE | TSTATE_DUTY_MASK)) | bits;
+            expect[cpu] = bits;
+        }
+    }
+    return apply_tstate(td, expect, verify);
+}
+
+int set_tstate_array(const unsigned *duty, int verify)
+{
+    static struct tstate_data *td = NULL;
+    static uint64_t *expect = NULL;
+    uint64_t cpu;
+
+    if (td == NULL)
+    {
+        tstate_storage(&td);
+        expect = (uint64_t *) libmsr_calloc(td->num_threads, sizeof(uint64_t));
+    }
+    for (cpu = 0; cpu < td->num_threads; cpu++)
+    {
+        if (duty[cpu] > TSTATE_DUTY_OFF)
+        {
+            libmsr_error_handler("set_tstate_array(): Duty cycle out of range", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+            return -1;
+        }
+    }
+    for (cpu = 0; cpu < td->num_threads; cpu++)
+    {
+        expect[cpu] = ~0ULL;
+        if (duty[cpu])
+        {
+            expect[cpu] = tstate_encode(td, duty[cpu]);
+            *td->clock_mod[cpu] = (*td->clock_mod[cpu] & ~(TSTATE_ENABLE | TSTATE_DUTY_MASK)) | expect[cpu];
+        }
+    }
+    return apply_tstate(td, expect, verify);
+}
+
+void dump_tstate(FILE *writedest)
+{
+    static struct tstate_data *td = NULL;
+    unsigned duty;
+    uint64_t cpu;
+
+    if (td == NULL)
+    {
+        tstate_storage(&td);
+    }
+    if (get_tstate(NULL))
+    {
+        return;
+    }
+    fprintf(writedest, "extended clock modulation = %d\n", td->extended);
+    for (cpu = 0; cpu < td->num_threads; cpu++)
+    {
+        duty = tstate_decode(td, *td->clock_mod[cpu]);
+        fprintf(writedest, "cpu%02lu: raw 0x%02lx duty %2u/16 (%6.2f%%)%s\n", cpu, *td->clock_mod[cpu] & 0x1F, duty, duty * 100.0 / TSTATE_DUTY_STEPS, (duty == TSTATE_DUTY_OFF ? " disabled" : ""));
+    }
+}
@@ -37,6 +37,8 @@
 #include "msr_core.h"
 #include "msr_turbo.h"
 #include "msr_rapl.h"
+#include "msr_misc.h"
+#include "msr_pstate.h"
 #include "memhdlr.h"
 #include "libmsr_error.h"
 #include "cpuid.h"
@@ -51,79 +53,171 @@
 
 void turbo_storage(uint64_t ***val)
 {
-    static uint64_t **perf_ctl = NULL;
+    struct pstate_data *pd = NULL;
+
+    pstate_storage(&pd);
+    if (val != NULL)
+    {
+        *val = pd->ctl;
+    }
+}
+
+void turbo_data_storage(struct turbo_data **td)
+{
     static int init = 0;
-    static uint64_t numDevs = 0;
+    static struct turbo_data d;
+    uint64_t cpu;
+
     if (!init)
     {
-        numDevs = num_devs();
-        perf_ctl = (uint64_t **) libmsr_malloc(numDevs * sizeof(uint64_t *));
         init = 1;
+        d.num_threads = num_devs();
+        d.misc_enable = (uint64_t **) libmsr_malloc(d.num_threads * sizeof(uint64_t *));
+        d.perf_ctl = (uint64_t **) libmsr_malloc(d.num_threads * sizeof(uint64_t *));
+        d.state = (struct turbo_state *) libmsr_calloc(d.num_threads, sizeof(struct turbo_state));
+        allocate_batch(TURBO_DATA, 2UL * d.num_threads);
+        for (cpu = 0; cpu < d.num_threads; cpu++)
+        {
+            create_batch_op(IA32_MISC_ENABLE, cpu, &d.misc_enable[cpu], TURBO_DATA);
+            create_batch_op(IA32_PERF_CTL, cpu, &d.perf_ctl[cpu], TURBO_DATA);
+        }
     }
-    if (val != NULL)
+    if (td != NULL)
     {
-        *val = perf_ctl;
+        *td = &d;
     }
 }
 
-void enable_turbo(void)
+/// @brief Read the TURBO_DATA batch, decode the turbo state, and sync the
+/// IA32_PERF_CTL shadow.
+///
+/// Must be called with pstate_lock() held, so a concurrent p-state request
+/// cannot land between the read and the shadow update and be reverted.
+///
+/// @param [in] td Per-thread turbo data.
+///
+/// @param [in] shadow IA32_PERF_CTL shadow from turbo_storage().
+///
+/// @return 0 if successful, else -1 if the read batch failed.
+static int read_turbo_state(struct turbo_data *td, uint64_t **shadow)
 {
-    int j;
-    static uint64_t numDevs = 0;
-    static uint64_t **val =  NULL;
-    if (!numDevs)
+    uint64_t cpu;
+
+    if (read_batch(TURBO_DATA))
     {
-        numDevs = num_devs();
-        val = (uint64_t **) libmsr_malloc(numDevs * sizeof(uint64_t *));
-        turbo_storage(&val);
+        libmsr_error_handler("read_turbo_state(): Unable to read turbo state", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
     }
-    /* Set bit 32 "IDA/Turbo DISENGAGE" of IA32_PERF_CTL to 1. */
-    read_batch(PERF_CTL);
-    for (j = 0; j < numDevs; j++)
+    for (cpu = 0; cpu < td->num_threads; cpu++)
     {
-        *val[j] &= ~(((uint64_t)1) << 32);
-        fprintf(stderr, "0x%016lx\t", *val[j] & (((uint64_t)1)<<32));
+        td->state[cpu].available = !(*td->misc_enable[cpu] & TURBO_MISC_DISABLE);
+        td->state[cpu].engaged = !(*td->perf_ctl[cpu] & TURBO_PERF_CTL_DISENGAGE);
+        /* Keep the IA32_PERF_CTL shadow current for the next write. */
+        *shadow[cpu] = *td->perf_ctl[cpu];
     }
-    write_batch(PERF_CTL);
+    return 0;
 }
 
-void disable_turbo(void)
+int get_turbo_state(struct turbo_state **state)
 {
-    int j;
-    static uint64_t numDevs = 0;
-    static uint64_t **val = NULL;
-    if (!numDevs)
+    static struct turbo_data *td = NULL;
+    static uint64_t **shadow = NULL;
+    int ret;
+
+    if (td == NULL)
     {
-        numDevs = num_devs();
-        val = (uint64_t **) libmsr_malloc(numDevs * sizeof(uint64_t *));
-        turbo_storage(&val);
+        turbo_data_storage(&td);
+        turbo_storage(&shadow);
     }
-    /* Set IDA/Turbo DISENGAGE (bit 32) of IA32_PERF_CTL to 0. */
-    read_batch(PERF_CTL);
-    for (j = 0; j < numDevs; j++)
+    pstate_lock();
+    ret = read_turbo_state(td, shadow);
+    pstate_unlock();
+    if (ret)
+    {
+        return -1;
+    }
+    if (state != NULL)
     {
-        *val[j] |= ((uint64_t)1) << 32;
+        *state = td->state;
     }
-    write_batch(PERF_CTL);
+    return 0;
+}
+
+int set_turbo_mask(const uint64_t *cpumask, int enable)
+{
+    static struct turbo_data *td = NULL;
+    static uint64_t **shadow = NULL;
+    uint64_t cpu;
+
+    if (td == NULL)
+    {
+        turbo_data_storage(&td);
+        turbo_storage(&shadow);
+    }
+    /* Hold the lock from the sync to the write so the ratio written back is
+     * the one currently requested. */
+    pstate_lock();
+    if (read_turbo_state(td, shadow))
+    {
+        pstate_unlock();
+        return -1;
+    }
+    for (cpu = 0; cpu < td->num_threads; cpu++)
+    {
+        if (cpumask == NULL || CPUMASK_ISSET(cpumask, cpu))
+        {
+            if (enable)
+            {
+                *shadow[cpu] &= ~TURBO_PERF_CTL_DISENGAGE;
+            }
+            else
+            {
+                *shadow[cpu] |= TURBO_PERF_CTL_DISENGAGE;
+            }
+            td->state[cpu].engaged = (enable ? 1 : 0);
+        }
+    }
+    if (write_batch(PSTATE_CTL))
+    {
+        pstate_unlock();
+        libmsr_error_handler("set_turbo_mask(): Unable to write IA32_PERF_CTL", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    pstate_unlock();
+    return 0;
+}
+
+int enable_turbo(void)
+{
+    /* Set IDA/Turbo DISENGAGE (bit 32) of IA32_PERF_CTL to 0. */
+    return set_turbo_mask(NULL, 1);
+}
+
+int disable_turbo(void)
+{
+    /* Set IDA/Turbo DISENGAGE (bit 32) of IA32_PERF_CTL to 1. */
+    return set_turbo_mask(NULL, 0);
 }
 
 void dump_turbo(FILE *writedest)
 {
-    int core;
-    static uint64_t numDevs = 0;
-    uint64_t val;
-    if (!numDevs)
+    static struct turbo_data *td = NULL;
+    uint64_t cpu;
+
+    if (td == NULL)
+    {
+        turbo_data_storage(&td);
+    }
+    if (get_turbo_state(NULL))
     {
-        numDevs = num_devs();
+        return;
     }
-    for (core = 0; core < numDevs; core++)
+    for (cpu = 0; cpu < td->num_threads; cpu++)
     {
-        read_msr_by_idx(core, IA32_MISC_ENABLE, &val);
-        fprintf(writedest, "Core: %d\n", core);
-        fprintf(writedest, "0x%016lx\t", val & (((uint64_t)1)<<38));
+        fprintf(writedest, "Core: %lu\n", cpu);
+        fprintf(writedest, "0x%016lx\t", *td->misc_enable[cpu] & TURBO_MISC_DISABLE);
         fprintf(writedest, "| IA32_MISC_ENABLE | 38 (0 = Turbo Available) \n");
-        read_msr_by_idx(core, IA32_PERF_CTL, &val);
-        fprintf(writedest, "0x%016lx \t", val & (((uint64_t)1)<<32));
+        fprintf(writedest, "0x%016lx \t", *td->perf_ctl[cpu] & TURBO_PERF_CTL_DISENGAGE);
         fprintf(writedest, "|   IA32_PERF_CTL  | 32 (0 = Turbo Engaged) \n");
     }
 }
@@ -251,4 +345,213 @@ int get_turbo_ratio_limit(const unsigned socket, struct turbo_limit_data *info,
     }
     return 0;
 }
+
+int turbo_model_storage(struct turbo_model **tm)
+{
+    static int init = 0;
+    static int avail = 0;
+    static struct turbo_model d;
+    static uint64_t *rapl_flags = NULL;
+    uint64_t bits;
+    unsigned socket, i;
+    int regs;
+
+    if (!init)
+    {
+        init = 1;
+        if (rapl_storage(NULL, &rapl_flags))
+        {
+            return -1;
+        }
+        if (!(*rapl_flags & TURBO_RATIO_LIMIT))
+        {
+            libmsr_error_handler("turbo_model_storage(): MSR_TURBO_RATIO_LIMIT not supported", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+            return -1;
+        }
+        d.num_sockets = num_sockets();
+        d.cores_per_socket = cores_per_socket();
+        d.max_ratio = (uint8_t *) libmsr_calloc(d.num_sockets * TURBO_MODEL_MAX_CORES, sizeof(uint8_t));
+        d.num_limits = (unsigned *) libmsr_calloc(d.num_sockets, sizeof(unsigned));
+        d.old_idle = (uint64_t *) libmsr_calloc(num_cores(), sizeof(uint64_t));
+        d.active = (double *) libmsr_calloc(num_cores(), sizeof(double));
+        d.old_tsc = 0;
+        regs = (*rapl_flags & TURBO_RATIO_LIMIT1 ? 2 : 1);
+        for (socket = 0; socket < d.num_sockets; socket++)
+        {
+            read_msr_by_coord(socket, 0, 0, MSR_TURBO_RATIO_LIMIT, &bits);
+            for (i = 0; i < 8; i++)
+            {
+                d.max_ratio[socket * TURBO_MODEL_MAX_CORES + i] = MASK_VAL(bits, 8 * i + 7, 8 * i);
+            }
+            if (regs > 1)
+            {
+                read_msr_by_coord(socket, 0, 0, MSR_TURBO_RATIO_LIMIT1, &bits);
+                for (i = 0; i < 8; i++)
+                {
+                    d.max_ratio[socket * TURBO_MODEL_MAX_CORES + 8 + i] = MASK_VAL(bits, 8 * i + 7, 8 * i);
+                }
+            }
+            /* Limits past the core count (or past the registers) read as 0. */
+            for (i = 0; i < 8 * regs && i < d.cores_per_socket; i++)
+            {
+                if (d.max_ratio[socket * TURBO_MODEL_MAX_CORES + i] == 0)
+                {
+                    break;
+                }
+            }
+            d.num_limits[socket] = i;
+        }
+        core_cres_storage(NULL);
+        avail = 1;
+    }
+    if (!avail)
+    {
+        return -1;
+    }
+    if (tm != NULL)
+    {
+        *tm = &d;
+    }
+    return 0;
+}
+
+/// @brief Look up the max turbo frequency for a number of active cores.
+///
+/// @param [in] max_ratio Parsed ratio limits of one socket.
+///
+/// @param [in] num_limits Number of parsed limits (at least 1).
+///
+/// @param [in] n Number of active cores (at least 1).
+///
+/// @return Max frequency in MHz.
+static double turbo_limit_mhz(const uint8_t *max_ratio, unsigned num_limits, unsigned n)
+{
+    return max_ratio[(n > num_limits ? num_limits : n) - 1] * 100.0;
+}
+
+double max_freq_for_active_cores(unsigned socket, unsigned n)
+{
+    struct turbo_model *tm = NULL;
+
+    if (turbo_model_storage(&tm))
+    {
+        return -1;
+    }
+    if (socket >= tm->num_sockets || n == 0 || tm->num_limits[socket] == 0)
+    {
+        libmsr_error_handler("max_freq_for_active_cores(): Invalid socket or core count", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    return turbo_limit_mhz(&tm->max_ratio[socket * TURBO_MODEL_MAX_CORES], tm->num_limits[socket], n);
+}
+
+int poll_turbo_model(void)
+{
+    struct turbo_model *tm = NULL;
+    struct core_cres *ccr = NULL;
+    uint64_t tsc, idle, core, d_tsc;
+    double active;
+    int baseline;
+
+    if (turbo_model_storage(&tm))
+    {
+        return -1;
+    }
+    core_cres_storage(&ccr);
+    if (read_batch(CORE_CRES))
+    {
+        libmsr_error_handler("poll_turbo_model(): Unable to read core C-state residencies", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    tsc = read_tsc();
+    d_tsc = tsc - tm->old_tsc;
+    baseline = (tm->old_tsc == 0);
+    for (core = 0; core < tm->num_sockets * tm->cores_per_socket; core++)
+    {
+        idle = *ccr->core_c3[core] + *ccr->core_c6[core] + *ccr->core_c7[core];
+        if (!baseline && d_tsc)
+        {
+            active = 1.0 - (double) (idle - tm->old_idle[core]) / d_tsc;
+            tm->active[core] = (active < 0.0 ? 0.0 : (active > 1.0 ? 1.0 : active));
+        }
+        tm->old_idle[core] = idle;
+    }
+    tm->old_tsc = tsc;
+    return 0;
+}
+
+double turbo_model_predict(const double *active, unsigned ncores, const uint8_t *max_ratio, unsigned num_limits)
+{
+    /* P(k cores active), built up one core at a time. */
+    double prob[TURBO_MODEL_MAX_CORES * 4 + 1];
+    double p, weight = 0.0, freq = 0.0;
+    unsigned core, k;
+
+    if (num_limits == 0)
+    {
+        return -1;
+    }
+    if (ncores > TURBO_MODEL_MAX_CORES * 4)
+    {
+        ncores = TURBO_MODEL_MAX_CORES * 4;
+    }
+    prob[0] = 1.0;
+    for (core = 0; core < ncores; core++)
+    {
+        p = active[core];
+        prob[core + 1] = 0.0;
+        for (k = core + 1; k > 0; k--)
+        {
+            prob[k] = prob[k] * (1.0 - p) + prob[k - 1] * p;
+        }
+        prob[0] *= (1.0 - p);
+    }
+    for (k = 1; k <= ncores; k++)
+    {
+        weight += prob[k] * k;
+        freq += prob[k] * k * turbo_limit_mhz(max_ratio, num_limits, k);
+    }
+    /* No activity seen yet: a single active core gets the 1-core limit. */
+    if (weight <= 0.0)
+    {
+        return turbo_limit_mhz(max_ratio, num_limits, 1);
+    }
+    return freq / weight;
+}
+
+double predict_turbo_freq(unsigned socket)
+{
+    struct turbo_model *tm = NULL;
+
+    if (turbo_model_storage(&tm))
+    {
+        return -1;
+    }
+    if (socket >= tm->num_sockets || tm->num_limits[socket] == 0)
+    {
+        libmsr_error_handler("predict_turbo_freq(): Invalid socket", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    return turbo_model_predict(&tm->active[socket * tm->cores_per_socket], tm->cores_per_socket, &tm->max_ratio[socket * TURBO_MODEL_MAX_CORES], tm->num_limits[socket]);
+}
+
+void dump_turbo_model(FILE *writedest)
+{
+    struct turbo_model *tm = NULL;
+    unsigned socket, n;
+
+    if (turbo_model_storage(&tm))
+    {
+        return;
+    }
+    for (socket = 0; socket < tm->num_sockets; socket++)
+    {
+        fprintf(writedest, "Socket %u:", socket);
+        for (n = 1; n <= tm->num_limits[socket]; n++)
+        {
+            fprintf(writedest, " %uC=%.0f", n, max_freq_for_active_cores(socket, n));
+        }
+        fprintf(writedest, "\n  predicted = %.0f MHz\n", predict_turbo_freq(socket));
+    }
+}
 #endif
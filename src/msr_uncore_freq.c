@@ -0,0 +1,232 @@
+/* msr_uncore_freq.c
+ *
+ * Copyright (c) 2011-2016, Lawrence Livermore National Security, LLC.
+ * LLNL-CODE-645430
+ *
+ * Produced at Lawrence Livermore National Laboratory
+ * Written by  Barry Rountree, rountree@llnl.gov
+ *             Scott Walker,   walker91@llnl.gov
+ *             Kathleen Shoga, shoga1@llnl.gov
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This material is based upon work supported by the U.S. Department of
+ * Energy's Lawrence Livermore National Laboratory. Office of Science, under
+ * Award number DE-AC52-07NA27344.
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "msr_core.h"
+#include "msr_uncore_freq.h"
+#include "cpuid.h"
+#include "memhdlr.h"
+#include "libmsr_error.h"
+#include "libmsr_debug.h"
+
+void uncore_freq_storage(struct uncore_freq_data **ud)
+{
+    static int init = 0;
+    static struct uncore_freq_data d;
+
+    if (!init)
+    {
+        init = 1;
+        d.num_sockets = num_sockets();
+        d.ratio_limit = (uint64_t **) libmsr_calloc(d.num_sockets, sizeof(uint64_t *));
+        d.uclk_ctl = (uint64_t **) libmsr_calloc(d.num_sockets, sizeof(uint64_t *));
+        d.uclk = (uint64_t **) libmsr_calloc(d.num_sockets, sizeof(uint64_t *));
+        d.old_uclk = (uint64_t *) libmsr_calloc(d.num_sockets, sizeof(uint64_t));
+        d.freq = (double *) libmsr_calloc(d.num_sockets, sizeof(double));
+        d.old_time = 0.0;
+#if UNCORE_HAS_RATIO_LIMIT
+        allocate_batch(UNCORE_FREQ_CTL, d.num_sockets);
+        load_socket_batch(MSR_UNCORE_RATIO_LIMIT, d.ratio_limit, UNCORE_FREQ_CTL);
+#endif
+        allocate_batch(UNCORE_FREQ_EVT, d.num_sockets);
+        load_socket_batch(U_MSR_PMON_UCLK_FIXED_CTL, d.uclk_ctl, UNCORE_FREQ_EVT);
+        allocate_batch(UNCORE_FREQ_DATA, d.num_sockets);
+        load_socket_batch(U_MSR_PMON_UCLK_FIXED_CTR, d.uclk, UNCORE_FREQ_DATA);
+    }
+    if (ud != NULL)
+    {
+        *ud = &d;
+    }
+}
+
+int get_uncore_ratio_limit(uint64_t *min_ratio, uint64_t *max_ratio)
+{
+#if UNCORE_HAS_RATIO_LIMIT
+    static struct uncore_freq_data *ud = NULL;
+    uint64_t i;
+
+    if (ud == NULL)
+    {
+        uncore_freq_storage(&ud);
+    }
+    if (read_batch(UNCORE_FREQ_CTL))
+    {
+        libmsr_error_handler("get_uncore_ratio_limit(): Unable to read MSR_UNCORE_RATIO_LIMIT", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    for (i = 0; i < ud->num_sockets; i++)
+    {
+        if (min_ratio != NULL)
+        {
+            min_ratio[i] = MASK_VAL(*ud->ratio_limit[i], 14, 8);
+        }
+        if (max_ratio != NULL)
+        {
+            max_ratio[i] = MASK_VAL(*ud->ratio_limit[i], 6, 0);
+        }
+    }
+    return 0;
+#else
+    libmsr_error_handler("get_uncore_ratio_limit(): MSR_UNCORE_RATIO_LIMIT not supported", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+    return -1;
+#endif
+}
+
+int set_uncore_ratio_limit(const uint64_t *min_ratio, const uint64_t *max_ratio)
+{
+#if UNCORE_HAS_RATIO_LIMIT
+    static struct uncore_freq_data *ud = NULL;
+    uint64_t i, lo, hi;
+
+    if (ud == NULL)
+    {
+        uncore_freq_storage(&ud);
+    }
+    if (read_batch(UNCORE_FREQ_CTL))
+    {
+        libmsr_error_handler("set_uncore_ratio_limit(): Unable to read MSR_UNCORE_RATIO_LIMIT", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    /* Validate every socket before touching the batch. */
+    for (i = 0; i < ud->num_sockets; i++)
+    {
+        lo = (min_ratio != NULL && min_ratio[i] ? min_ratio[i] : MASK_VAL(*ud->ratio_limit[i], 14, 8));
+        hi = (max_ratio != NULL && max_ratio[i] ? max_ratio[i] : MASK_VAL(*ud->ratio_limit[i], 6, 0));
+        if (lo > 0x7F || hi > 0x7F || lo > hi)
+        {
+            libmsr_error_handler("set_uncore_ratio_limit(): Ratio out of range", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+            return -1;
+        }
+    }
+    for (i = 0; i < ud->num_sockets; i++)
+    {
+        if (min_ratio != NULL && min_ratio[i])
+        {
+            *ud->ratio_limit[i] = (*ud->ratio_limit[i] & ~MASK_RANGE(14, 8)) | (min_ratio[i] << 8);
+        }
+        if (max_ratio != NULL && max_ratio[i])
+        {
+            *ud->ratio_limit[i] = (*ud->ratio_limit[i] & ~MASK_RANGE(6, 0)) | max_ratio[i];
+        }
+    }
+    if (write_batch(UNCORE_FREQ_CTL))
+    {
+        libmsr_error_handler("set_uncore_ratio_limit(): Unable to write MSR_UNCORE_RATIO_LIMIT", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    return 0;
+#else
+    libmsr_error_handler("set_uncore_ratio_limit(): MSR_UNCORE_RATIO_LIMIT not supported", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+    return -1;
+#endif
+}
+
+int enable_uncore_freq_counter(void)
+{
+    static struct uncore_freq_data *ud = NULL;
+    uint64_t i;
+
+    if (ud == NULL)
+    {
+        uncore_freq_storage(&ud);
+    }
+    for (i = 0; i < ud->num_sockets; i++)
+    {
+        *ud->uclk_ctl[i] = UNCORE_UCLK_EN;
+    }
+    if (write_batch(UNCORE_FREQ_EVT))
+    {
+        libmsr_error_handler("enable_uncore_freq_counter(): Unable to enable UCLK counter", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    ud->old_time = 0.0;
+    return poll_uncore_freq();
+}
+
+int poll_uncore_freq(void)
+{
+    static struct uncore_freq_data *ud = NULL;
+    double now, elapsed;
+    uint64_t i;
+
+    if (ud == NULL)
+    {
+        uncore_freq_storage(&ud);
+    }
+    if (read_batch(UNCORE_FREQ_DATA))
+    {
+        libmsr_error_handler("poll_uncore_freq(): Unable to read UCLK counter", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    now = monotonic_time();
+    elapsed = now - ud->old_time;
+    for (i = 0; i < ud->num_sockets; i++)
+    {
+        if (ud->old_time != 0.0 && elapsed > 0.0)
+        {
+            ud->freq[i] = ctr_wrap_delta(*ud->uclk[i], ud->old_uclk[i], UNCORE_UCLK_CTR_WIDTH) / elapsed / 1.0e6;
+        }
+        ud->old_uclk[i] = *ud->uclk[i];
+    }
+    ud->old_time = now;
+    return 0;
+}
+
+void dump_uncore_freq(FILE *writedest)
+{
+    static struct uncore_freq_data *ud = NULL;
+    uint64_t i;
+
+    if (ud == NULL)
+    {
+        uncore_freq_storage(&ud);
+    }
+#if UNCORE_HAS_RATIO_LIMIT
+    if (read_batch(UNCORE_FREQ_CTL))
+    {
+        return;
+    }
+#endif
+    for (i = 0; i < ud->num_sockets; i++)
+    {
+        fprintf(writedest, "Socket %lu:\n", i);
+#if UNCORE_HAS_RATIO_LIMIT
+        fprintf(writedest, "  min ratio = %lu MHz\n", MASK_VAL(*ud->ratio_limit[i], 14, 8) * 100);
+        fprintf(writedest, "  max ratio = %lu MHz\n", MASK_VAL(*ud->ratio_limit[i], 6, 0) * 100);
+#endif
+        fprintf(writedest, "  uclk      = %.0f MHz\n", ud->freq[i]);
+    }
+}
@@ -10,11 +10,25 @@
 #include "msr_thermal.h"
 #include "msr_counters.h"
 #include "msr_clocks.h"
+#include "msr_tstate.h"
 #include "profile.h"
 #include "msr_misc.h"
 #include "msr_turbo.h"
+#include "msr_region.h"
+#include "msr_sample.h"
+#include "msr_pcu.h"
+#include "msr_cbo.h"
+#include "msr_topdown.h"
+#include "msr_perf_limit.h"
+#include "msr_uncore_freq.h"
+#include "msr_pstate.h"
+#include "msr_hwp.h"
 #include "csr_core.h"
 #include "csr_imc.h"
+#include "csr_membw.h"
+#include "csr_qpi.h"
+#include "csr_ha.h"
+#include "csr_r2pcie.h"
 #include "libmsr_error.h"
 
 uint64_t pp_policy = 0x5;
@@ -96,14 +110,6 @@ void counters_test()
 // TODO: test other parts of clocks
 void clocks_test()
 {
-    uint64_t sockets = 0;
-    int i, j;
-    struct clock_mod t;
-    uint64_t coresPerSocket;
-
-    sockets = num_sockets();
-    coresPerSocket = cores_per_socket();
-
     fprintf(stdout, "\n--- Read IA32_APERF, IA32_MPERF, and IA32_TIME_STAMP_COUNTER ---\n");
     dump_clocks_data_readable(stdout);
 
@@ -115,16 +121,7 @@ void clocks_test()
     dump_p_state(stdout);
 
     fprintf(stdout, "\n--- Reading IA32_CLOCK_MODULATION ---\n");
-    for (i = 0; i < sockets; i++)
-    {
-        for (j = 0; j < coresPerSocket; j++)
-        {
-            get_clock_mod(i, j, &t);
-            fprintf(stdout, "Socket %d, Core %2d\n", i, j);
-            dump_clock_mod(&t, stdout);
-            fprintf(stdout, "\n");
-        }
-    }
+    dump_tstate(stdout);
 }
 
 void misc_test()
@@ -198,6 +195,242 @@ int repeated_poll_test()
     return 0;
 }
 
+#define MONITOR_INC 100000
+
+void region_test()
+{
+    struct region_totals t;
+
+    libmsr_region_begin("outer");
+    libmsr_region_begin("inner");
+    usleep(MONITOR_INC);
+    libmsr_region_end("inner");
+    libmsr_region_end("outer");
+    if (libmsr_region_get("outer/inner", &t) == 0)
+    {
+        fprintf(stdout, "outer/inner: %lu call(s), %lf s, %lf J pkg, %lu instr\n", t.calls, t.seconds, t.pkg_joules, t.inst_retired);
+    }
+    fprintf(stdout, "\n* Region Totals *\n");
+    dump_region_data(stdout);
+    libmsr_region_finalize();
+}
+
+void overflow_test()
+{
+    if (init_counter_overflow())
+    {
+        return;
+    }
+    usleep(MONITOR_INC);
+    poll_counter_overflow();
+    fprintf(stdout, "\n--- Fixed Performance Counters Accumulated Across Wraparound ---\n");
+    dump_fixed_counter_data_readable(stdout);
+}
+
+void topdown_test()
+{
+    if (enable_topdown())
+    {
+        return;
+    }
+    poll_topdown_data();
+    usleep(MONITOR_INC);
+    poll_topdown_data();
+    dump_topdown_data_label(stdout);
+    dump_topdown_data(stdout);
+}
+
+void pcu_test()
+{
+    enum pcu_event_e events[4] = {PCU_CLOCKTICKS, PCU_FREQ_MAX_THERMAL, PCU_FREQ_MAX_POWER, PCU_C0_OCCUPANCY};
+
+    if (set_pcu_events(events, 4))
+    {
+        return;
+    }
+    usleep(MONITOR_INC);
+    poll_pcu_data();
+    dump_pcu_data_label(stdout);
+    dump_pcu_data(stdout);
+}
+
+void cbo_test()
+{
+    struct cbo_llc_stats stats;
+    int i;
+
+    if (set_cbo_llc_events())
+    {
+        return;
+    }
+    poll_cbo_data();
+    usleep(MONITOR_INC);
+    poll_cbo_data();
+    dump_cbo_data_label(stdout);
+    dump_cbo_data(stdout);
+    for (i = 0; i < num_sockets(); i++)
+    {
+        if (get_cbo_llc_stats(i, &stats) == 0)
+        {
+            fprintf(stdout, "Socket %d: LLC miss ratio %lf, avg miss latency %lf uncore cycles\n", i, stats.miss_ratio, stats.avg_miss_latency);
+        }
+    }
+}
+
+void cres_sample_test()
+{
+    poll_cres_sample();
+    usleep(MONITOR_INC);
+    poll_cres_sample();
+    dump_cres_sample_label(stdout);
+    dump_cres_sample(stdout);
+}
+
+void freq_hist_test()
+{
+    poll_freq_hist();
+    usleep(MONITOR_INC);
+    poll_freq_hist();
+    dump_freq_hist_csv(stdout);
+}
+
+void turbo_model_test()
+{
+    struct turbo_model *tm = NULL;
+    int i;
+
+    if (turbo_model_storage(&tm))
+    {
+        return;
+    }
+    poll_turbo_model();
+    usleep(MONITOR_INC);
+    poll_turbo_model();
+    dump_turbo_model(stdout);
+    for (i = 0; i < num_sockets(); i++)
+    {
+        fprintf(stdout, "Socket %d: predicted turbo frequency %lf MHz\n", i, predict_turbo_freq(i));
+    }
+}
+
+void uncore_freq_test()
+{
+    enable_uncore_freq_counter();
+    usleep(MONITOR_INC);
+    poll_uncore_freq();
+    dump_uncore_freq(stdout);
+}
+
+void perf_limit_test()
+{
+    if (poll_perf_limit(0) == 0)
+    {
+        dump_perf_limit(stdout);
+    }
+}
+
+void power_control_test()
+{
+    fprintf(stdout, "\n--- P-State Requests ---\n");
+    dump_pstate(stdout);
+
+    fprintf(stdout, "\n--- HWP and Energy/Performance Bias ---\n");
+    dump_hwp(stdout);
+}
+
+void sample_test(int csr)
+{
+    struct sample_txn txn;
+
+    libmsr_sample_init(&txn);
+    libmsr_sample_add_msr(&txn, CLOCKS_DATA);
+    libmsr_sample_add_msr(&txn, RAPL_DATA);
+    if (csr)
+    {
+        libmsr_sample_add_csr(&txn, CSR_MEMBW_CTRS);
+    }
+    if (libmsr_sample_run(&txn) == 0)
+    {
+        dump_sample_txn(stdout, &txn);
+    }
+}
+
+void imc_test()
+{
+    struct imc_topology *topo = imc_topology_storage();
+    struct imc_metrics_data *md = NULL;
+    struct imc_snapshot *snap = NULL;
+    unsigned i;
+
+    fprintf(stdout, "\n--- iMC Channel Map (%s) ---\n", topo->discovered ? "discovered" : "defaults");
+    for (i = 0; i < topo->num_channels; i++)
+    {
+        fprintf(stdout, "Socket %u iMC %u channel %u: bus 0x%x device %u function %u\n", topo->channels[i].socket, topo->channels[i].imc, topo->channels[i].channel, topo->channels[i].pci_bus, topo->channels[i].device, topo->channels[i].function);
+    }
+
+    if (enable_imc_metrics() == 0 && imc_metrics_storage(&md) == 0)
+    {
+        usleep(MONITOR_INC);
+        poll_imc_metrics();
+        fprintf(stdout, "\n--- iMC Metrics ---\n");
+        for (i = 0; i < md->num_sockets; i++)
+        {
+            fprintf(stdout, "Socket %u: page hit %lf, empty %lf, miss %lf, read ratio %lf\n", i, md->socket[i].page_hit, md->socket[i].page_empty, md->socket[i].page_miss, md->socket[i].read_ratio);
+        }
+    }
+
+    if (imc_snapshot_storage(&snap) == 0)
+    {
+        fprintf(stdout, "\n--- iMC Snapshots ---\n");
+        if (read_imc_snapshot(IMC_SNAPSHOT_FREEZE) == 0)
+        {
+            fprintf(stdout, "Frozen: %u channels in %lf s\n", snap->num_channels, snap->skew);
+        }
+        if (read_imc_snapshot(IMC_SNAPSHOT_NOFREEZE) == 0)
+        {
+            fprintf(stdout, "Running: %u channels in %lf s, %lu DRAM clocks\n", snap->num_channels, snap->skew, snap->skew_dclk);
+        }
+    }
+}
+
+void uncore_csr_test()
+{
+    fprintf(stdout, "\n--- Memory Bandwidth ---\n");
+    if (enable_membw() == 0)
+    {
+        dump_membw_data_label(stdout);
+        monitor_membw(MONITOR_INC / 1000, 2);
+        dump_membw_data(stdout);
+    }
+
+    fprintf(stdout, "\n--- QPI ---\n");
+    if (enable_qpi() == 0)
+    {
+        usleep(MONITOR_INC);
+        poll_qpi_data();
+        dump_qpi_data_label(stdout);
+        dump_qpi_data(stdout);
+    }
+
+    fprintf(stdout, "\n--- Home Agent ---\n");
+    if (enable_ha() == 0)
+    {
+        usleep(MONITOR_INC);
+        poll_ha_data();
+        dump_ha_data_label(stdout);
+        dump_ha_data(stdout);
+    }
+
+    fprintf(stdout, "\n--- R2PCIe ---\n");
+    if (enable_r2pcie() == 0)
+    {
+        usleep(MONITOR_INC);
+        poll_r2pcie_data();
+        dump_r2pcie_data_label(stdout);
+        dump_r2pcie_data(stdout);
+    }
+}
+
 void set_to_defaults()
 {
     int socket = 0;
@@ -244,6 +477,7 @@ int main(int argc, char **argv)
     uint64_t threads = 0;
     uint64_t sockets = 0;
     int ri_stat = 0;
+    int csr = 0;
 
     if (!sockets)
     {
@@ -295,9 +529,62 @@ int main(int argc, char **argv)
     fprintf(stdout, "\n===== Repeated RAPL Polling Test =====\n");
     repeated_poll_test();
 
+    fprintf(stdout, "\n===== Region Test =====\n");
+    region_test();
+
+    fprintf(stdout, "\n===== Counter Overflow Test =====\n");
+    overflow_test();
+
+    fprintf(stdout, "\n===== Top-Down Test =====\n");
+    topdown_test();
+
+    fprintf(stdout, "\n===== PCU Test =====\n");
+    pcu_test();
+
+    fprintf(stdout, "\n===== CBo Test =====\n");
+    cbo_test();
+
+    fprintf(stdout, "\n===== C-State Residency Sampler Test =====\n");
+    cres_sample_test();
+
+    fprintf(stdout, "\n===== Frequency Histogram Test =====\n");
+    freq_hist_test();
+
+    fprintf(stdout, "\n===== Turbo Model Test =====\n");
+    turbo_model_test();
+
+    fprintf(stdout, "\n===== Uncore Frequency Test =====\n");
+    uncore_freq_test();
+
+    fprintf(stdout, "\n===== Perf Limit Reasons Test =====\n");
+    perf_limit_test();
+
+    fprintf(stdout, "\n===== Power Control Test =====\n");
+    power_control_test();
+
+    csr = ((csr_capabilities() & CSR_CAP_BATCH) && init_csr() == 0);
+    if (csr)
+    {
+        fprintf(stdout, "\n===== CSR Init Done =====\n");
+
+        fprintf(stdout, "\n===== iMC Test =====\n");
+        imc_test();
+
+        fprintf(stdout, "\n===== Uncore CSR Test =====\n");
+        uncore_csr_test();
+    }
+
+    fprintf(stdout, "\n===== Sample Transaction Test =====\n");
+    sample_test(csr);
+
     fprintf(stdout, "\n===== Setting Defaults =====\n");
     set_to_defaults();
 
+    if (csr)
+    {
+        finalize_csr();
+        fprintf(stdout, "\n===== CSR Finalized =====\n");
+    }
     finalize_msr();
     fprintf(stdout, "\n===== MSR Finalized =====\n");
 
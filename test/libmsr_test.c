@@ -13,6 +13,11 @@
 #include "profile.h"
 #include "msr_misc.h"
 #include "msr_turbo.h"
+#include "msr_pstate.h"
+#include "msr_tstate.h"
+#include "msr_governor.h"
+#include "msr_hwp.h"
+#include "msr_uncore_freq.h"
 #include "csr_core.h"
 #include "csr_imc.h"
 #include "libmsr_error.h"
@@ -293,6 +298,132 @@ int repeated_poll_test()
     return 0;
 }
 
+uint64_t *all_cpus_mask()
+{
+    uint64_t *mask = (uint64_t *) calloc(CPUMASK_WORDS(num_devs()), sizeof(uint64_t));
+    int i;
+
+    for (i = 0; i < num_devs(); i++)
+    {
+        CPUMASK_SET(mask, i);
+    }
+    return mask;
+}
+
+void pstate_control_test()
+{
+    uint64_t *mask = all_cpus_mask();
+    uint64_t *requested = (uint64_t *) calloc(num_devs(), sizeof(uint64_t));
+    struct governor_config cfg;
+
+    if (get_pstate(NULL, requested) == 0)
+    {
+        fprintf(stdout, "Request ratio %lu on all threads: %d mismatch(es)\n", requested[0], set_pstate_mask(mask, requested[0], 1));
+        dump_pstate(stdout);
+
+        if (governor_default_config(&cfg) == 0 && governor_start(&cfg) == 0)
+        {
+            usleep(100000);
+            governor_stop();
+            fprintf(stdout, "\n--- Governor ---\n");
+            dump_governor_data(stdout);
+        }
+        set_pstate_array(requested, 1);
+    }
+    free(requested);
+    free(mask);
+}
+
+void tstate_control_test()
+{
+    uint64_t *mask = all_cpus_mask();
+    unsigned *duty = (unsigned *) calloc(num_devs(), sizeof(unsigned));
+
+    if (get_tstate(duty) == 0)
+    {
+        fprintf(stdout, "Set 50%% duty cycle on all threads: %d mismatch(es)\n", set_tstate_mask(mask, TSTATE_DUTY_STEPS / 2, 1));
+        dump_tstate(stdout);
+        set_tstate_array(duty, 1);
+    }
+    free(duty);
+    free(mask);
+}
+
+void turbo_control_test()
+{
+    uint64_t *engaged = (uint64_t *) calloc(CPUMASK_WORDS(num_devs()), sizeof(uint64_t));
+    uint64_t *disengaged = (uint64_t *) calloc(CPUMASK_WORDS(num_devs()), sizeof(uint64_t));
+    struct turbo_state *state = NULL;
+    int i;
+
+    if (get_turbo_state(&state) == 0)
+    {
+        for (i = 0; i < num_devs(); i++)
+        {
+            if (state[i].engaged)
+            {
+                CPUMASK_SET(engaged, i);
+            }
+            else
+            {
+                CPUMASK_SET(disengaged, i);
+            }
+        }
+        disable_turbo();
+        dump_turbo(stdout);
+        enable_turbo();
+        dump_turbo(stdout);
+        set_turbo_mask(engaged, 1);
+        set_turbo_mask(disengaged, 0);
+    }
+    free(disengaged);
+    free(engaged);
+}
+
+void hwp_control_test()
+{
+    struct hwp_data *hd = NULL;
+    struct hwp_request *reqs = (struct hwp_request *) calloc(num_devs(), sizeof(struct hwp_request));
+    uint64_t *epb = (uint64_t *) calloc(num_devs(), sizeof(uint64_t));
+    uint64_t *mask = (uint64_t *) calloc(CPUMASK_WORDS(num_devs()), sizeof(uint64_t));
+    int i;
+
+    hwp_storage(&hd);
+    /* Enabling HWP cannot be undone without a reset, so only rewrite the
+     * current requests if the platform already runs with it. */
+    if (hd != NULL && hd->hwp_enabled && get_hwp_request(reqs) == 0)
+    {
+        set_hwp_request_array(reqs, HWP_FIELD_MIN | HWP_FIELD_MAX | HWP_FIELD_DESIRED | (hd->epp_avail ? HWP_FIELD_EPP : 0));
+    }
+    if (get_epb(epb) == 0)
+    {
+        for (i = 0; i < num_devs(); i++)
+        {
+            CPUMASK_SET(mask, i);
+            set_epb_mask(mask, epb[i]);
+            CPUMASK_CLR(mask, i);
+        }
+    }
+    dump_hwp(stdout);
+    free(mask);
+    free(epb);
+    free(reqs);
+}
+
+void uncore_ratio_test()
+{
+    uint64_t *min_ratio = (uint64_t *) calloc(num_sockets(), sizeof(uint64_t));
+    uint64_t *max_ratio = (uint64_t *) calloc(num_sockets(), sizeof(uint64_t));
+
+    if (get_uncore_ratio_limit(min_ratio, max_ratio) == 0)
+    {
+        set_uncore_ratio_limit(min_ratio, max_ratio);
+        dump_uncore_freq(stdout);
+    }
+    free(max_ratio);
+    free(min_ratio);
+}
+
 void set_to_defaults()
 {
     int socket = 0;
@@ -428,6 +559,21 @@ int main(int argc, char **argv)
     fprintf(stdout, "\n===== Repeated RAPL Polling Test =====\n");
     repeated_poll_test();
 
+    fprintf(stdout, "\n===== P-State and Governor Test =====\n");
+    pstate_control_test();
+
+    fprintf(stdout, "\n===== T-State Test =====\n");
+    tstate_control_test();
+
+    fprintf(stdout, "\n===== Turbo Control Test =====\n");
+    turbo_control_test();
+
+    fprintf(stdout, "\n===== HWP and EPB Test =====\n");
+    hwp_control_test();
+
+    fprintf(stdout, "\n===== Uncore Ratio Limit Test =====\n");
+    uncore_ratio_test();
+
     fprintf(stdout, "\n===== Setting Defaults =====\n");
     set_to_defaults();
 
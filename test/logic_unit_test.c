@@ -0,0 +1,223 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "msr_core.h"
+#include "msr_governor.h"
+#include "msr_hwp.h"
+#include "msr_tstate.h"
+#include "msr_turbo.h"
+#include "csr_imc.h"
+
+/* These checks exercise the register encodings and models without touching
+ * any MSR or CSR, so they run on any host. */
+
+static int failures = 0;
+
+#define CHECK(cond) check((cond), #cond, __LINE__)
+#define CHECK_NEAR(a, b) check(fabs((a) - (b)) < 1e-9, #a " == " #b, __LINE__)
+
+void check(int ok, const char *what, int line)
+{
+    if (!ok)
+    {
+        fprintf(stderr, "FAILED (line %d): %s\n", line, what);
+        failures++;
+    }
+}
+
+void wrap_delta_test()
+{
+    fprintf(stdout, "\n--- Counter Wraparound Deltas ---\n");
+    CHECK(ctr_wrap_delta(150, 100, 48) == 50);
+    CHECK(ctr_wrap_delta(5, 0xFFFFFFFFFFFEULL, 48) == 7);
+    CHECK(ctr_wrap_delta(0, 0xFFFFFFFFFFFFULL, 48) == 1);
+    CHECK(ctr_wrap_delta(100, 100, 48) == 0);
+    CHECK(ctr_wrap_delta(3, 0xFFFFFFFEULL, 32) == 5);
+    CHECK(ctr_wrap_delta(1, ~0ULL, 64) == 2);
+    CHECK(ctr_wrap_delta(1, ~0ULL, 0) == 2);
+}
+
+void governor_policy_test()
+{
+    struct governor_config cfg = {0};
+    struct governor_sample s = {0};
+
+    fprintf(stdout, "\n--- Governor Default Policy ---\n");
+    cfg.min_ratio = 12;
+    cfg.max_ratio = 30;
+    cfg.max_perf_loss = 0.05;
+
+    /* Mostly idle processors are left unchanged. */
+    s.freq = 2000.0;
+    s.c0 = 0.005;
+    CHECK(governor_default_policy(0, &s, &cfg) == 0);
+
+    /* Fully frequency-bound: the slowdown bound is 5% of the run time at
+     * max_ratio, ceil(30 / 1.05) = 29. */
+    s.c0 = 0.5;
+    s.stall = 0.0;
+    CHECK(governor_default_policy(0, &s, &cfg) == 29);
+
+    /* Fully stalled: the frequency does not matter, go to min_ratio. */
+    s.stall = 1.0;
+    CHECK(governor_default_policy(0, &s, &cfg) == cfg.min_ratio);
+    s.stall = 2.0;
+    CHECK(governor_default_policy(0, &s, &cfg) == cfg.min_ratio);
+
+    /* Half stalled: (0.5 * 20 / r + 0.5) <= 1.05 * (0.5 * 20 / 30 + 0.5)
+     * gives r >= 26.67. */
+    s.stall = 0.5;
+    CHECK(governor_default_policy(0, &s, &cfg) == 27);
+
+    /* No loss allowed: never below max_ratio, never above it. */
+    cfg.max_perf_loss = 0.0;
+    s.stall = 0.0;
+    CHECK(governor_default_policy(0, &s, &cfg) == cfg.max_ratio);
+
+    /* Unconfigured limits leave the processor unchanged. */
+    cfg.max_ratio = 0;
+    CHECK(governor_default_policy(0, &s, &cfg) == 0);
+}
+
+void imc_metrics_test()
+{
+    struct imc_metrics m = {0};
+
+    fprintf(stdout, "\n--- iMC Metrics Ratios ---\n");
+    m.page_hit = m.page_empty = m.page_miss = m.read_ratio = 1.0;
+    imc_metrics_ratios(&m);
+    CHECK(m.page_hit == 0.0 && m.page_empty == 0.0 && m.page_miss == 0.0 && m.read_ratio == 0.0);
+
+    /* 100 CAS: 20 page misses, 50 activates of which 30 hit a closed bank. */
+    m.cas_rd = 75;
+    m.cas_wr = 25;
+    m.act = 50;
+    m.pre_miss = 20;
+    imc_metrics_ratios(&m);
+    CHECK_NEAR(m.page_miss, 0.2);
+    CHECK_NEAR(m.page_empty, 0.3);
+    CHECK_NEAR(m.page_hit, 0.5);
+    CHECK_NEAR(m.read_ratio, 0.75);
+
+    /* More misses than activates: no empty pages. */
+    m.act = 10;
+    imc_metrics_ratios(&m);
+    CHECK_NEAR(m.page_empty, 0.0);
+    CHECK_NEAR(m.page_hit, 0.8);
+
+    /* Counts skewed past the CAS total never give a negative hit ratio. */
+    m.act = 200;
+    m.pre_miss = 60;
+    imc_metrics_ratios(&m);
+    CHECK(m.page_hit == 0.0);
+}
+
+void tstate_encoding_test()
+{
+    struct tstate_data td = {0};
+    unsigned duty;
+
+    fprintf(stdout, "\n--- T-State Encoding ---\n");
+    td.extended = 1;
+    CHECK(tstate_encode(&td, TSTATE_DUTY_OFF) == 0);
+    CHECK(tstate_encode(&td, TSTATE_DUTY_OFF + 1) == 0);
+    CHECK(tstate_encode(&td, 1) == (TSTATE_ENABLE | 1));
+    CHECK(tstate_encode(&td, 0) == TSTATE_ENABLE);
+    for (duty = 0; duty <= TSTATE_DUTY_OFF; duty++)
+    {
+        CHECK(tstate_decode(&td, tstate_encode(&td, duty)) == duty);
+    }
+
+    /* Without extended modulation, bit 0 is reserved and 0 is not a valid
+     * duty cycle. */
+    td.extended = 0;
+    CHECK(tstate_encode(&td, 0) == (TSTATE_ENABLE | 2));
+    CHECK(tstate_encode(&td, 1) == (TSTATE_ENABLE | 2));
+    CHECK(tstate_encode(&td, 7) == (TSTATE_ENABLE | 6));
+    CHECK(tstate_decode(&td, TSTATE_ENABLE | 7) == 6);
+    CHECK(tstate_decode(&td, 7) == TSTATE_DUTY_OFF);
+}
+
+void hwp_encoding_test()
+{
+    struct hwp_request req = {0};
+    struct hwp_request out = {0};
+    uint64_t raw;
+
+    fprintf(stdout, "\n--- HWP Request Encoding ---\n");
+    req.min = 8;
+    req.max = 40;
+    req.desired = 0;
+    req.epp = 128;
+    raw = hwp_encode(0, &req, HWP_FIELD_MIN | HWP_FIELD_MAX | HWP_FIELD_DESIRED | HWP_FIELD_EPP);
+    hwp_decode(raw, &out);
+    CHECK(out.min == 8 && out.max == 40 && out.desired == 0 && out.epp == 128);
+
+    /* Fields not selected keep their value. */
+    req.min = 20;
+    req.max = 1;
+    raw = hwp_encode(raw, &req, HWP_FIELD_MIN);
+    hwp_decode(raw, &out);
+    CHECK(out.min == 20 && out.max == 40 && out.epp == 128);
+
+    /* Bits outside the written fields are preserved. */
+    raw = hwp_encode(~0ULL, &req, HWP_FIELD_DESIRED);
+    CHECK(raw == ~((uint64_t)0xFF << HWP_DESIRED_SHIFT));
+    CHECK(hwp_encode(raw, &req, 0) == raw);
+}
+
+void turbo_model_test()
+{
+    const uint8_t ratio[4] = {36, 34, 32, 30};
+    double active[8] = {0};
+    unsigned i;
+
+    fprintf(stdout, "\n--- Turbo Frequency Model ---\n");
+    /* No activity: the 1-core limit. */
+    CHECK_NEAR(turbo_model_predict(active, 8, ratio, 4), 3600.0);
+
+    /* One busy core. */
+    active[3] = 1.0;
+    CHECK_NEAR(turbo_model_predict(active, 8, ratio, 4), 3600.0);
+
+    /* Two busy cores. */
+    active[5] = 1.0;
+    CHECK_NEAR(turbo_model_predict(active, 8, ratio, 4), 3400.0);
+
+    /* All busy, beyond the last limit. */
+    for (i = 0; i < 8; i++)
+    {
+        active[i] = 1.0;
+    }
+    CHECK_NEAR(turbo_model_predict(active, 8, ratio, 4), 3000.0);
+
+    /* Two cores each active half the time: P(1) = 0.5, P(2) = 0.25, so
+     * (0.5 * 1 * 3600 + 0.25 * 2 * 3400) / (0.5 + 0.5). */
+    for (i = 0; i < 8; i++)
+    {
+        active[i] = 0.0;
+    }
+    active[0] = active[1] = 0.5;
+    CHECK_NEAR(turbo_model_predict(active, 8, ratio, 4), 3500.0);
+
+    CHECK(turbo_model_predict(active, 8, ratio, 0) == -1);
+}
+
+int main(int argc, char **argv)
+{
+    wrap_delta_test();
+    governor_policy_test();
+    imc_metrics_test();
+    tstate_encoding_test();
+    hwp_encoding_test();
+    turbo_model_test();
+
+    if (failures)
+    {
+        fprintf(stdout, "\n===== %d Check(s) Failed =====\n", failures);
+        return 1;
+    }
+    fprintf(stdout, "\n===== Test Finished Successfully =====\n");
+    return 0;
+}